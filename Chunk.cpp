@@ -8,17 +8,32 @@
 
 #include "GfxApi.h"
 
-#include "noisepp/core/Noise.h"
-#include "noisepp/utils/NoiseUtils.h"
-#include "xmlnoise/xml_noise3d.hpp"
-#include "xmlnoise/xml_noise3d_handlers.hpp"
-#include "xmlnoise/xml_noise2d.hpp"
-#include "xmlnoise/xml_noise2d_handlers.hpp"
+#include "TerrainNoise.h"
 
 #include <tuple>
 
 #include "cubelib\cube.hpp"
 
+const float Chunk::ISO_VALUE = -0.5f;
+const float Chunk::DENSITY_RANGE = 4.0f;
+const float Chunk::DENSITY_MAX_SHIFT = 1.0f / 16;
+
+//Big enough for the temporaries of a typical chunk, the arena grows to the largest one seen.
+static const std::size_t MESH_SCRATCH_BLOCK_SIZE = 1024 * 1024;
+
+//Every thread meshing chunks keeps its own arena for as long as it lives.
+static ScratchArena& getMeshScratchArena(void)
+{
+    static __declspec(thread) ScratchArena* pArena = nullptr;
+
+    if(!pArena)
+    {
+        pArena = new ScratchArena(MESH_SCRATCH_BLOCK_SIZE);
+    }
+
+    return *pArena;
+}
+
 
 float3 LinearInterp(Vector3Int p1, float p1Val, Vector3Int p2, float p2Val,  float value)
 {
@@ -50,8 +65,22 @@ Chunk::Chunk(AABB bounds, double scale, ChunkManager* pChunkManager)
       m_scale(scale)
     , m_bounds(bounds)
     , m_pChunkManager(pChunkManager)
+    , m_pTree(nullptr)
     , m_blockVolumeFloat(nullptr)
+    , m_blockVolumeCompressed(nullptr)
     , m_pMesh(nullptr)
+    , m_lastVisibleFrame(0)
+    , m_lodSwitchDistance(0)
+    , m_lodStamp(0)
+    , m_inVisibleSet(false)
+    , m_splitPending(false)
+    , m_cullPlane(0)
+    , m_awaitingVisible(false)
+    , m_hasOccluder(false)
+    , m_noSurface(false)
+    , m_countedVolumeBytes(0)
+    , m_countedMeshBytes(0)
+    , m_meshBytes(0)
 {
     m_workInProgress = boost::make_shared<bool>(false);
 
@@ -66,22 +95,17 @@ Chunk::~Chunk(void)
 
 void Chunk::generateTerrain(void)
 {
-    boost::shared_ptr<TVolume3d<float>> tmpVolumeFloat = boost::make_shared<TVolume3d<float>>(
-                                                                                ChunkManager::CHUNK_SIZE + 2,
-                                                                                ChunkManager::CHUNK_SIZE + 2,
-                                                                                ChunkManager::CHUNK_SIZE + 2);
-	std::size_t index = 0;
-
-
-    boost::scoped_ptr<noisepp::Pipeline3D> pipeline( noisepp::utils::System::createOptimalPipeline3D());
-    xml_noise3d_t xml_noise3d(*pipeline);
-    register_all_3dhandlers(xml_noise3d.handlers);
-    xml_noise3d.load("something.xml");
-    assert(xml_noise3d.root);
-    noisepp::ElementID rootid = xml_noise3d.root->addToPipeline(pipeline.get());
-    noisepp::PipelineElement3D* rootelement = pipeline->getElement(rootid);
-    noisepp::Cache *cache = pipeline->createCache();
-    
+    ChunkTerrain terrain;
+    generateTerrain(terrain);
+    setTerrain(terrain);
+}
+
+void Chunk::generateTerrain(ChunkTerrain& terrain)
+{
+    m_pChunkManager->m_tracer.record(this, ChunkTracer::STAGE_TERRAIN_BEGIN);
+
+    boost::shared_ptr<TVolume3d<float>> tmpVolumeFloat = m_pChunkManager->allocateVolume();
+
 
     float worldX = m_bounds.MinX();
     float worldY = m_bounds.MinY();
@@ -89,22 +113,109 @@ void Chunk::generateTerrain(void)
 
     double res = ((m_bounds.MaxX()-m_bounds.MinX())/ChunkManager::CHUNK_SIZE);
 
-    for(int z = 0; z < (ChunkManager::CHUNK_SIZE) + 2; z++)
-	{
-        for(int y = 0; y < (ChunkManager::CHUNK_SIZE) + 2; y++)
-	    {
-		    for(int x = 0; x < (ChunkManager::CHUNK_SIZE) + 2; x ++, index ++)
-		    {
-                float& value = (*tmpVolumeFloat)(x, y, z);
+    const std::size_t gridSize = ChunkManager::CHUNK_SIZE + 2;
+    float* values = &(*tmpVolumeFloat)(0, 0, 0);
+
+    m_pChunkManager->getTerrainNoise().getGridValues(worldX, worldY, worldZ, res, gridSize,
+        values, &(*tmpVolumeFloat)(0, 1, 0) - values, &(*tmpVolumeFloat)(0, 0, 1) - values);
+
+    terrain.m_volume = tmpVolumeFloat;
+    computeOccluder(terrain, res);
+
+    m_pChunkManager->m_tracer.record(this, ChunkTracer::STAGE_TERRAIN_END);
+}
+
+void Chunk::setTerrain(const ChunkTerrain& terrain)
+{
+    m_blockVolumeFloat = terrain.m_volume;
+	assert(m_blockVolumeFloat);
+
+    m_occluder = terrain.m_occluder;
+    m_hasOccluder = terrain.m_hasOccluder;
+}
+
+void Chunk::computeOccluder(ChunkTerrain& terrain, double res) const
+{
+    const TVolume3d<float>& volume = *terrain.m_volume;
+
+    //Solid grid points above y = 1 every column of the meshed cells has.
+    std::size_t height = ChunkManager::CHUNK_SIZE + 1;
 
-                value = rootelement->getValue((worldX + (double)x * res), (worldY + (double)y * res), (worldZ + (double)z * res), cache);
-            
+    for(std::size_t z = 1; z < (ChunkManager::CHUNK_SIZE + 2) && height > 1; z++)
+    {
+        for(std::size_t x = 1; x < (ChunkManager::CHUNK_SIZE + 2) && height > 1; x++)
+        {
+            std::size_t y = 1;
+            while(y <= height && volume(x, y, z) <= ISO_VALUE)
+            {
+                y++;
             }
+            height = y - 1;
         }
     }
-       
-    m_blockVolumeFloat = tmpVolumeFloat;
-	assert(m_blockVolumeFloat);
+
+    //Cells with all corners solid are inside the surface, so it takes two solid layers.
+    terrain.m_hasOccluder = height >= 2;
+    if(terrain.m_hasOccluder)
+    {
+        float3 minPoint = m_bounds.minPoint + float3(1, 1, 1) * float(res);
+        float3 maxPoint = m_bounds.minPoint + float3(float(ChunkManager::CHUNK_SIZE + 1), float(height), float(ChunkManager::CHUNK_SIZE + 1)) * float(res);
+
+        terrain.m_occluder = AABB(minPoint, maxPoint);
+    }
+}
+
+bool Chunk::hasVolume(void) const
+{
+    return m_blockVolumeFloat || m_blockVolumeCompressed;
+}
+
+std::size_t Chunk::getVolumeBytes(void) const
+{
+    if(m_blockVolumeFloat)
+    {
+        return m_blockVolumeFloat->getMemoryUsage();
+    }
+    if(m_blockVolumeCompressed)
+    {
+        return m_blockVolumeCompressed->getMemoryUsage();
+    }
+    return 0;
+}
+
+std::size_t Chunk::getMeshBytes(void) const
+{
+    return m_pMesh ? m_meshBytes : 0;
+}
+
+void Chunk::evictVolume(void)
+{
+    assert(!*m_workInProgress);
+
+    m_blockVolumeFloat.reset();
+    m_blockVolumeCompressed.reset();
+}
+
+void Chunk::evictMesh(void)
+{
+    m_pMesh.reset();
+    m_meshBytes = 0;
+}
+
+void Chunk::compressVolume(void)
+{
+    if(!m_blockVolumeFloat)
+    {
+        return;
+    }
+
+    m_blockVolumeCompressed = boost::make_shared<TCompressedVolume3d<float>>(*m_blockVolumeFloat, ISO_VALUE, DENSITY_RANGE, DENSITY_MAX_SHIFT);
+    m_blockVolumeFloat.reset();
+}
+
+ScratchArena::Stats Chunk::getMeshScratchStats(void)
+{
+    return getMeshScratchArena().getStats();
 }
 
 EdgeIndex Chunk::makeEdgeIndex(Vector3Int& vertA, Vector3Int& vertB)
@@ -120,12 +231,42 @@ EdgeIndex Chunk::makeEdgeIndex(Vector3Int& vertA, Vector3Int& vertB)
 
 void Chunk::generateMesh(void)
 {
-       
-    std::vector<Vertex> tmpVectorList;
-    std::vector<uint16_t> tmpIndexList;
+    //Known to have no triangles, nothing to decode or regenerate.
+    if(m_noSurface)
+    {
+        return;
+    }
+
+    //Volume was evicted by the memory budget, get it regenerated and try again next frame.
+    if(!hasVolume())
+    {
+        m_pChunkManager->ensureVolume(*m_pTree);
+        return;
+    }
+
+    FrameProfiler::Scope meshingScope(m_pChunkManager->m_pFrameProfiler, FrameProfiler::SECTION_MESHING);
+
+    //Only meshes that get uploaded are traced, chunks without surface get here once.
+    tick_t meshBegin = Clock::Tick();
+
+    boost::shared_ptr<TVolume3d<float>> volume = m_blockVolumeFloat;
+
+    //Already meshed once and compressed, unpack a temporary copy.
+    if(!volume)
+    {
+        assert(m_blockVolumeCompressed);
+        volume = m_pChunkManager->allocateVolume();
+        m_blockVolumeCompressed->decode(*volume);
+    }
+
+    ScratchArena& arena = getMeshScratchArena();
+    arena.reset();
+
+    ScratchAllocator<Vertex> scratch(arena);
 
-    std::map<EdgeIndex, float3> normalMap;
-    std::map<EdgeIndex, uint32_t> vertexMap;
+    ScratchVertexList tmpVectorList(scratch);
+    ScratchIndexList tmpIndexList(scratch);
+    ScratchVertexMap vertexMap(std::less<EdgeIndex>(), scratch);
 
     std::size_t index = 0;
     for(std::size_t y = 1; y < (ChunkManager::CHUNK_SIZE + 1); y++)
@@ -145,14 +286,14 @@ void Chunk::generateMesh(void)
                 int y1 =  y0 + 1;
                 int z1 =  z0 + 1;
 
-                blocks[0] = (*m_blockVolumeFloat)(x0, y0, z0);
-                blocks[1] = (*m_blockVolumeFloat)(x0, y1, z0);
-                blocks[2] = (*m_blockVolumeFloat)(x1, y1, z0);
-                blocks[3] = (*m_blockVolumeFloat)(x1, y0, z0);
-                blocks[4] = (*m_blockVolumeFloat)(x0, y0, z1);
-                blocks[5] = (*m_blockVolumeFloat)(x0, y1, z1);
-                blocks[6] = (*m_blockVolumeFloat)(x1, y1, z1);
-                blocks[7] = (*m_blockVolumeFloat)(x1, y0, z1);
+                blocks[0] = (*volume)(x0, y0, z0);
+                blocks[1] = (*volume)(x0, y1, z0);
+                blocks[2] = (*volume)(x1, y1, z0);
+                blocks[3] = (*volume)(x1, y0, z0);
+                blocks[4] = (*volume)(x0, y0, z1);
+                blocks[5] = (*volume)(x0, y1, z1);
+                blocks[6] = (*volume)(x1, y1, z1);
+                blocks[7] = (*volume)(x1, y0, z1);
 
                 Vector3Int verts[8];
 
@@ -165,7 +306,7 @@ void Chunk::generateMesh(void)
                 verts[6] = std::make_tuple(x1, y1, z1);
                 verts[7] = std::make_tuple(x1, y0, z1);
 
-                float minVal = -0.5;
+                float minVal = ISO_VALUE;
 
                 //float minVal = 1.1;
                 int cubeIndex = int(0);
@@ -289,8 +430,12 @@ void Chunk::generateMesh(void)
         } 
     }
 
+    compressVolume();
+    m_pChunkManager->recountMemory(*this);
+
     if(!tmpVectorList.size())
     {
+        m_noSurface = true;
         return;
     }
 
@@ -319,6 +464,11 @@ void Chunk::generateMesh(void)
         offset += 6;
     }
 
+    m_pChunkManager->m_tracer.record(this, ChunkTracer::STAGE_MESH_BEGIN, meshBegin);
+    m_pChunkManager->m_tracer.record(this, ChunkTracer::STAGE_UPLOAD_BEGIN);
+
+    FrameProfiler::Scope uploadScope(m_pChunkManager->m_pFrameProfiler, FrameProfiler::SECTION_UPLOAD);
+
     pVertexBuffer->allocateGpu();
     pVertexBuffer->updateToGpu();
 
@@ -348,26 +498,35 @@ void Chunk::generateMesh(void)
     mesh->generateVAO();
     mesh->linkShaders();
 
+    m_pChunkManager->m_tracer.record(this, ChunkTracer::STAGE_UPLOAD_END);
+
     m_pMesh = mesh;
+    m_meshBytes = mesh->m_vbs[0]->getSizeInBytes() + mesh->m_ib->getIndexSizeInBytes();
+    m_pChunkManager->recountMemory(*this);
+
+    if(m_pChunkManager->m_pFrameProfiler)
+    {
+        m_pChunkManager->m_pFrameProfiler->addCount(FrameProfiler::COUNTER_BYTES_UPLOADED, m_meshBytes);
+    }
 }
 
-uint32_t Chunk::getOrCreateVertex(float3& vertex, std::vector<Vertex>& tmpVectorList, EdgeIndex& idx, std::map<EdgeIndex, uint32_t>& vertexMap)
+uint32_t Chunk::getOrCreateVertex(float3& vertex, ScratchVertexList& tmpVectorList, EdgeIndex& idx, ScratchVertexMap& vertexMap)
 {
-    auto& it = vertexMap.find(idx);
+    uint32_t tmpIdx = tmpVectorList.size();
+
+    auto it = vertexMap.insert(std::make_pair(idx, tmpIdx));
     
-    if(it != vertexMap.end())
+    if(!it.second)
     {
-        return it->second;
+        return it.first->second;
     }
 
     Vertex vInfo;
     vInfo.normal = float3(0,0,0);
     vInfo.vertex = vertex;
-    int tmpIdx = tmpVectorList.size();
 
     tmpVectorList.push_back(vInfo);
     
-    vertexMap[idx] = tmpIdx;
     return tmpIdx;
 
 }
@@ -4,6 +4,8 @@
 #include <boost\shared_ptr.hpp>
 #include <boost\noncopyable.hpp>
 #include "voxel\TVolume3d.h"
+#include "voxel\TCompressedVolume3d.h"
+#include "voxel\ScratchArena.h"
 
 #include <mgl/MathGeoLib.h>
 
@@ -34,20 +36,66 @@ typedef struct
 
 } Vertex;
 
+///Meshing temporaries, allocated from the per-thread scratch arena of generateMesh.
+typedef std::vector<Vertex, ScratchAllocator<Vertex>> ScratchVertexList;
+typedef std::vector<uint32_t, ScratchAllocator<uint32_t>> ScratchIndexList;
+typedef std::map<EdgeIndex, uint32_t, std::less<EdgeIndex>, ScratchAllocator<std::pair<const EdgeIndex, uint32_t>>> ScratchVertexMap;
+
 float3 LinearInterp(Vector3Int p1, float p1Val, Vector3Int p2, float p2Val,  float value);
 
+///Densities and occluder computed by Chunk::generateTerrain, before the chunk takes them over.
+struct ChunkTerrain
+{
+    boost::shared_ptr<TVolume3d<float>> m_volume;
+    AABB m_occluder;
+    bool m_hasOccluder;
+};
+
 class Chunk : boost::noncopyable
 {
 public:
+    ///Surface threshold used by marching cubes, densities at or below it are solid.
+    static const float ISO_VALUE;
+    ///Densities further than this from ISO_VALUE are clamped when a chunk volume gets compressed.
+    static const float DENSITY_RANGE;
+    ///Largest shift of a surface vertex along its edge, in cells, compression may cause.
+    static const float DENSITY_MAX_SHIFT;
+
     Chunk(AABB bounds, double scale,ChunkManager* pChunkManager);
     ~Chunk(void);
 
     void render(void);
 
+    ///Computes the terrain of the chunk into terrain without changing the chunk, so it can run on
+    /// a worker while the main thread draws and culls the chunk.
+    void generateTerrain(ChunkTerrain& terrain);
+
+    ///Takes over the densities and the occluder of terrain. Main thread only.
+    void setTerrain(const ChunkTerrain& terrain);
+
+    ///Both of the above, on the main thread.
     void generateTerrain(void);
 
     void generateMesh(void);
 
+    ///Scratch arena use of the last generateMesh call on the calling thread.
+    static ScratchArena::Stats getMeshScratchStats(void);
+
+    ///True once generateTerrain has produced densities, compressed or not.
+    bool hasVolume(void) const;
+
+    ///Bytes of density data held, float or compressed.
+    std::size_t getVolumeBytes(void) const;
+
+    ///Bytes of vertex and index data held by m_pMesh.
+    std::size_t getMeshBytes(void) const;
+
+    ///Drop the densities; generateTerrain has to run again before the next generateMesh.
+    void evictVolume(void);
+
+    ///Drop the mesh; it gets rebuilt from the volume the next time the chunk is drawn.
+    void evictMesh(void);
+
     boost::shared_ptr<GfxApi::Mesh> m_pMesh;
 
     AABB m_bounds;
@@ -56,17 +104,64 @@ public:
 
     TOctree<boost::shared_ptr<Chunk>>* m_pTree;
 
+    ///Set while a generateTerrain task for the chunk is queued or running, cleared on the main
+    /// thread by ChunkManager::updateLoDTree once it finished.
     boost::shared_ptr<bool> m_workInProgress;
 
+    ///ChunkManager frame this chunk was last in the visible set, used for LRU eviction.
+    ///Set when the chunk enters and leaves the set, chunks in it count as visible now.
+    std::size_t m_lastVisibleFrame;
+
+    ///Camera distance from the center below which the chunk is too coarse, see
+    /// ChunkManager::isAcceptablePixelError.
+    float m_lodSwitchDistance;
+
+    ///Bumped whenever ChunkManager reschedules the LoD check of the chunk, older entries are stale.
+    std::size_t m_lodStamp;
+
+    ///In ChunkManager::m_visibles.
+    bool m_inVisibleSet;
+
+    ///ChunkTracer::STAGE_SPLIT was recorded and neither the children showing nor a cancel since.
+    bool m_splitPending;
+
+    ///Frustum plane that rejected the chunk last, ChunkCuller tests it first.
+    uint8_t m_cullPlane;
+
+    ///Set when queued for generation, cleared by ChunkManager::markDrawn once the chunk is on screen.
+    bool m_awaitingVisible;
+
+    ///Box inside the solid terrain of the chunk, from the bottom of the meshed cells up to the
+    /// lowest surface, valid if m_hasOccluder. Set together with the densities by setTerrain.
+    AABB m_occluder;
+    bool m_hasOccluder;
+
+    ///Meshed once without any triangles, generateMesh returns at once from then on. Densities are
+    /// deterministic, so this holds across evictions.
+    bool m_noSurface;
+
+    ///getVolumeBytes and getMeshBytes as last added to the ChunkManager totals.
+    std::size_t m_countedVolumeBytes;
+    std::size_t m_countedMeshBytes;
+
     boost::shared_ptr<TVolume3d<float>> m_blockVolumeFloat;
 
+    ///Densities are kept in this form after meshing, m_blockVolumeFloat is dropped then.
+    boost::shared_ptr<TCompressedVolume3d<float>> m_blockVolumeCompressed;
+
 private:
 
 
 
     ChunkManager* m_pChunkManager;
 
-    uint32_t getOrCreateVertex(float3& vertex, std::vector<Vertex>& tmpVectorList, EdgeIndex& idx, std::map<EdgeIndex, uint32_t>& vertexMap);
+    std::size_t m_meshBytes;
+
+    void compressVolume(void);
+
+    void computeOccluder(ChunkTerrain& terrain, double res) const;
+
+    uint32_t getOrCreateVertex(float3& vertex, ScratchVertexList& tmpVectorList, EdgeIndex& idx, ScratchVertexMap& vertexMap);
 
     EdgeIndex makeEdgeIndex(Vector3Int& vertA, Vector3Int& vertB);
 
@@ -0,0 +1,247 @@
+#include "ChunkCuller.h"
+
+#include "Chunk.h"
+
+#include <xmmintrin.h>
+#include <cmath>
+
+
+ChunkCuller::ChunkCuller()
+{
+    m_stats = Stats();
+}
+
+const ChunkCuller::Stats& ChunkCuller::getStats() const
+{
+    return m_stats;
+}
+
+void ChunkCuller::cull(const Frustum& camera, ChunkTree& root, std::vector<Chunk*>& chunks)
+{
+    chunks.clear();
+    m_stats = Stats();
+
+    Plane planes[PLANE_COUNT];
+    camera.GetPlanes(planes);
+
+    for(int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        m_normals[plane] = planes[plane].normal;
+        m_absNormals[plane] = float3(fabs(planes[plane].normal.x), fabs(planes[plane].normal.y), fabs(planes[plane].normal.z));
+        m_distances[plane] = planes[plane].d;
+    }
+
+    unsigned int planeMask = ALL_PLANES;
+    if(classify(root, planeMask))
+    {
+        cullNode(root, planeMask, chunks);
+    }
+
+    m_stats.m_visibleChunks = chunks.size();
+}
+
+bool ChunkCuller::classify(ChunkTree& node, unsigned int& planeMask)
+{
+    Chunk* pChunk = node.getValue().get();
+    if(!pChunk)
+    {
+        return false;
+    }
+
+    m_stats.m_boxTests++;
+
+    float3 center = pChunk->m_bounds.CenterPoint();
+    float3 extents = pChunk->m_bounds.HalfSize();
+
+    //The plane that rejected the node last time first, then the others.
+    int first = pChunk->m_cullPlane;
+
+    for(int i = 0; i < PLANE_COUNT; i++)
+    {
+        int plane = (first + i) % PLANE_COUNT;
+
+        if(!(planeMask & (1 << plane)))
+        {
+            continue;
+        }
+
+        float distance = m_normals[plane].Dot(center) - m_distances[plane];
+        float radius = m_absNormals[plane].Dot(extents);
+
+        if(distance > radius)
+        {
+            pChunk->m_cullPlane = uint8_t(plane);
+            return false;
+        }
+
+        if(distance < -radius)
+        {
+            planeMask &= ~(1 << plane);
+        }
+    }
+
+    return true;
+}
+
+void ChunkCuller::cullNode(ChunkTree& node, unsigned int planeMask, std::vector<Chunk*>& chunks)
+{
+    m_stats.m_nodes++;
+
+    Chunk* pChunk = node.getValue().get();
+
+    if(pChunk && pChunk->m_inVisibleSet)
+    {
+        chunks.push_back(pChunk);
+        return;
+    }
+
+    if(!node.hasChildren())
+    {
+        return;
+    }
+
+    if(!planeMask)
+    {
+        m_stats.m_insideSubtrees++;
+        acceptSubtree(node, chunks);
+        return;
+    }
+
+    bool leafGroup = true;
+    for(auto& corner : cube::corner_t::all())
+    {
+        const boost::shared_ptr<Chunk>& pChild = node.getChild(corner).getValue();
+        if(!pChild || !pChild->m_inVisibleSet)
+        {
+            leafGroup = false;
+            break;
+        }
+    }
+
+    if(leafGroup)
+    {
+        cullLeafGroup(node, planeMask, chunks);
+        return;
+    }
+
+    for(auto& corner : cube::corner_t::all())
+    {
+        ChunkTree& child = node.getChild(corner);
+
+        unsigned int childMask = planeMask;
+        if(classify(child, childMask))
+        {
+            cullNode(child, childMask, chunks);
+        }
+    }
+}
+
+void ChunkCuller::cullLeafGroup(ChunkTree& node, unsigned int planeMask, std::vector<Chunk*>& chunks)
+{
+    m_stats.m_groupTests++;
+    m_stats.m_nodes += 8;
+
+    //Centers and half sizes of the 8 children, as two groups of 4 per component.
+    float centers[3][8];
+    float extents[3][8];
+    Chunk* children[8];
+
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        children[i] = node.getChild(cube::corner_t::get(i)).getValue().get();
+
+        float3 center = children[i]->m_bounds.CenterPoint();
+        float3 extent = children[i]->m_bounds.HalfSize();
+
+        centers[0][i] = center.x;
+        centers[1][i] = center.y;
+        centers[2][i] = center.z;
+        extents[0][i] = extent.x;
+        extents[1][i] = extent.y;
+        extents[2][i] = extent.z;
+    }
+
+    __m128 outside[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+    int outsideMask = 0;
+
+    //Siblings mostly leave the frustum together, through the plane that rejected the first one last time.
+    int first = children[0]->m_cullPlane;
+
+    for(int i = 0; i < PLANE_COUNT; i++)
+    {
+        int plane = (first + i) % PLANE_COUNT;
+
+        if(!(planeMask & (1 << plane)))
+        {
+            continue;
+        }
+
+        __m128 nx = _mm_set1_ps(m_normals[plane].x);
+        __m128 ny = _mm_set1_ps(m_normals[plane].y);
+        __m128 nz = _mm_set1_ps(m_normals[plane].z);
+        __m128 ax = _mm_set1_ps(m_absNormals[plane].x);
+        __m128 ay = _mm_set1_ps(m_absNormals[plane].y);
+        __m128 az = _mm_set1_ps(m_absNormals[plane].z);
+        __m128 d = _mm_set1_ps(m_distances[plane]);
+
+        for(int half = 0; half < 2; half++)
+        {
+            __m128 cx = _mm_loadu_ps(&centers[0][4 * half]);
+            __m128 cy = _mm_loadu_ps(&centers[1][4 * half]);
+            __m128 cz = _mm_loadu_ps(&centers[2][4 * half]);
+            __m128 ex = _mm_loadu_ps(&extents[0][4 * half]);
+            __m128 ey = _mm_loadu_ps(&extents[1][4 * half]);
+            __m128 ez = _mm_loadu_ps(&extents[2][4 * half]);
+
+            __m128 distance = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_mul_ps(nz, cz)), d);
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ex), _mm_mul_ps(ay, ey)), _mm_mul_ps(az, ez));
+
+            outside[half] = _mm_or_ps(outside[half], _mm_cmpgt_ps(distance, radius));
+        }
+
+        //Children this plane rejected first, as classify does it.
+        int rejected = (_mm_movemask_ps(outside[0]) | (_mm_movemask_ps(outside[1]) << 4)) & ~outsideMask;
+        outsideMask |= rejected;
+
+        for(int child = 0; rejected; child++, rejected >>= 1)
+        {
+            if(rejected & 1)
+            {
+                children[child]->m_cullPlane = uint8_t(plane);
+            }
+        }
+
+        //All 8 gone, the other planes can't bring any back.
+        if(outsideMask == 0xff)
+        {
+            return;
+        }
+    }
+
+    for(int i = 0; i < 8; i++)
+    {
+        if(!(outsideMask & (1 << i)))
+        {
+            chunks.push_back(children[i]);
+        }
+    }
+}
+
+void ChunkCuller::acceptSubtree(ChunkTree& node, std::vector<Chunk*>& chunks)
+{
+    Chunk* pChunk = node.getValue().get();
+
+    if(pChunk && pChunk->m_inVisibleSet)
+    {
+        chunks.push_back(pChunk);
+        return;
+    }
+
+    if(node.hasChildren())
+    {
+        for(auto& corner : cube::corner_t::all())
+        {
+            acceptSubtree(node.getChild(corner), chunks);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef _CHUNKCULLER_H
+#define _CHUNKCULLER_H
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "TOctree.h"
+
+#include "mgl/MathGeoLib.h"
+
+class Chunk;
+
+
+///Frustum culling of the visible chunk set by walking the chunk octree from the root.
+///
+///Every node is classified against the planes its parent straddled only. A node inside all of
+/// them has its visible chunks accepted without further tests, a node outside one is dropped with
+/// its subtree. Each chunk remembers the plane that rejected it last, which usually rejects it
+/// again on the next frame, so it is tested first. The 8 children of a node that are all in the
+/// visible set, the bulk of the work, are tested together with SSE.
+class ChunkCuller : boost::noncopyable
+{
+public:
+    typedef TOctree<boost::shared_ptr<Chunk>> ChunkTree;
+
+    struct Stats
+    {
+        std::size_t m_nodes;
+        ///Single boxes tested against the frustum.
+        std::size_t m_boxTests;
+        ///Groups of 8 boxes tested at once.
+        std::size_t m_groupTests;
+        ///Subtrees inside the frustum, accepted without tests.
+        std::size_t m_insideSubtrees;
+        std::size_t m_visibleChunks;
+    };
+
+    ChunkCuller();
+
+    ///Replaces chunks with the chunks of the visible set (Chunk::m_inVisibleSet) under root that
+    /// intersect the frustum of camera.
+    void cull(const Frustum& camera, ChunkTree& root, std::vector<Chunk*>& chunks);
+
+    ///Counts of the last cull call.
+    const Stats& getStats() const;
+
+private:
+    static const int PLANE_COUNT = 6;
+    static const unsigned int ALL_PLANES = (1 << PLANE_COUNT) - 1;
+
+    ///False if node is outside one of the planes in planeMask, otherwise clears the planes it is
+    /// inside of from planeMask.
+    bool classify(ChunkTree& node, unsigned int& planeMask);
+
+    void cullNode(ChunkTree& node, unsigned int planeMask, std::vector<Chunk*>& chunks);
+
+    ///The 8 children of node, all in the visible set, against the planes in planeMask at once.
+    void cullLeafGroup(ChunkTree& node, unsigned int planeMask, std::vector<Chunk*>& chunks);
+
+    void acceptSubtree(ChunkTree& node, std::vector<Chunk*>& chunks);
+
+    ///Planes of the frustum with outward normals, and the absolute values of the normals.
+    float3 m_normals[PLANE_COUNT];
+    float3 m_absNormals[PLANE_COUNT];
+    float m_distances[PLANE_COUNT];
+
+    Stats m_stats;
+};
+
+
+#endif
@@ -1,6 +1,7 @@
 #include "ChunkManager.h"
 
 #include "Chunk.h"
+#include "TerrainNoise.h"
 
 #include <boost/make_shared.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -12,85 +13,116 @@
 
 #include "GfxApi.h"
 
+#include "noisepp/utils/NoiseSystem.h"
+
 #include <set>
+#include <algorithm>
+#include <functional>
+#include <cfloat>
 
 
 
 
-ChunkManager::ChunkManager(void)
+const float ChunkManager::LOD_NODE_SIZE = 8.0f;
+const float ChunkManager::LOD_MIN_DISTANCE = 8.0f * 0.9f;
+
+
+static TVolume3d<float>* createVolume(const ChunkManager::VolumeSize& size)
+{
+    return new TVolume3d<float>(std::get<0>(size), std::get<1>(size), std::get<2>(size));
+}
+
+//Octant of parentBounds at corner. The axes of corner_t are the world axes, so TOctree positions
+// and neighbours line up with the chunk bounds.
+static AABB getChildBounds(const AABB& parentBounds, const cube::corner_t& corner)
 {
+    vec center = parentBounds.CenterPoint();
+
+    return AABB(vec(corner.x() ? center.x : parentBounds.minPoint.x,
+                    corner.y() ? center.y : parentBounds.minPoint.y,
+                    corner.z() ? center.z : parentBounds.minPoint.z),
+                vec(corner.x() ? parentBounds.maxPoint.x : center.x,
+                    corner.y() ? parentBounds.maxPoint.y : center.y,
+                    corner.z() ? parentBounds.maxPoint.z : center.z));
+}
 
-    std::thread chunkLoadThread(&ChunkManager::chunkLoaderThread, this);
-	chunkLoadThread.detach();
+//Box the mesh of a chunk at bounds spans: the meshed cells start one voxel in, but the mesh is
+// drawn from the minimum of bounds, so it ends up shifted one voxel up on each axis.
+static AABB getMeshBounds(const AABB& bounds)
+{
+    float3 shift = bounds.Size() / float(ChunkManager::CHUNK_SIZE);
+
+    return AABB(bounds.minPoint + shift, bounds.maxPoint + shift);
+}
+
+ChunkManager::ChunkManager(void)
+    : m_pOctTree(nullptr)
+    , m_frame(0)
+    , m_volumeBudget(256 * 1024 * 1024)
+    , m_meshBudget(256 * 1024 * 1024)
+    , m_volumeBytes(0)
+    , m_meshBytes(0)
+    , m_visiblesVersion(0)
+    , m_budgetStuck(false)
+    , m_stuckVolumeBytes(0)
+    , m_stuckMeshBytes(0)
+    , m_stuckVisiblesVersion(0)
+    , m_volumePool(&createVolume)
+    , m_threadPool(noisepp::utils::System::getThreadPool())
+    , m_occlusionValid(false)
+    , m_pFrameProfiler(NULL)
+    , m_lodTravel(0)
+    , m_lodCameraPos(0, 0, 0)
+{
+    m_pTerrainNoise.reset(new TerrainNoise());
 
     AABB unitBox(vec(-1000,-1000,-1000), vec(1000,1000,1000));
 
     boost::shared_ptr<Chunk> pChunk = boost::make_shared<Chunk>(unitBox, 1, this);
+    pChunk->m_lodSwitchDistance = getSwitchDistance(unitBox);
 
     pChunk->generateTerrain();
     pChunk->generateMesh();
 
-    m_pOctTree.reset(new ChunkTree(nullptr, nullptr, pChunk, 1, cube::corner_t::get(0, 0, 0)));
+    m_pOctTree = &m_treeArena.createRoot(pChunk, 1, cube::corner_t::get(0, 0, 0));
 
-    pChunk->m_pTree = m_pOctTree.get();
+    pChunk->m_pTree = m_pOctTree;
 
     m_pOctTree->split();
 
     for(auto& corner : cube::corner_t::all())
     {
         initTree1(m_pOctTree->getChild(corner));
-        m_visibles.insert(m_pOctTree->getChild(corner).getValue());
+        addVisible(m_pOctTree->getChild(corner));
     }
 
     updateVisibles(*m_pOctTree);
 
 }
 
-void ChunkManager::chunkLoaderThread() 
+void ChunkManager::queueGenerateTerrain(ChunkTree& node)
 {
-    //this has to be in ms or something, not framerate, but time!
-    //int frameRate = 60;
-
-    //60 fps is ~15 ms / frame
-    std::chrono::milliseconds frametime( 15 );
-    bool did_some_work = false;
-    while(1) 
-    {
-    
-        did_some_work = false;
-
-        std::size_t max_chunks_low_volumes_to_create_per_frame = 1;
-
-        for (std::size_t i = 0; i < max_chunks_low_volumes_to_create_per_frame; ++i)
-        {
-            boost::shared_ptr<Chunk> chunk = m_chunkGeneratorQueue.pop();
-            if(!chunk)
-            {
-                break;
-            }
-
-            chunk->generateTerrain();
-            
-
-            *chunk->m_workInProgress = false;
-
-            did_some_work = true;
-        }
+    boost::shared_ptr<Chunk> pChunk = node.getValueCopy();
 
+    *pChunk->m_workInProgress = true;
 
-        if (!did_some_work)
-        {
-            //we can afford to poll 10 X a frame or even more, thread will remain 100% idle, because of sleep.
-            std::this_thread::sleep_for( frametime / 10);
-        }
+    m_tracer.record(pChunk.get(), ChunkTracer::STAGE_QUEUED);
+    pChunk->m_awaitingVisible = true;
 
+    GeneratorTask task;
+    task.m_pChunk = pChunk;
+    task.m_pTerrain = boost::make_shared<ChunkTerrain>();
 
-    }
+    //The chunk is drawn and culled meanwhile, the task leaves it alone and only fills in terrain.
+    boost::shared_ptr<ChunkTerrain> pTerrain = task.m_pTerrain;
+    task.m_task = m_threadPool.submit([pChunk, pTerrain]()
+    {
+        pChunk->generateTerrain(*pTerrain);
+    }, int(node.getLevel()));
 
+    m_generatorTasks.push_back(task);
 }
 
-
-
 void ChunkManager::updateVisibles(ChunkTree& pTree)
 {
     if(pTree.hasChildren())
@@ -108,7 +140,7 @@ void ChunkManager::updateVisibles(ChunkTree& pTree)
             {
                 pTree.getValue()->generateMesh();
             }
-            m_visibles.insert(pTree.getValue());
+            addVisible(pTree);
         }
     }
 
@@ -120,24 +152,14 @@ void ChunkManager::initTree(ChunkTree&  pChild)
     boost::shared_ptr<Chunk>& pChunk = pChild.getValue();
     
 
-    AABB bounds = pChild.getParent()->getValue()->m_bounds;
-    vec center = bounds.CenterPoint();
-    vec c0 = bounds.CornerPoint(pChild.getCorner().index());
-
-    AABB b0(vec(min(c0.x, center.x),
-                min(c0.y, center.y),
-                min(c0.z, center.z)), 
-            vec(max(c0.x, center.x),
-                max(c0.y, center.y),
-                max(c0.z, center.z)));
+    AABB b0 = getChildBounds(pChild.getParent()->getValue()->m_bounds, pChild.getCorner());
 
     pChunk = boost::make_shared<Chunk>(b0, 1.0f/pChild.getLevel(), this);
+    pChunk->m_lodSwitchDistance = getSwitchDistance(b0);
 
     pChunk->m_pTree = &pChild;
 
-    *pChunk->m_workInProgress = true;
-
-    m_chunkGeneratorQueue.push(pChild.getValueCopy());
+    queueGenerateTerrain(pChild);
 
 }
 
@@ -145,18 +167,10 @@ void ChunkManager::initTree1(ChunkTree&  pChild)
 {
     boost::shared_ptr<Chunk>& pChunk = pChild.getValue();
 
-    AABB bounds = pChild.getParent()->getValue()->m_bounds;
-    vec center = bounds.CenterPoint();
-    vec c0 = bounds.CornerPoint(pChild.getCorner().index());
-
-    AABB b0(vec(min(c0.x, center.x),
-                min(c0.y, center.y),
-                min(c0.z, center.z)), 
-            vec(max(c0.x, center.x),
-                max(c0.y, center.y),
-                max(c0.z, center.z)));
+    AABB b0 = getChildBounds(pChild.getParent()->getValue()->m_bounds, pChild.getCorner());
 
     pChunk = boost::make_shared<Chunk>(b0, 1.0f/pChild.getLevel(), this);
+    pChunk->m_lodSwitchDistance = getSwitchDistance(b0);
 
     pChunk->m_pTree = &pChild;
 
@@ -166,34 +180,25 @@ void ChunkManager::initTree1(ChunkTree&  pChild)
 }
 
 
+//The wanted node size at camera distance d is
+//
+//  size_opt = root / 2^(n_max - log2(d / f_0))   with n_max = log2(root / x_0)
+//           = d * x_0 / f_0
+//
+// for x_0 = LOD_NODE_SIZE, f_0 = LOD_MIN_DISTANCE and d at least f_0. A node is fine while
+// size_opt > size, so it turns too coarse when the camera comes closer than size * f_0 / x_0.
+float ChunkManager::getSwitchDistance(const AABB& bounds)
+{
+    return bounds.Size().Length() * (LOD_MIN_DISTANCE / LOD_NODE_SIZE);
+}
+
 bool ChunkManager::isAcceptablePixelError(float3& cameraPos, ChunkTree& tree)
 {
-    const AABB& box = tree.getValue()->m_bounds;
-
-    const AABB& rootBounds = tree.getRoot()->getValue()->m_bounds;
-  
-    //World length of highest LOD node
-    //float x_0 = 128.0;
-    float x_0 = 8;
-
-    /////All nodes within this distance will surely be rendered
-    float f_0 = x_0 * 0.9;
-  
-    /////Total nodes
-    float t = math::Pow(2 * (f_0 / x_0), 3);
-
-    /////Lowest octree level
-    float n_max = math::Log2(rootBounds.Size().Length() / x_0);
-  
-    /////Node distance from camera
-    float d = max(f_0, box.CenterPoint().Distance(cameraPos));
-  
-    /////Minimum optimal node level
-    float n_opt = n_max - math::Log2(d / f_0);
-  
-    float size_opt = rootBounds.Size().Length() / math::Pow(2, n_opt);
-  
-    return size_opt > box.Size().Length();
+    const Chunk& chunk = *tree.getValue();
+
+    float d = max(LOD_MIN_DISTANCE, chunk.m_bounds.CenterPoint().Distance(cameraPos));
+
+    return d > chunk.m_lodSwitchDistance;
 }
 
 bool ChunkManager::allChildsGenerated(ChunkTree& pChild)
@@ -201,7 +206,7 @@ bool ChunkManager::allChildsGenerated(ChunkTree& pChild)
 
     for(auto& corner : cube::corner_t::all())
     {
-        if(pChild.getChild(corner).getValue() && !pChild.getChild(corner).getValue()->m_blockVolumeFloat)
+        if(pChild.getChild(corner).getValue() && !ensureVolume(pChild.getChild(corner)))
         {
             return false;
         }
@@ -210,6 +215,251 @@ bool ChunkManager::allChildsGenerated(ChunkTree& pChild)
     return true;
 }
 
+bool ChunkManager::ensureVolume(ChunkTree& node)
+{
+    boost::shared_ptr<Chunk>& pChunk = node.getValue();
+
+    if(pChunk->hasVolume())
+    {
+        return true;
+    }
+
+    if(!*pChunk->m_workInProgress)
+    {
+        queueGenerateTerrain(node);
+    }
+
+    return false;
+}
+
+void ChunkManager::setMemoryBudget(std::size_t volumeBytes, std::size_t meshBytes)
+{
+    m_volumeBudget = volumeBytes;
+    m_meshBudget = meshBytes;
+    m_budgetStuck = false;
+}
+
+std::size_t ChunkManager::getVolumeBytes() const
+{
+    return m_volumeBytes;
+}
+
+std::size_t ChunkManager::getMeshBytes() const
+{
+    return m_meshBytes;
+}
+
+const TerrainNoise& ChunkManager::getTerrainNoise() const
+{
+    return *m_pTerrainNoise;
+}
+
+boost::shared_ptr<TVolume3d<float>> ChunkManager::allocateVolume()
+{
+    return m_volumePool.pop(VolumeSize(CHUNK_SIZE + 2, CHUNK_SIZE + 2, CHUNK_SIZE + 2));
+}
+
+ChunkManager::VolumePool::Stats ChunkManager::getVolumePoolStats()
+{
+    return m_volumePool.getStats();
+}
+
+void ChunkManager::markDrawn(Chunk& chunk)
+{
+    if(chunk.m_awaitingVisible)
+    {
+        m_tracer.record(&chunk, ChunkTracer::STAGE_VISIBLE);
+        chunk.m_awaitingVisible = false;
+    }
+}
+
+ChunkTracer& ChunkManager::getTracer()
+{
+    return m_tracer;
+}
+
+void ChunkManager::cullVisibles(const Frustum& camera, std::vector<Chunk*>& chunks)
+{
+    m_culler.cull(camera, *m_pOctTree, chunks);
+}
+
+const ChunkCuller::Stats& ChunkManager::getCullStats() const
+{
+    return m_culler.getStats();
+}
+
+struct OccluderOrder
+{
+    OccluderOrder(const float3& cameraPos) : m_cameraPos(cameraPos) {}
+
+    bool operator()(const Chunk* a, const Chunk* b) const
+    {
+        return a->m_occluder.CenterPoint().DistanceSq(m_cameraPos) < b->m_occluder.CenterPoint().DistanceSq(m_cameraPos);
+    }
+
+    float3 m_cameraPos;
+};
+
+void ChunkManager::cullOccluded(const Frustum& camera, std::vector<Chunk*>& chunks)
+{
+    m_occluders.clear();
+    for(auto pChunk : chunks)
+    {
+        if(pChunk->m_hasOccluder)
+        {
+            m_occluders.push_back(pChunk);
+        }
+    }
+
+    if(m_occluders.size() > MAX_OCCLUDERS)
+    {
+        std::nth_element(m_occluders.begin(), m_occluders.begin() + MAX_OCCLUDERS, m_occluders.end(), OccluderOrder(camera.pos));
+        m_occluders.resize(MAX_OCCLUDERS);
+    }
+
+    m_occlusion.begin(camera);
+    for(auto pChunk : m_occluders)
+    {
+        m_occlusion.addOccluder(pChunk->m_occluder);
+    }
+    m_occlusion.rasterize(&m_threadPool);
+    m_occlusionValid = true;
+
+    //An occluder lies inside its own chunk, so it never hides that chunk.
+    chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [this](Chunk* pChunk)
+    {
+        return m_occlusion.isOccluded(getMeshBounds(pChunk->m_bounds));
+    }), chunks.end());
+
+    if(m_pFrameProfiler)
+    {
+        m_pFrameProfiler->addCount(FrameProfiler::COUNTER_OCCLUDED_CHUNKS, m_occlusion.getStats().m_occluded);
+    }
+}
+
+const OcclusionBuffer& ChunkManager::getOcclusion() const
+{
+    return m_occlusion;
+}
+
+void ChunkManager::collectResident(std::vector<Chunk*>& resident)
+{
+    //Every node in arena order, one pass over contiguous memory instead of a walk down the tree.
+    //The members of chunks being generated are written by the workers, they are not looked at.
+    m_treeArena.forEachNode([&](ChunkTree& node)
+    {
+        Chunk* pChunk = node.getValue().get();
+
+        if(!pChunk)
+        {
+            return;
+        }
+
+        //Whatever is on screen or being generated stays, and so do parents of visible chunks,
+        // which take their place again when they merge.
+        if(!*pChunk->m_workInProgress && !m_visibles.count(node.getValue())
+           && !isVisibleParent(node) && (pChunk->hasVolume() || pChunk->m_pMesh))
+        {
+            resident.push_back(pChunk);
+        }
+    });
+}
+
+bool ChunkManager::isVisibleParent(ChunkTree& node)
+{
+    if(!node.hasChildren())
+    {
+        return false;
+    }
+
+    for(auto& corner : cube::corner_t::all())
+    {
+        const boost::shared_ptr<Chunk>& pChild = node.getChild(corner).getValue();
+        if(pChild && pChild->m_inVisibleSet)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+struct EvictionOrder
+{
+    EvictionOrder(const float3& cameraPos) : m_cameraPos(cameraPos) {}
+
+    bool operator()(const Chunk* a, const Chunk* b) const
+    {
+        if(a->m_lastVisibleFrame != b->m_lastVisibleFrame)
+        {
+            return a->m_lastVisibleFrame < b->m_lastVisibleFrame;
+        }
+
+        return a->m_bounds.CenterPoint().DistanceSq(m_cameraPos) > b->m_bounds.CenterPoint().DistanceSq(m_cameraPos);
+    }
+
+    float3 m_cameraPos;
+};
+
+void ChunkManager::recountMemory(Chunk& chunk)
+{
+    std::size_t volumeBytes = chunk.getVolumeBytes();
+    std::size_t meshBytes = chunk.getMeshBytes();
+
+    m_volumeBytes = m_volumeBytes - chunk.m_countedVolumeBytes + volumeBytes;
+    m_meshBytes = m_meshBytes - chunk.m_countedMeshBytes + meshBytes;
+
+    chunk.m_countedVolumeBytes = volumeBytes;
+    chunk.m_countedMeshBytes = meshBytes;
+}
+
+void ChunkManager::enforceMemoryBudget(const float3& cameraPos)
+{
+    if(m_volumeBytes <= m_volumeBudget && m_meshBytes <= m_meshBudget)
+    {
+        return;
+    }
+
+    if(m_budgetStuck && m_volumeBytes == m_stuckVolumeBytes && m_meshBytes == m_stuckMeshBytes
+        && m_visiblesVersion == m_stuckVisiblesVersion)
+    {
+        return;
+    }
+
+    std::size_t volumeTarget = m_volumeBudget - m_volumeBudget / 8;
+    std::size_t meshTarget = m_meshBudget - m_meshBudget / 8;
+
+    std::vector<Chunk*> resident;
+    collectResident(resident);
+
+    std::sort(resident.begin(), resident.end(), EvictionOrder(cameraPos));
+
+    for(auto pChunk : resident)
+    {
+        if(m_volumeBytes <= volumeTarget && m_meshBytes <= meshTarget)
+        {
+            break;
+        }
+
+        if(m_volumeBytes > volumeTarget && pChunk->hasVolume())
+        {
+            pChunk->evictVolume();
+        }
+
+        if(m_meshBytes > meshTarget && pChunk->m_pMesh)
+        {
+            pChunk->evictMesh();
+        }
+
+        recountMemory(*pChunk);
+    }
+
+    m_budgetStuck = m_volumeBytes > volumeTarget || m_meshBytes > meshTarget;
+    m_stuckVolumeBytes = m_volumeBytes;
+    m_stuckMeshBytes = m_meshBytes;
+    m_stuckVisiblesVersion = m_visiblesVersion;
+}
+
 // 0 -- 0
 // 1 -- 2
 // 2 -- 6
@@ -325,111 +575,286 @@ void ChunkManager::renderBounds(const Frustum& camera)
 
 }
 
-void ChunkManager::updateLoDTree(Frustum& camera)
+void ChunkManager::addVisible(ChunkTree& node)
 {
+    if(m_visibles.insert(node.getValue()).second)
+    {
+        m_visiblesVersion++;
+        node.getValue()->m_inVisibleSet = true;
+        node.getValue()->m_lastVisibleFrame = m_frame;
+        retryLoD(node);
+    }
+}
 
-    VisibleList::iterator w = m_visibles.begin();
-    
+void ChunkManager::removeVisible(ChunkTree& node)
+{
+    if(m_visibles.erase(node.getValue()))
+    {
+        m_visiblesVersion++;
+        node.getValue()->m_inVisibleSet = false;
+        node.getValue()->m_lastVisibleFrame = m_frame;
+
+        //Drops its pending checks.
+        node.getValue()->m_lodStamp++;
+
+        cancelSplit(*node.getValue());
+    }
+}
 
-    while ( w != m_visibles.end() )
+void ChunkManager::cancelSplit(Chunk& chunk)
+{
+    if(chunk.m_splitPending)
     {
-        ChunkTree* visible = (*w)->m_pTree;
+        m_tracer.record(&chunk, ChunkTracer::STAGE_SPLIT_CANCELLED);
+        chunk.m_splitPending = false;
+    }
+}
 
+//How far the camera can move before isAcceptablePixelError of chunk can flip.
+static float getSwitchSlack(const float3& cameraPos, const Chunk& chunk)
+{
+    //Distances are clamped to LOD_MIN_DISTANCE, a switch distance below it is never crossed.
+    if(chunk.m_lodSwitchDistance <= ChunkManager::LOD_MIN_DISTANCE)
+    {
+        return FLT_MAX;
+    }
 
- 
-        BOOST_ASSERT(visible);
-        BOOST_ASSERT(!visible->isRoot());
-    
-        ChunkTree* parent = visible->getParent();
-        BOOST_ASSERT(parent);
-    
-        bool parent_acceptable_error = !parent->isRoot() && isAcceptablePixelError(camera.pos, *parent);
-        bool acceptable_error = isAcceptablePixelError(camera.pos, *visible);
-        
-        BOOST_ASSERT(lif(parent_acceptable_error, acceptable_error));
-        BOOST_ASSERT(lif(!acceptable_error, !parent_acceptable_error));
+    return fabs(chunk.m_bounds.CenterPoint().Distance(cameraPos) - chunk.m_lodSwitchDistance);
+}
+
+void ChunkManager::scheduleLoD(ChunkTree& node, const float3& cameraPos)
+{
+    Chunk& chunk = *node.getValue();
+
+    float slack = getSwitchSlack(cameraPos, chunk);
+
+    ChunkTree* parent = node.getParent();
+    if(!parent->isRoot())
+    {
+        float parentSlack = getSwitchSlack(cameraPos, *parent->getValue());
+        slack = min(slack, parentSlack);
+    }
+
+    chunk.m_lodStamp++;
+
+    //Nothing the camera does changes this node, it goes when its parent or a brother does.
+    if(slack == FLT_MAX)
+    {
+        return;
+    }
+
+    LoDCheck check = { m_lodTravel + slack, node.getIndex(), chunk.m_lodStamp };
+    m_lodQueue.push_back(check);
+    std::push_heap(m_lodQueue.begin(), m_lodQueue.end(), std::greater<LoDCheck>());
+}
+
+void ChunkManager::retryLoD(ChunkTree& node)
+{
+    Chunk& chunk = *node.getValue();
+
+    chunk.m_lodStamp++;
+
+    LoDCheck check = { m_lodTravel, node.getIndex(), chunk.m_lodStamp };
+    m_lodRetries.push_back(check);
+}
+
+bool ChunkManager::isCurrent(const LoDCheck& check)
+{
+    const boost::shared_ptr<Chunk>& pChunk = m_treeArena.getNode(check.m_node).getValue();
+
+    return pChunk && pChunk->m_lodStamp == check.m_stamp;
+}
+
+void ChunkManager::updateLoD(ChunkTree& visible, Frustum& camera)
+{
+    BOOST_ASSERT(!visible.isRoot());
+
+    ChunkTree* parent = visible.getParent();
+    BOOST_ASSERT(parent);
+
+    bool parent_acceptable_error = !parent->isRoot() && isAcceptablePixelError(camera.pos, *parent);
+    bool acceptable_error = isAcceptablePixelError(camera.pos, visible);
     
-        if (parent_acceptable_error)
+    BOOST_ASSERT(lif(parent_acceptable_error, acceptable_error));
+    BOOST_ASSERT(lif(!acceptable_error, !parent_acceptable_error));
+
+    if (parent_acceptable_error)
+    {
+        //The parent shows its mesh right away, it is rebuilt from the volume if that was kept.
+        // Without one the children stay until it is generated again, rather than leaving a hole.
+        if(!ensureVolume(*parent))
         {
-            
-            //Add the parent to visibles
-            m_visibles.insert(parent->getValue());
-            
-            {
-                
-                std::set< boost::shared_ptr<Chunk> >::iterator e = w;
-                ++w;
-                m_visibles.erase(e);
-                continue;
-            }
+            retryLoD(visible);
+            return;
+        }
 
-        } 
-        else if ( acceptable_error) 
+        //Replace visible and its brothers by the parent, they would all come to this anyway.
+        for(auto& corner : cube::corner_t::all())
         {
-            //Let things stay the same
+            removeVisible(parent->getChild(corner));
+        }
+        addVisible(*parent);
+    } 
+    else if (acceptable_error) 
+    {
+        //Let things stay the same, a refinement still waiting for its children is off.
+        cancelSplit(*visible.getValue());
+        scheduleLoD(visible, camera.pos);
+    } 
+    else 
+    {
+        //Outside the frustum nothing is refined, but turning the camera changes that.
+        if(!camera.Intersects(visible.getValue()->m_bounds))
+        {   
+            retryLoD(visible);
+            return;
+        }
 
-        } 
-        else 
+        //Neither behind the terrain, as of the last frame. Once in view it is refined a frame late.
+        if(m_occlusionValid && m_occlusion.isOccluded(getMeshBounds(visible.getValue()->m_bounds)))
+        {
+            retryLoD(visible);
+            return;
+        }
+
+        if (visible.getLevel() < MAX_LOD_LEVEL /*&& !!visible->value()->voxel_volume*/)
         {
-            if(!camera.Intersects(visible->getValue()->m_bounds))
-            {   
-                std::set< boost::shared_ptr<Chunk> >::iterator e = w;
-                ++w;
-               // m_visibles.erase(e);
-                continue;
+            //Traced from the first attempt, also when the children exist from an earlier split
+            // and only need their volumes back.
+            if(!visible.getValue()->m_splitPending)
+            {
+                m_tracer.record(visible.getValue().get(), ChunkTracer::STAGE_SPLIT);
+                visible.getValue()->m_splitPending = true;
             }
-            if (visible->getLevel() < MAX_LOD_LEVEL /*&& !!visible->value()->voxel_volume*/)
+
+            //If visible doesn't have children
+            if (!visible.hasChildren())
             {
-            
-                //If visible doesn't have children
-                if (!visible->hasChildren())
+                //Create children for visible
+                visible.split();
+                for(auto& corner : cube::corner_t::all())
                 {
-                    //Create children for visible
-                    visible->split();
-                    for(auto& corner : cube::corner_t::all())
-                    {
-                        initTree(visible->getChild(corner));
-                    }
+                    initTree(visible.getChild(corner));
                 }
+            }
 
-
-
-           
-                if(visible->hasChildren() && allChildsGenerated(*visible))
+            if(allChildsGenerated(visible))
+            {
+                //Foreach child of visible
+                for(auto& corner : cube::corner_t::all())
                 {
-                    //Foreach child of visible
-                    for(auto& corner : cube::corner_t::all())
-                    {
-                        m_visibles.insert(visible->getChild(corner).getValue());
-                    }
-
-                    ///Remove visible from visibles
-                    {
-                        std::set< boost::shared_ptr<Chunk> >::iterator e = w;
-                        ++w;
-                        m_visibles.erase(e);
-                        continue;
-                    }
- 
+                    addVisible(visible.getChild(corner));
                 }
+                m_tracer.record(visible.getValue().get(), ChunkTracer::STAGE_CHILDREN_VISIBLE);
+                visible.getValue()->m_splitPending = false;
 
-                
-            
-            } 
-            else 
+                ///Remove visible from visibles
+                removeVisible(visible);
+            }
+            else
             {
-        
+                //Children still generating, look again next frame.
+                retryLoD(visible);
             }
+        } 
+        else 
+        {
+            scheduleLoD(visible, camera.pos);
+        }
+    }
+}
+
+void ChunkManager::updateLoDTree(Frustum& camera)
+{
+    ++m_frame;
+
+    m_tracer.collect();
+
+    if(m_frame > 1)
+    {
+        m_lodTravel += m_lodCameraPos.Distance(camera.pos);
+    }
+    m_lodCameraPos = camera.pos;
+
+    //Checks added while these run are for the next call.
+    std::vector<LoDCheck> due;
+    due.swap(m_lodRetries);
+
+    while(!m_lodQueue.empty() && m_lodQueue.front().m_travel < m_lodTravel)
+    {
+        due.push_back(m_lodQueue.front());
+        std::pop_heap(m_lodQueue.begin(), m_lodQueue.end(), std::greater<LoDCheck>());
+        m_lodQueue.pop_back();
+    }
+
+    for(auto& check : due)
+    {
+        //Nodes that left the visible set or were rescheduled since are skipped.
+        if(isCurrent(check))
+        {
+            updateLoD(m_treeArena.getNode(check.m_node), camera);
+        }
+    }
+
+    //Stale checks pile up in the heap while nodes come and go, drop them once they dominate.
+    if(m_lodQueue.size() > 2 * m_visibles.size() + 64)
+    {
+        m_lodQueue.erase(std::remove_if(m_lodQueue.begin(), m_lodQueue.end(),
+            [this](const LoDCheck& check) { return !isCurrent(check); }), m_lodQueue.end());
+        std::make_heap(m_lodQueue.begin(), m_lodQueue.end(), std::greater<LoDCheck>());
+    }
+
+    //Finished tasks are dropped, wait() returns at once for them and throws what generateTerrain threw.
+    auto finished = std::partition(m_generatorTasks.begin(), m_generatorTasks.end(),
+        [](GeneratorTask& task) { return !task.m_task.isDone(); });
+    std::vector<GeneratorTask> finishedTasks(finished, m_generatorTasks.end());
+    m_generatorTasks.erase(finished, m_generatorTasks.end());
+
+    //isDone synchronizes with the end of the task, what it wrote is safe to read from here on.
+    //The flag is cleared on failure too, the exception comes out of wait() below.
+    for(auto& task : finishedTasks)
+    {
+        if(task.m_pTerrain->m_volume)
+        {
+            task.m_pChunk->setTerrain(*task.m_pTerrain);
         }
+        *task.m_pChunk->m_workInProgress = false;
+
+        recountMemory(*task.m_pChunk);
+    }
+    for(auto& task : finishedTasks)
+    {
+        task.m_task.wait();
+    }
+
+    enforceMemoryBudget(camera.pos);
 
-        ++w;
+    //Evictions and LoD changes free volumes in bursts, don't keep all of them around.
+    if(m_frame % POOL_TRIM_INTERVAL == 0)
+    {
+        m_volumePool.trim();
     }
-  
 }
 
 
 ChunkManager::~ChunkManager(void)
 {
+    //Chunks not started yet are dropped, running ones still use m_volumePool.
+    for(auto& task : m_generatorTasks)
+    {
+        task.m_task.cancel();
+    }
+    for(auto& task : m_generatorTasks)
+    {
+        //Nothing to report failures to anymore, and throwing here would terminate.
+        try
+        {
+            task.m_task.wait();
+        }
+        catch(...)
+        {
+        }
+    }
 }
 
 
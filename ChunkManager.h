@@ -3,16 +3,26 @@
 
 #include <vector>
 #include <list>
+#include <queue>
 #include <set>
+#include <tuple>
 #include <boost/shared_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include "TOctree.h"
-#include "TQueueLocked.h"
+#include "voxel/TVolume3d.h"
+#include "voxel/TVolumePool.h"
+#include "noisepp/core/NoiseThreadPool.h"
+#include "ChunkTrace.h"
+#include "FrameProfiler.h"
+#include "ChunkCuller.h"
+#include "OcclusionBuffer.h"
 
 #include "mgl/MathGeoLib.h"
 
 class Chunk;
+struct ChunkTerrain;
+class TerrainNoise;
 
 class ChunkManager
 {
@@ -21,10 +31,26 @@ public:
     ~ChunkManager(void);
 
     typedef TOctree<boost::shared_ptr<Chunk>> ChunkTree;
+    typedef TOctreeArena<boost::shared_ptr<Chunk>> ChunkTreeArena;
 
     static const int CHUNK_SIZE = 32;
     static const int MAX_LOD_LEVEL = 8;
 
+    ///World length of a chunk at the finest level the LoD aims for.
+    static const float LOD_NODE_SIZE;
+    ///Chunks closer than this are treated as being this far away.
+    static const float LOD_MIN_DISTANCE;
+
+    ///Size class of pooled volumes: x, y and z size.
+    typedef std::tuple<std::size_t, std::size_t, std::size_t> VolumeSize;
+    typedef TVolumePool<TVolume3d<float>, VolumeSize> VolumePool;
+
+    ///updateLoDTree calls between two VolumePool::trim calls.
+    static const std::size_t POOL_TRIM_INTERVAL = 120;
+
+    ///Chunks rasterized into the occlusion buffer per frame, the nearest ones with occluders.
+    static const std::size_t MAX_OCCLUDERS = 64;
+
     void render(void);
 
     void initTree(ChunkTree& pChild);
@@ -34,23 +60,170 @@ public:
 
     void updateVisibles(ChunkTree& pTree);
 
+    ///Re-evaluates the LoD of visible nodes whose switch distances the camera may have crossed since
+    /// their last check, and of nodes waiting for their children or outside the frustum.
     void updateLoDTree(Frustum& camera);
 
     bool isAcceptablePixelError(float3& cameraPos, ChunkTree& tree);
 
-    void chunkLoaderThread();
+    ///Camera distance below which the node at bounds is too coarse.
+    static float getSwitchDistance(const AABB& bounds);
+
+    ///Queues generateTerrain for the chunk of node on m_threadPool, finer levels first.
+    void queueGenerateTerrain(ChunkTree& node);
 
     void renderBounds(const Frustum& cameraPos);
 
-    TQueueLocked<boost::shared_ptr<Chunk>> m_chunkGeneratorQueue;
+    ///Returns true if the chunk has densities, otherwise queues generateTerrain for it (once).
+    bool ensureVolume(ChunkTree& node);
+
+    ///Budgets in bytes for chunk density volumes (CPU) and chunk meshes (GPU).
+    void setMemoryBudget(std::size_t volumeBytes, std::size_t meshBytes);
+
+    ///Once a budget is exceeded, evicts volumes and meshes of chunks outside the visible set until
+    /// both are back under 7/8 of the budget, so the search for candidates stays rare. When the
+    /// visible set alone is over budget, it is not searched again until something changes.
+    ///Least recently visible chunks go first, the farthest ones among equals.
+    void enforceMemoryBudget(const float3& cameraPos);
+
+    ///Brings the byte totals up to date with the volume and mesh chunk holds now. Main thread only,
+    /// never while generateTerrain runs for chunk.
+    void recountMemory(Chunk& chunk);
+
+    std::size_t getVolumeBytes() const;
+    std::size_t getMeshBytes() const;
+
+    ///The terrain graph all generateTerrain calls evaluate.
+    const TerrainNoise& getTerrainNoise() const;
+
+    ///Chunk sized density volume (CHUNK_SIZE + 2 per axis) from m_volumePool, contents undefined.
+    ///It goes back to the pool when the last reference is dropped.
+    boost::shared_ptr<TVolume3d<float>> allocateVolume();
+
+    VolumePool::Stats getVolumePoolStats();
+
+    ///Called by the renderer for every chunk it draws, traces when a queued chunk first shows up.
+    void markDrawn(Chunk& chunk);
+
+    ///Stage timestamps and latency histograms of chunk generation, collected every updateLoDTree.
+    ChunkTracer& getTracer();
+
+    ///Replaces chunks with the chunks of m_visibles that intersect the frustum of camera.
+    void cullVisibles(const Frustum& camera, std::vector<Chunk*>& chunks);
+
+    const ChunkCuller::Stats& getCullStats() const;
+
+    ///Rasterizes the occluders of the chunks nearest to camera among chunks into m_occlusion, then
+    /// removes the chunks hidden behind them. updateLoDTree holds back refining chunks that were
+    /// hidden this way on the previous frame.
+    void cullOccluded(const Frustum& camera, std::vector<Chunk*>& chunks);
+
+    const OcclusionBuffer& getOcclusion() const;
 
 //private:
     std::vector< boost::shared_ptr<Chunk> > m_chunkList;
 
-    boost::scoped_ptr< ChunkTree > m_pOctTree;
+    ///Nodes of the chunk octree, m_pOctTree is its root.
+    ChunkTreeArena m_treeArena;
+    ChunkTree* m_pOctTree;
     typedef std::set< boost::shared_ptr<Chunk> > VisibleList;
     VisibleList m_visibles;
 
+    std::size_t m_frame;
+
+    std::size_t m_volumeBudget;
+    std::size_t m_meshBudget;
+
+    ///Sums of Chunk::m_countedVolumeBytes and Chunk::m_countedMeshBytes, see recountMemory.
+    std::size_t m_volumeBytes;
+    std::size_t m_meshBytes;
+
+    ///Bumped whenever m_visibles changes.
+    std::size_t m_visiblesVersion;
+
+    ///Totals and m_visiblesVersion after the last enforceMemoryBudget pass that could not get under
+    /// the targets, what was left were visible chunks and their parents. Until one of them changes
+    /// another pass would not find anything either.
+    bool m_budgetStuck;
+    std::size_t m_stuckVolumeBytes;
+    std::size_t m_stuckMeshBytes;
+    std::size_t m_stuckVisiblesVersion;
+
+    VolumePool m_volumePool;
+
+    boost::scoped_ptr<TerrainNoise> m_pTerrainNoise;
+
+    ///Process wide pool running generateTerrain of queued chunks, see noisepp::utils::System::getThreadPool.
+    noisepp::ThreadPool& m_threadPool;
+
+    struct GeneratorTask
+    {
+        noisepp::TaskHandle m_task;
+        boost::shared_ptr<Chunk> m_pChunk;
+        ///Written by the task only, handed to the chunk once the task is done.
+        boost::shared_ptr<ChunkTerrain> m_pTerrain;
+    };
+
+    ///Queued or running generateTerrain calls, updateLoDTree hands the terrain of finished ones
+    /// to their chunks, counts and drops them.
+    std::vector<GeneratorTask> m_generatorTasks;
+
+    ChunkTracer m_tracer;
+
+    ChunkCuller m_culler;
+
+    ///Depth of the occluders of the last cullOccluded call.
+    OcclusionBuffer m_occlusion;
+    bool m_occlusionValid;
+    std::vector<Chunk*> m_occluders;
+
+    ///Meshing and uploads are timed and counted into it when set, see MainClass::onTick.
+    FrameProfiler* m_pFrameProfiler;
+
+private:
+    ///A visible node due for a LoD check once m_lodTravel passes m_travel.
+    struct LoDCheck
+    {
+        double m_travel;
+        uint32_t m_node;
+        ///Chunk::m_lodStamp when scheduled, the check is stale if it changed since.
+        std::size_t m_stamp;
+
+        bool operator>(const LoDCheck& other) const
+        {
+            return m_travel > other.m_travel;
+        }
+    };
+
+    void collectResident(std::vector<Chunk*>& resident);
+
+    ///True if a child of node is in the visible set.
+    bool isVisibleParent(ChunkTree& node);
+
+    void addVisible(ChunkTree& node);
+    void removeVisible(ChunkTree& node);
+
+    ///Closes the traced split of chunk without a latency, if one is open.
+    void cancelSplit(Chunk& chunk);
+
+    void updateLoD(ChunkTree& visible, Frustum& camera);
+
+    ///Checks node again once the camera has travelled as far as the nearest switch distance is.
+    void scheduleLoD(ChunkTree& node, const float3& cameraPos);
+    ///Checks node again on the next updateLoDTree.
+    void retryLoD(ChunkTree& node);
+
+    bool isCurrent(const LoDCheck& check);
+
+    ///Distance the camera covered over all updateLoDTree calls. A node's decision can't change
+    /// before the camera has moved as far as the nearest of its switch distances.
+    double m_lodTravel;
+    float3 m_lodCameraPos;
+
+    ///Min heap on LoDCheck::m_travel.
+    std::vector<LoDCheck> m_lodQueue;
+    std::vector<LoDCheck> m_lodRetries;
+
 };
 
 
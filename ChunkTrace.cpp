@@ -0,0 +1,287 @@
+#include "ChunkTrace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <cassert>
+
+
+//Which stages a latency is measured between.
+static const ChunkTracer::Stage LATENCY_STAGES[ChunkTracer::LATENCY_COUNT][2] =
+{
+    { ChunkTracer::STAGE_QUEUED, ChunkTracer::STAGE_TERRAIN_BEGIN },
+    { ChunkTracer::STAGE_TERRAIN_BEGIN, ChunkTracer::STAGE_TERRAIN_END },
+    { ChunkTracer::STAGE_MESH_BEGIN, ChunkTracer::STAGE_UPLOAD_BEGIN },
+    { ChunkTracer::STAGE_UPLOAD_BEGIN, ChunkTracer::STAGE_UPLOAD_END },
+    { ChunkTracer::STAGE_QUEUED, ChunkTracer::STAGE_VISIBLE },
+    { ChunkTracer::STAGE_SPLIT, ChunkTracer::STAGE_CHILDREN_VISIBLE }
+};
+
+static const char* LATENCY_NAMES[ChunkTracer::LATENCY_COUNT] =
+{
+    "queue wait",
+    "terrain",
+    "mesh",
+    "upload",
+    "queued to visible",
+    "split to children visible"
+};
+
+static std::atomic<std::size_t> s_nextTracerId(1);
+
+
+ChunkTracer::ThreadBuffer::ThreadBuffer(std::size_t capacity, std::size_t thread)
+    : m_events(capacity)
+    , m_head(0)
+    , m_tail(0)
+    , m_dropped(0)
+    , m_thread(thread)
+{
+
+}
+
+ChunkTracer::ChunkTracer(std::size_t bufferEvents, std::size_t maxTraceEvents)
+    : m_id(s_nextTracerId++)
+    , m_bufferEvents(bufferEvents)
+    , m_maxSpans(maxTraceEvents)
+    , m_startTick(Clock::Tick())
+{
+    assert(bufferEvents && !(bufferEvents & (bufferEvents - 1)));
+}
+
+ChunkTracer::~ChunkTracer()
+{
+    for(auto pBuffer : m_buffers)
+    {
+        delete pBuffer;
+    }
+}
+
+ChunkTracer::ThreadBuffer& ChunkTracer::getThreadBuffer()
+{
+    static __declspec(thread) ThreadBuffer* pBuffer = nullptr;
+    static __declspec(thread) std::size_t tracerId = 0;
+
+    //First event of this thread for this tracer, the only time record() takes a lock.
+    if(tracerId != m_id)
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+        pBuffer = new ThreadBuffer(m_bufferEvents, m_buffers.size());
+        m_buffers.push_back(pBuffer);
+        tracerId = m_id;
+    }
+
+    return *pBuffer;
+}
+
+void ChunkTracer::record(const Chunk* pChunk, Stage stage)
+{
+    record(pChunk, stage, Clock::Tick());
+}
+
+void ChunkTracer::record(const Chunk* pChunk, Stage stage, tick_t tick)
+{
+    ThreadBuffer& buffer = getThreadBuffer();
+
+    std::size_t head = buffer.m_head.load(std::memory_order_relaxed);
+
+    if(head - buffer.m_tail.load(std::memory_order_acquire) == buffer.m_events.size())
+    {
+        buffer.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event& event = buffer.m_events[head & (buffer.m_events.size() - 1)];
+    event.m_pChunk = pChunk;
+    event.m_stage = stage;
+    event.m_tick = tick;
+    event.m_thread = buffer.m_thread;
+
+    buffer.m_head.store(head + 1, std::memory_order_release);
+}
+
+void ChunkTracer::collect()
+{
+    m_drained.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+        for(auto pBuffer : m_buffers)
+        {
+            std::size_t head = pBuffer->m_head.load(std::memory_order_acquire);
+            std::size_t tail = pBuffer->m_tail.load(std::memory_order_relaxed);
+
+            for(; tail != head; tail++)
+            {
+                m_drained.push_back(pBuffer->m_events[tail & (pBuffer->m_events.size() - 1)]);
+            }
+
+            pBuffer->m_tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    //Stages of one chunk can come from different threads; whatever came before an event is
+    // drained with it at the latest, so time order is enough to pair them up.
+    std::stable_sort(m_drained.begin(), m_drained.end(), [](const Event& a, const Event& b)
+    {
+        return a.m_tick < b.m_tick;
+    });
+
+    for(auto& event : m_drained)
+    {
+        process(event);
+    }
+}
+
+void ChunkTracer::process(const Event& event)
+{
+    std::vector<tick_t>& stages = m_pending[event.m_pChunk];
+    stages.resize(STAGE_COUNT, 0);
+
+    //Queued again, after an eviction or for a remesh: start over, except for a split in progress.
+    if(event.m_stage == STAGE_QUEUED)
+    {
+        std::fill(stages.begin(), stages.begin() + STAGE_VISIBLE + 1, 0);
+    }
+
+    if(event.m_stage == STAGE_SPLIT_CANCELLED)
+    {
+        stages[STAGE_SPLIT] = 0;
+    }
+
+    stages[event.m_stage] = event.m_tick;
+
+    for(std::size_t latency = 0; latency < LATENCY_COUNT; latency++)
+    {
+        Stage begin = LATENCY_STAGES[latency][0];
+
+        if(LATENCY_STAGES[latency][1] != event.m_stage || !stages[begin])
+        {
+            continue;
+        }
+
+        tick_t ticks = event.m_tick > stages[begin] ? event.m_tick - stages[begin] : 0;
+        m_histograms[latency].record(uint64_t(double(ticks) * 1000000.0 / double(Clock::TicksPerSec())));
+
+        Span span = { Latency(latency), event.m_pChunk, stages[begin], event.m_tick, event.m_thread };
+        m_spans.push_back(span);
+        if(m_spans.size() > m_maxSpans)
+        {
+            m_spans.pop_front();
+        }
+
+        //Keep the begin for latencies ending further down the line, like queued to visible.
+        bool later = false;
+        for(std::size_t other = 0; other < LATENCY_COUNT; other++)
+        {
+            later = later || (LATENCY_STAGES[other][0] == begin && LATENCY_STAGES[other][1] > event.m_stage);
+        }
+        if(!later)
+        {
+            stages[begin] = 0;
+        }
+    }
+
+    //Only stages that begin a span need to be kept.
+    bool begins = false;
+    for(std::size_t latency = 0; latency < LATENCY_COUNT; latency++)
+    {
+        begins = begins || LATENCY_STAGES[latency][0] == event.m_stage;
+    }
+    if(!begins)
+    {
+        stages[event.m_stage] = 0;
+    }
+
+    //Drop the chunk once nothing is open any more.
+    if(std::find_if(stages.begin(), stages.end(), [](tick_t tick) { return tick != 0; }) == stages.end())
+    {
+        m_pending.erase(event.m_pChunk);
+    }
+}
+
+const LatencyHistogram& ChunkTracer::getHistogram(Latency latency) const
+{
+    return m_histograms[latency];
+}
+
+const char* ChunkTracer::getLatencyName(Latency latency)
+{
+    return LATENCY_NAMES[latency];
+}
+
+std::size_t ChunkTracer::getDroppedEvents() const
+{
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+    std::size_t dropped = 0;
+    for(auto pBuffer : m_buffers)
+    {
+        dropped += pBuffer->m_dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void ChunkTracer::resetHistograms()
+{
+    for(auto& histogram : m_histograms)
+    {
+        histogram.reset();
+    }
+}
+
+void ChunkTracer::writeSummary(std::ostream& out) const
+{
+    out << std::setw(28) << std::left << "latency (us)" << std::right
+        << std::setw(10) << "count"
+        << std::setw(12) << "mean"
+        << std::setw(12) << "p50"
+        << std::setw(12) << "p90"
+        << std::setw(12) << "p99"
+        << std::setw(12) << "max" << "\n";
+
+    for(std::size_t latency = 0; latency < LATENCY_COUNT; latency++)
+    {
+        const LatencyHistogram& histogram = m_histograms[latency];
+
+        out << std::setw(28) << std::left << LATENCY_NAMES[latency] << std::right
+            << std::setw(10) << histogram.getCount()
+            << std::setw(12) << uint64_t(histogram.getMean())
+            << std::setw(12) << histogram.getPercentile(50)
+            << std::setw(12) << histogram.getPercentile(90)
+            << std::setw(12) << histogram.getPercentile(99)
+            << std::setw(12) << histogram.getMax() << "\n";
+    }
+
+    out << "dropped events: " << getDroppedEvents() << "\n";
+}
+
+void ChunkTracer::writeChromeTrace(std::ostream& out) const
+{
+    double microsecondsPerTick = 1000000.0 / double(Clock::TicksPerSec());
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    bool first = true;
+    for(auto& span : m_spans)
+    {
+        if(!first)
+        {
+            out << ",";
+        }
+        first = false;
+
+        double begin = double(span.m_begin - m_startTick) * microsecondsPerTick;
+        double duration = double(span.m_end - span.m_begin) * microsecondsPerTick;
+
+        //Spans sit on the thread that ended them: the generator for terrain, the main thread for the rest.
+        out << "\n{\"name\":\"" << LATENCY_NAMES[span.m_latency] << "\",\"cat\":\"chunk\",\"ph\":\"X\""
+            << ",\"pid\":1,\"tid\":" << span.m_thread
+            << std::fixed << std::setprecision(1)
+            << ",\"ts\":" << begin << ",\"dur\":" << duration
+            << ",\"args\":{\"chunk\":\"" << static_cast<const void*>(span.m_pChunk) << "\"}}";
+    }
+
+    out << "\n]}\n";
+}
@@ -0,0 +1,145 @@
+#ifndef _CHUNKTRACE_H
+#define _CHUNKTRACE_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <boost/noncopyable.hpp>
+
+#include "voxel/LatencyHistogram.h"
+
+#include "mgl/MathGeoLib.h"
+
+class Chunk;
+
+
+///Timestamps of the stages a chunk goes through, from being queued for generation to being on screen,
+/// turned into latency histograms and a Chrome trace.
+///
+///record() may be called from any thread and never blocks: every thread appends to a ring buffer of
+/// its own, and drops the event if the buffer is full. collect() drains the buffers on the main
+/// thread, pairs up the stages of each chunk and records the latencies.
+class ChunkTracer : boost::noncopyable
+{
+public:
+    enum Stage
+    {
+        STAGE_QUEUED,
+        STAGE_TERRAIN_BEGIN,
+        STAGE_TERRAIN_END,
+        STAGE_MESH_BEGIN,
+        STAGE_UPLOAD_BEGIN,
+        STAGE_UPLOAD_END,
+        ///First frame the chunk was drawn after being queued.
+        STAGE_VISIBLE,
+        ///The LoD update split the chunk, its children are being generated.
+        STAGE_SPLIT,
+        ///The children of a split chunk replaced it in the visible set.
+        STAGE_CHILDREN_VISIBLE,
+        ///The split was given up before the children showed, no latency is recorded for it.
+        STAGE_SPLIT_CANCELLED,
+        STAGE_COUNT
+    };
+
+    ///Latencies between two stages of the same chunk, in microseconds.
+    enum Latency
+    {
+        ///Queued until the generator picked it up.
+        LATENCY_QUEUE_WAIT,
+        LATENCY_TERRAIN,
+        ///Marching cubes, up to the GPU upload.
+        LATENCY_MESH,
+        LATENCY_UPLOAD,
+        LATENCY_QUEUED_TO_VISIBLE,
+        ///Split requested until the children are visible, how quickly the LoD follows the camera.
+        LATENCY_SPLIT_TO_VISIBLE,
+        LATENCY_COUNT
+    };
+
+    ///bufferEvents: ring buffer size per thread, a power of two.
+    ///maxTraceEvents: spans kept for writeChromeTrace, older ones are dropped.
+    ChunkTracer(std::size_t bufferEvents = 4096, std::size_t maxTraceEvents = 64 * 1024);
+    ~ChunkTracer();
+
+    ///Any thread, lock free.
+    void record(const Chunk* pChunk, Stage stage);
+    void record(const Chunk* pChunk, Stage stage, tick_t tick);
+
+    ///Main thread, once per frame.
+    void collect();
+
+    const LatencyHistogram& getHistogram(Latency latency) const;
+
+    static const char* getLatencyName(Latency latency);
+
+    ///Events lost to full thread buffers.
+    std::size_t getDroppedEvents() const;
+
+    void resetHistograms();
+
+    ///Count, mean and percentiles of every latency, one line each.
+    void writeSummary(std::ostream& out) const;
+
+    ///The spans collected so far, as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+    void writeChromeTrace(std::ostream& out) const;
+
+private:
+    struct Event
+    {
+        const Chunk* m_pChunk;
+        Stage m_stage;
+        tick_t m_tick;
+        std::size_t m_thread;
+    };
+
+    ///Single producer, single consumer: the owning thread writes m_head, collect() writes m_tail.
+    struct ThreadBuffer
+    {
+        ThreadBuffer(std::size_t capacity, std::size_t thread);
+
+        std::vector<Event> m_events;
+        std::atomic<std::size_t> m_head;
+        std::atomic<std::size_t> m_tail;
+        std::atomic<std::size_t> m_dropped;
+        std::size_t m_thread;
+    };
+
+    struct Span
+    {
+        Latency m_latency;
+        const Chunk* m_pChunk;
+        tick_t m_begin;
+        tick_t m_end;
+        std::size_t m_thread;
+    };
+
+    ThreadBuffer& getThreadBuffer();
+
+    void process(const Event& event);
+
+    ///Identifies this tracer to the per thread buffer lookup, never reused.
+    std::size_t m_id;
+    std::size_t m_bufferEvents;
+
+    mutable std::mutex m_buffersMutex;
+    std::vector<ThreadBuffer*> m_buffers;
+
+    ///Everything below is only touched by collect() and the main thread.
+    std::vector<Event> m_drained;
+
+    ///Stage timestamps of chunks with spans still open, 0 for stages not reached.
+    std::map<const Chunk*, std::vector<tick_t>> m_pending;
+
+    LatencyHistogram m_histograms[LATENCY_COUNT];
+
+    std::deque<Span> m_spans;
+    std::size_t m_maxSpans;
+
+    tick_t m_startTick;
+};
+
+
+#endif
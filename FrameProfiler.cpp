@@ -0,0 +1,286 @@
+#include "FrameProfiler.h"
+
+#include <GL/glew.h>
+
+#include <iomanip>
+#include <cassert>
+
+
+static const char* SECTION_NAMES[FrameProfiler::SECTION_COUNT] =
+{
+    "lod_update",
+    "input",
+    "meshing",
+    "upload",
+    "draw",
+    "swap",
+    "occlusion"
+};
+
+static const char* COUNTER_NAMES[FrameProfiler::COUNTER_COUNT] =
+{
+    "visible_chunks",
+    "draw_calls",
+    "triangles",
+    "bytes_uploaded",
+    "occluded_chunks"
+};
+
+
+FrameProfiler::Scope::Scope(FrameProfiler* pProfiler, Section section)
+    : m_pProfiler(pProfiler)
+    , m_section(section)
+{
+    if(m_pProfiler)
+    {
+        m_pProfiler->beginSection(m_section);
+    }
+}
+
+FrameProfiler::Scope::~Scope()
+{
+    if(m_pProfiler)
+    {
+        m_pProfiler->endSection(m_section);
+    }
+}
+
+
+FrameProfiler::FrameProfiler(std::size_t frameHistory)
+    : m_frames(frameHistory)
+    , m_framesDone(0)
+    , m_frameBegin(0)
+    , m_inFrame(false)
+    , m_sectionBegin(0)
+    , m_startTick(Clock::Tick())
+    , m_gpuTimer(false)
+{
+    assert(frameHistory);
+
+    m_current = Frame();
+
+    for(std::size_t i = 0; i < GPU_QUERY_COUNT; i++)
+    {
+        m_gpuQueries[i] = 0;
+        m_gpuQueryFrame[i] = NO_FRAME;
+    }
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    //The queries go with the GL context, see releaseGpuTimer.
+}
+
+void FrameProfiler::initGpuTimer()
+{
+    if(m_gpuTimer || !(GLEW_ARB_timer_query || GLEW_VERSION_3_3))
+    {
+        return;
+    }
+
+    glGenQueries(GPU_QUERY_COUNT, m_gpuQueries);
+    m_gpuTimer = true;
+}
+
+void FrameProfiler::releaseGpuTimer()
+{
+    if(!m_gpuTimer)
+    {
+        return;
+    }
+
+    if(m_inFrame)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    glDeleteQueries(GPU_QUERY_COUNT, m_gpuQueries);
+    m_gpuTimer = false;
+
+    for(std::size_t i = 0; i < GPU_QUERY_COUNT; i++)
+    {
+        m_gpuQueries[i] = 0;
+        m_gpuQueryFrame[i] = NO_FRAME;
+    }
+}
+
+bool FrameProfiler::isGpuTimerEnabled() const
+{
+    return m_gpuTimer;
+}
+
+void FrameProfiler::beginFrame()
+{
+    assert(!m_inFrame);
+
+    m_frameBegin = Clock::Tick();
+    m_inFrame = true;
+
+    m_current = Frame();
+    m_current.m_index = m_framesDone;
+    m_current.m_startMs = Clock::TicksToMillisecondsD(m_frameBegin - m_startTick);
+    m_current.m_gpuMs = -1.0;
+
+    if(m_gpuTimer)
+    {
+        //A query still in flight after GPU_QUERY_COUNT frames is given up on, its frame keeps -1.
+        std::size_t slot = m_current.m_index % GPU_QUERY_COUNT;
+        m_gpuQueryFrame[slot] = m_current.m_index;
+        glBeginQuery(GL_TIME_ELAPSED, m_gpuQueries[slot]);
+    }
+}
+
+void FrameProfiler::endFrame()
+{
+    assert(m_inFrame);
+
+    tick_t now = Clock::Tick();
+
+    //Sections left open count up to here.
+    if(!m_sectionStack.empty())
+    {
+        closeSection(now);
+        m_sectionStack.clear();
+    }
+
+    if(m_gpuTimer)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    m_current.m_cpuMs = Clock::TicksToMillisecondsD(now - m_frameBegin);
+    m_frames[m_current.m_index % m_frames.size()] = m_current;
+
+    m_framesDone++;
+    m_inFrame = false;
+
+    if(m_gpuTimer)
+    {
+        readGpuTimers();
+    }
+}
+
+void FrameProfiler::beginSection(Section section)
+{
+    tick_t now = Clock::Tick();
+
+    if(!m_sectionStack.empty())
+    {
+        closeSection(now);
+    }
+
+    m_sectionStack.push_back(section);
+    m_sectionBegin = now;
+}
+
+void FrameProfiler::endSection(Section section)
+{
+    //endFrame may have closed it already.
+    if(m_sectionStack.empty())
+    {
+        return;
+    }
+
+    assert(m_sectionStack.back() == section);
+
+    tick_t now = Clock::Tick();
+    closeSection(now);
+
+    m_sectionStack.pop_back();
+
+    //The outer section, if any, runs again.
+    m_sectionBegin = now;
+}
+
+void FrameProfiler::closeSection(tick_t now)
+{
+    m_current.m_sectionMs[m_sectionStack.back()] += Clock::TicksToMillisecondsD(now - m_sectionBegin);
+}
+
+void FrameProfiler::addCount(Counter counter, uint64_t value)
+{
+    m_current.m_counters[counter] += value;
+}
+
+void FrameProfiler::readGpuTimers()
+{
+    for(std::size_t slot = 0; slot < GPU_QUERY_COUNT; slot++)
+    {
+        std::size_t frame = m_gpuQueryFrame[slot];
+        if(frame == NO_FRAME)
+        {
+            continue;
+        }
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_gpuQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available)
+        {
+            continue;
+        }
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_gpuQueries[slot], GL_QUERY_RESULT, &nanoseconds);
+        m_gpuQueryFrame[slot] = NO_FRAME;
+
+        //Still in the history?
+        if(m_framesDone - frame <= m_frames.size())
+        {
+            m_frames[frame % m_frames.size()].m_gpuMs = double(nanoseconds) / 1000000.0;
+        }
+    }
+}
+
+std::size_t FrameProfiler::getFrameCount() const
+{
+    return m_framesDone < m_frames.size() ? m_framesDone : m_frames.size();
+}
+
+const FrameProfiler::Frame& FrameProfiler::getFrame(std::size_t age) const
+{
+    assert(age < getFrameCount());
+
+    return m_frames[(m_framesDone - 1 - age) % m_frames.size()];
+}
+
+const char* FrameProfiler::getSectionName(Section section)
+{
+    return SECTION_NAMES[section];
+}
+
+const char* FrameProfiler::getCounterName(Counter counter)
+{
+    return COUNTER_NAMES[counter];
+}
+
+void FrameProfiler::writeFrames(std::ostream& out) const
+{
+    out << "frame,start_ms,cpu_ms,gpu_ms";
+    for(std::size_t section = 0; section < SECTION_COUNT; section++)
+    {
+        out << ',' << SECTION_NAMES[section] << "_ms";
+    }
+    for(std::size_t counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        out << ',' << COUNTER_NAMES[counter];
+    }
+    out << '\n';
+
+    out << std::fixed << std::setprecision(3);
+
+    for(std::size_t age = getFrameCount(); age-- > 0;)
+    {
+        const Frame& frame = getFrame(age);
+
+        out << frame.m_index << ',' << frame.m_startMs << ',' << frame.m_cpuMs << ',' << frame.m_gpuMs;
+        for(std::size_t section = 0; section < SECTION_COUNT; section++)
+        {
+            out << ',' << frame.m_sectionMs[section];
+        }
+        for(std::size_t counter = 0; counter < COUNTER_COUNT; counter++)
+        {
+            out << ',' << frame.m_counters[counter];
+        }
+        out << '\n';
+    }
+}
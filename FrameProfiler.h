@@ -0,0 +1,128 @@
+#ifndef _FRAMEPROFILER_H
+#define _FRAMEPROFILER_H
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+
+#include "mgl/MathGeoLib.h"
+
+
+///Where the main thread spends a frame, kept for the last frames so a stutter can be lined up with
+/// what happened in it.
+///
+///Sections are exclusive: a section begun inside another pauses the outer one, so meshing does not
+/// include the upload done at its end. The GPU time of a frame comes from a timer query, read a few
+/// frames later without waiting on it; it stays -1 where timer queries are not supported or the
+/// result was not ready in time.
+///Main thread only.
+class FrameProfiler : boost::noncopyable
+{
+public:
+    enum Section
+    {
+        SECTION_LOD_UPDATE,
+        SECTION_INPUT,
+        SECTION_MESHING,
+        SECTION_UPLOAD,
+        SECTION_DRAW,
+        SECTION_SWAP,
+        SECTION_OCCLUSION,
+        SECTION_COUNT
+    };
+
+    enum Counter
+    {
+        COUNTER_VISIBLE_CHUNKS,
+        COUNTER_DRAW_CALLS,
+        COUNTER_TRIANGLES,
+        COUNTER_BYTES_UPLOADED,
+        COUNTER_OCCLUDED_CHUNKS,
+        COUNTER_COUNT
+    };
+
+    struct Frame
+    {
+        std::size_t m_index;
+        ///Milliseconds since the profiler was created.
+        double m_startMs;
+        double m_cpuMs;
+        double m_gpuMs;
+        double m_sectionMs[SECTION_COUNT];
+        uint64_t m_counters[COUNTER_COUNT];
+    };
+
+    ///Times a section for as long as it lives. pProfiler may be NULL, then it does nothing.
+    class Scope : boost::noncopyable
+    {
+    public:
+        Scope(FrameProfiler* pProfiler, Section section);
+        ~Scope();
+
+    private:
+        FrameProfiler* m_pProfiler;
+        Section m_section;
+    };
+
+    ///frameHistory: frames kept, older ones are overwritten.
+    FrameProfiler(std::size_t frameHistory = 600);
+    ~FrameProfiler();
+
+    ///Needs a current GL context. Without GL_ARB_timer_query only CPU times are kept.
+    void initGpuTimer();
+
+    ///Deletes the timer queries, while the GL context is still there.
+    void releaseGpuTimer();
+
+    bool isGpuTimerEnabled() const;
+
+    void beginFrame();
+    void endFrame();
+
+    void beginSection(Section section);
+    void endSection(Section section);
+
+    void addCount(Counter counter, uint64_t value);
+
+    ///Frames kept so far, at most frameHistory.
+    std::size_t getFrameCount() const;
+
+    ///age 0 is the last finished frame.
+    const Frame& getFrame(std::size_t age) const;
+
+    static const char* getSectionName(Section section);
+    static const char* getCounterName(Counter counter);
+
+    ///The kept frames, oldest first, as CSV with a header line.
+    void writeFrames(std::ostream& out) const;
+
+private:
+    ///Timer queries in flight, a result is given up on if it is not ready after this many frames.
+    static const std::size_t GPU_QUERY_COUNT = 4;
+    static const std::size_t NO_FRAME = ~std::size_t(0);
+
+    void closeSection(tick_t now);
+    void readGpuTimers();
+
+    std::vector<Frame> m_frames;
+    std::size_t m_framesDone;
+
+    Frame m_current;
+    tick_t m_frameBegin;
+    bool m_inFrame;
+
+    ///Open sections, innermost last. Only the innermost one is running.
+    std::vector<Section> m_sectionStack;
+    tick_t m_sectionBegin;
+
+    tick_t m_startTick;
+
+    bool m_gpuTimer;
+    unsigned int m_gpuQueries[GPU_QUERY_COUNT];
+    ///Frame index each query measures, or NO_FRAME if it is not in flight.
+    std::size_t m_gpuQueryFrame[GPU_QUERY_COUNT];
+};
+
+
+#endif
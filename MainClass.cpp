@@ -6,13 +6,18 @@
 
 #include <boost/make_shared.hpp>
 
+#include <fstream>
+
 #include "ChunkManager.h"
 #include "Chunk.h"
 
+#include "noisepp/utils/NoiseSystem.h"
+
 
 MainClass::MainClass() :
     m_exiting(false),
-    m_windowTitle("GfxApi")
+    m_windowTitle("GfxApi"),
+    m_dumpKeyDown(false)
 {
 
 }
@@ -91,6 +96,8 @@ bool MainClass::init()
     initGLFW(1280, 768);
     initGLEW();
 
+    m_frameProfiler.initGpuTimer();
+
     m_pInput = boost::make_shared<GfxApi::Input>(m_pWindow);
 
     initCamera();
@@ -143,7 +150,14 @@ void MainClass::mainLoop()
 
    // glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
 
+    //Chunk generation and noise pipelines share one pool, one core is left to this thread.
+    int workerCount = noisepp::utils::System::getNumberOfCPUs() - 1;
+    noisepp::ThreadPoolConfig poolConfig(workerCount > 1 ? workerCount : 1);
+    poolConfig.name = "chunk worker";
+    noisepp::utils::System::setThreadPoolConfig(poolConfig);
+
     m_pChunkMgr = boost::make_shared<ChunkManager>();
+    m_pChunkMgr->m_pFrameProfiler = &m_frameProfiler;
     
     GfxApi::VertexDeclaration decl1;
     decl1.add(GfxApi::VertexElement(GfxApi::VertexDataSemantic::VCOORD, GfxApi::VertexDataType::FLOAT, 3, "vertex_position"));
@@ -250,6 +264,8 @@ void MainClass::mainLoop()
         
     }
 
+    m_frameProfiler.releaseGpuTimer();
+
     exitApplication();
 }
 
@@ -284,13 +300,34 @@ void MainClass::handleInput(float deltaTime)
     }
 }
     
+void MainClass::dumpProfile()
+{
+    std::ofstream frames("frames.csv");
+    m_frameProfiler.writeFrames(frames);
+
+    const ChunkTracer& tracer = m_pChunkMgr->getTracer();
+
+    std::ofstream latencies("chunk_latency.txt");
+    tracer.writeSummary(latencies);
+
+    std::ofstream trace("chunk_trace.json");
+    tracer.writeChromeTrace(trace);
+
+    std::ofstream occlusion("occlusion.pgm", std::ios::binary);
+    m_pChunkMgr->getOcclusion().writeImage(occlusion);
+}
+
 void MainClass::onTick()
 {
+    m_frameProfiler.beginFrame();
 
     double deltaTime = Clock::MillisecondsSinceD(m_lastTick);
     m_lastTick = Clock::Tick();
 
-    m_pChunkMgr->updateLoDTree(m_camera);
+    {
+        FrameProfiler::Scope lodScope(&m_frameProfiler, FrameProfiler::SECTION_LOD_UPDATE);
+        m_pChunkMgr->updateLoDTree(m_camera);
+    }
 
     if (glfwWindowShouldClose(m_pWindow))
     {
@@ -299,14 +336,25 @@ void MainClass::onTick()
 
     if (glfwGetWindowAttrib(m_pWindow, GLFW_FOCUSED))
     {
+        FrameProfiler::Scope inputScope(&m_frameProfiler, FrameProfiler::SECTION_INPUT);
+
         // handle all input
         handleInput(deltaTime);
 
         // perform camera updates
         updateCamera(deltaTime);
+
+        // dump the frame history once per press
+        bool dumpKeyDown = m_pInput->keyPressed(GLFW_KEY_F12);
+        if (dumpKeyDown && !m_dumpKeyDown)
+        {
+            dumpProfile();
+        }
+        m_dumpKeyDown = dumpKeyDown;
     }
 
-    
+    m_frameProfiler.beginSection(FrameProfiler::SECTION_DRAW);
+
     // Make the window's context current 
     glfwMakeContextCurrent(m_pWindow);
     m_graphics.clear(true, true, true, 0, 0.5, 0.9);
@@ -330,11 +378,25 @@ void MainClass::onTick()
             
         node->m_pMesh->draw();
 
+        m_frameProfiler.addCount(FrameProfiler::COUNTER_DRAW_CALLS, 1);
+        m_frameProfiler.addCount(FrameProfiler::COUNTER_TRIANGLES, node->m_pMesh->m_ib->getNumIndices() / 3);
     }
 
     //m_pChunkMgr->renderBounds(m_camera);
 
-    for(auto& chunk : m_pChunkMgr->m_visibles)
+    m_frameProfiler.addCount(FrameProfiler::COUNTER_VISIBLE_CHUNKS, m_pChunkMgr->m_visibles.size());
+
+    // the visible set culled to the camera, see ChunkCuller
+    m_pChunkMgr->cullVisibles(m_camera, m_drawList);
+
+    // and to the terrain in front, see OcclusionBuffer
+    {
+        FrameProfiler::Scope occlusionScope(&m_frameProfiler, FrameProfiler::SECTION_OCCLUSION);
+        m_pChunkMgr->cullOccluded(m_camera, m_drawList);
+    }
+
+    // meshing of chunks without a mesh is timed apart from drawing, see Chunk::generateMesh
+    for(auto chunk : m_drawList)
     {
         if(!chunk->m_pMesh)
         {
@@ -343,43 +405,48 @@ void MainClass::onTick()
 
         if(chunk->m_pMesh)
         {
-            if(m_camera.Intersects(chunk->m_bounds))
-            {
-                double scale = (1.0f/ChunkManager::CHUNK_SIZE) * (chunk->m_bounds.MaxX() - chunk->m_bounds.MinX());
-               
-                auto node = boost::make_shared<GfxApi::RenderNode>(chunk->m_pMesh, float3(chunk->m_bounds.MinX() , 
-                                                                                          chunk->m_bounds.MinY() ,
-                                                                                          chunk->m_bounds.MinZ() ),
-                                                                                          float3(scale, scale, scale), 
-                                                                                          float3(0, 0, 0));
-                node->m_pMesh->applyVAO();
-                //node->m_pMesh->m_sp->use();
-
-                int worldLocation = node->m_pMesh->m_sp->getUniformLocation("world");
-                assert(worldLocation != -1);
-                int worldViewProjLocation = node->m_pMesh->m_sp->getUniformLocation("worldViewProj");
-                assert(worldViewProjLocation != -1);
-            
-                float4x4 world = node->m_xForm;
-                node->m_pMesh->m_sp->setFloat4x4(worldLocation, world);
-                node->m_pMesh->m_sp->setFloat4x4(worldViewProjLocation, m_camera.ViewProjMatrix() );
-            
-                node->m_pMesh->draw();
-            }
+            double scale = (1.0f/ChunkManager::CHUNK_SIZE) * (chunk->m_bounds.MaxX() - chunk->m_bounds.MinX());
+           
+            auto node = boost::make_shared<GfxApi::RenderNode>(chunk->m_pMesh, float3(chunk->m_bounds.MinX() , 
+                                                                                      chunk->m_bounds.MinY() ,
+                                                                                      chunk->m_bounds.MinZ() ),
+                                                                                      float3(scale, scale, scale), 
+                                                                                      float3(0, 0, 0));
+            node->m_pMesh->applyVAO();
+            //node->m_pMesh->m_sp->use();
+
+            int worldLocation = node->m_pMesh->m_sp->getUniformLocation("world");
+            assert(worldLocation != -1);
+            int worldViewProjLocation = node->m_pMesh->m_sp->getUniformLocation("worldViewProj");
+            assert(worldViewProjLocation != -1);
+        
+            float4x4 world = node->m_xForm;
+            node->m_pMesh->m_sp->setFloat4x4(worldLocation, world);
+            node->m_pMesh->m_sp->setFloat4x4(worldViewProjLocation, m_camera.ViewProjMatrix() );
+        
+            node->m_pMesh->draw();
 
+            m_frameProfiler.addCount(FrameProfiler::COUNTER_DRAW_CALLS, 1);
+            m_frameProfiler.addCount(FrameProfiler::COUNTER_TRIANGLES, node->m_pMesh->m_ib->getNumIndices() / 3);
 
+            m_pChunkMgr->markDrawn(*chunk);
         }
     }
 
-    
+    m_frameProfiler.endSection(FrameProfiler::SECTION_DRAW);
 
     // Swap front and back buffers 
-    glfwSwapBuffers(m_pWindow);
+    {
+        FrameProfiler::Scope swapScope(&m_frameProfiler, FrameProfiler::SECTION_SWAP);
+        glfwSwapBuffers(m_pWindow);
+    }
 
     
     // poll the input system
-    m_pInput->poll();
- 
+    {
+        FrameProfiler::Scope inputScope(&m_frameProfiler, FrameProfiler::SECTION_INPUT);
+        m_pInput->poll();
+    }
 
-    
+    m_frameProfiler.endFrame();
 }
@@ -2,6 +2,7 @@
 #define _MAINCLASS_H
 
 #include "GfxApi.h"
+#include "FrameProfiler.h"
 
 #include <string>
 #include "mgl/MathGeoLib.h"
@@ -18,6 +19,7 @@ void cleanupText2D();
 struct GLFWwindow;
 
 class ChunkManager;
+class Chunk;
 
 namespace GfxApi
 {
@@ -48,6 +50,9 @@ public:
 
     void handleInput(float deltaTime);
 
+    ///Writes the frame history and the chunk generation latencies to files in the working directory.
+    void dumpProfile();
+
 private:
 
     GLFWwindow* m_pWindow;
@@ -69,6 +74,14 @@ private:
     std::vector<boost::shared_ptr<GfxApi::RenderNode>> m_meshList;
 
     boost::shared_ptr<ChunkManager> m_pChunkMgr;
+
+    ///Chunks drawn this frame, the visible set culled to the camera.
+    std::vector<Chunk*> m_drawList;
+
+    FrameProfiler m_frameProfiler;
+
+    ///Dump key state of the last frame, dumpProfile runs once per key press.
+    bool m_dumpKeyDown;
 };
 
 #endif
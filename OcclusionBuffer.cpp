@@ -0,0 +1,468 @@
+#include "OcclusionBuffer.h"
+
+#include <xmmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+#include <atomic>
+#include <memory>
+
+
+//Ahead of chunk generation, whose priorities are LoD levels: the main thread waits for these.
+static const int RASTER_TASK_PRIORITY = 1000;
+
+//Corners of a box, bit 0 for max x, bit 1 for max y, bit 2 for max z, and its faces, counter
+// clockwise seen from outside.
+static const int BOX_FACES[6][4] =
+{
+    { 0, 4, 6, 2 },
+    { 1, 3, 7, 5 },
+    { 0, 1, 5, 4 },
+    { 2, 6, 7, 3 },
+    { 0, 2, 3, 1 },
+    { 4, 5, 7, 6 }
+};
+
+static float3 getBoxCorner(const AABB& box, int corner)
+{
+    return float3((corner & 1) ? box.maxPoint.x : box.minPoint.x,
+                  (corner & 2) ? box.maxPoint.y : box.minPoint.y,
+                  (corner & 4) ? box.maxPoint.z : box.minPoint.z);
+}
+
+
+//Bands not claimed yet, shared by the calling thread and the helper tasks. Helpers that start
+// after the last band was claimed find nothing to do and never touch the buffer.
+struct RasterJob
+{
+    std::atomic<int> m_next;
+    int m_bands;
+};
+
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : m_width(width)
+    , m_height(height)
+    , m_depth(width * height, FLT_MAX)
+{
+    assert(width > 0 && width % 4 == 0);
+    assert(height > 0 && height % BAND_ROWS == 0);
+
+    m_stats = Stats();
+
+    for(int row = 0; row < 4; row++)
+    {
+        for(int column = 0; column < 4; column++)
+        {
+            m_viewProj[row][column] = row == column ? 1.0f : 0.0f;
+        }
+    }
+}
+
+void OcclusionBuffer::begin(const Frustum& camera)
+{
+    float4x4 viewProj = camera.ViewProjMatrix();
+
+    for(int row = 0; row < 4; row++)
+    {
+        for(int column = 0; column < 4; column++)
+        {
+            m_viewProj[row][column] = viewProj.v[row][column];
+        }
+    }
+
+    m_depth.assign(m_width * m_height, FLT_MAX);
+    m_occluders.clear();
+    m_stats = Stats();
+}
+
+bool OcclusionBuffer::project(const float3& point, Vertex& vertex) const
+{
+    float clip[4];
+    for(int row = 0; row < 4; row++)
+    {
+        clip[row] = m_viewProj[row][0] * point.x + m_viewProj[row][1] * point.y + m_viewProj[row][2] * point.z + m_viewProj[row][3];
+    }
+
+    //Behind the near plane, z is -w there with a GL projection.
+    if(clip[3] <= 0 || clip[2] < -clip[3])
+    {
+        return false;
+    }
+
+    vertex.m_x = (clip[0] / clip[3] * 0.5f + 0.5f) * m_width;
+    vertex.m_y = (clip[1] / clip[3] * 0.5f + 0.5f) * m_height;
+    vertex.m_z = clip[2] / clip[3];
+
+    return true;
+}
+
+float OcclusionBuffer::cross(const Vertex& a, const Vertex& b, const Vertex& c)
+{
+    return (b.m_x - a.m_x) * (c.m_y - a.m_y) - (c.m_x - a.m_x) * (b.m_y - a.m_y);
+}
+
+void OcclusionBuffer::addOccluder(const AABB& box)
+{
+    Vertex corners[8];
+    for(int corner = 0; corner < 8; corner++)
+    {
+        if(!project(getBoxCorner(box, corner), corners[corner]))
+        {
+            m_stats.m_skippedOccluders++;
+            return;
+        }
+    }
+
+    m_stats.m_occluders++;
+
+    Occluder occluder;
+
+    //The silhouette, the convex hull of the corners: lower and upper chain of the corners sorted
+    // by x, counter clockwise.
+    const Vertex* sorted[8];
+    for(int corner = 0; corner < 8; corner++)
+    {
+        sorted[corner] = &corners[corner];
+    }
+    std::sort(sorted, sorted + 8, [](const Vertex* a, const Vertex* b)
+    {
+        return a->m_x < b->m_x || (a->m_x == b->m_x && a->m_y < b->m_y);
+    });
+
+    const Vertex* hull[16];
+    int hullSize = 0;
+    for(int pass = 0; pass < 2; pass++)
+    {
+        int chainStart = hullSize;
+        for(int i = 0; i < 8; i++)
+        {
+            const Vertex* vertex = sorted[pass ? 7 - i : i];
+            while(hullSize >= chainStart + 2 && cross(*hull[hullSize - 2], *hull[hullSize - 1], *vertex) <= 0)
+            {
+                hullSize--;
+            }
+            hull[hullSize++] = vertex;
+        }
+        //The last vertex of a chain starts the other one.
+        hullSize--;
+    }
+
+    //Degenerate, or nearly collinear corners kept by rounding.
+    if(hullSize < 3 || hullSize > MAX_EDGES)
+    {
+        return;
+    }
+
+    //Edge functions a * x + b * y + c, positive on the inside, moved in by half a pixel so that
+    // at a pixel center they are positive only if the whole pixel is inside.
+    occluder.m_edgeCount = hullSize;
+    for(int edge = 0; edge < hullSize; edge++)
+    {
+        const Vertex& a = *hull[edge];
+        const Vertex& b = *hull[(edge + 1) % hullSize];
+
+        float ea = -(b.m_y - a.m_y);
+        float eb = b.m_x - a.m_x;
+        occluder.m_edges[edge][0] = ea;
+        occluder.m_edges[edge][1] = eb;
+        occluder.m_edges[edge][2] = -(ea * a.m_x + eb * a.m_y) - 0.5f * (std::fabs(ea) + std::fabs(eb));
+    }
+
+    //A ray enters the box through the last front face plane it crosses, and the NDC depth of a
+    // plane is linear on screen, so the depth of the box is the largest of the front face planes.
+    // Each is moved out by half a pixel to the farthest corner of a pixel.
+    occluder.m_planeCount = 0;
+    for(int face = 0; face < 6; face++)
+    {
+        const Vertex& v0 = corners[BOX_FACES[face][0]];
+        const Vertex& v1 = corners[BOX_FACES[face][1]];
+        const Vertex& v2 = corners[BOX_FACES[face][2]];
+
+        float area = cross(v0, v1, v2);
+
+        //Back facing or edge on, the other faces cover its pixels.
+        if(area < 1e-6f)
+        {
+            continue;
+        }
+
+        float dzdx = ((v1.m_z - v0.m_z) * (v2.m_y - v0.m_y) - (v2.m_z - v0.m_z) * (v1.m_y - v0.m_y)) / area;
+        float dzdy = ((v2.m_z - v0.m_z) * (v1.m_x - v0.m_x) - (v1.m_z - v0.m_z) * (v2.m_x - v0.m_x)) / area;
+
+        float* plane = occluder.m_planes[occluder.m_planeCount++];
+        plane[0] = dzdx;
+        plane[1] = dzdy;
+        plane[2] = v0.m_z - dzdx * v0.m_x - dzdy * v0.m_y + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+    }
+
+    if(!occluder.m_planeCount)
+    {
+        return;
+    }
+
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    for(int corner = 0; corner < 8; corner++)
+    {
+        minX = corners[corner].m_x < minX ? corners[corner].m_x : minX;
+        maxX = corners[corner].m_x > maxX ? corners[corner].m_x : maxX;
+        minY = corners[corner].m_y < minY ? corners[corner].m_y : minY;
+        maxY = corners[corner].m_y > maxY ? corners[corner].m_y : maxY;
+    }
+
+    //Pixels lying entirely within the bounds of the silhouette, clipped to the screen.
+    occluder.m_minX = int(std::ceil(minX));
+    occluder.m_maxX = int(std::floor(maxX)) - 1;
+    occluder.m_minY = int(std::ceil(minY));
+    occluder.m_maxY = int(std::floor(maxY)) - 1;
+
+    occluder.m_minX = occluder.m_minX < 0 ? 0 : occluder.m_minX;
+    occluder.m_minY = occluder.m_minY < 0 ? 0 : occluder.m_minY;
+    occluder.m_maxX = occluder.m_maxX > m_width - 1 ? m_width - 1 : occluder.m_maxX;
+    occluder.m_maxY = occluder.m_maxY > m_height - 1 ? m_height - 1 : occluder.m_maxY;
+
+    if(occluder.m_minX <= occluder.m_maxX && occluder.m_minY <= occluder.m_maxY)
+    {
+        m_occluders.push_back(occluder);
+    }
+}
+
+void OcclusionBuffer::rasterize(noisepp::ThreadPool* pPool)
+{
+    if(m_occluders.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<RasterJob> job = std::make_shared<RasterJob>();
+    job->m_next = 0;
+    job->m_bands = m_height / BAND_ROWS;
+
+    auto runBands = [this, job]()
+    {
+        for(;;)
+        {
+            int band = job->m_next++;
+            if(band >= job->m_bands)
+            {
+                return;
+            }
+
+            rasterizeBand(band);
+        }
+    };
+
+    std::vector<noisepp::TaskHandle> helpers;
+    if(pPool)
+    {
+        std::size_t helperCount = pPool->getThreadCount();
+        if(helperCount > std::size_t(job->m_bands - 1))
+        {
+            helperCount = std::size_t(job->m_bands - 1);
+        }
+
+        helpers.reserve(helperCount);
+        for(std::size_t i = 0; i < helperCount; i++)
+        {
+            helpers.push_back(pPool->submit(runBands, RASTER_TASK_PRIORITY));
+        }
+    }
+
+    runBands();
+
+    //Every band is claimed now, helpers still queued would find nothing. The running ones finish
+    // their last band, waiting only runs tasks of raster priority, never chunk generation.
+    for(auto& helper : helpers)
+    {
+        if(!helper.cancel())
+        {
+            helper.wait();
+        }
+    }
+}
+
+void OcclusionBuffer::rasterizeBand(int band)
+{
+    int minY = band * BAND_ROWS;
+    int maxY = minY + BAND_ROWS - 1;
+
+    for(auto& occluder : m_occluders)
+    {
+        if(occluder.m_maxY >= minY && occluder.m_minY <= maxY)
+        {
+            rasterizeOccluder(occluder, occluder.m_minY > minY ? occluder.m_minY : minY, occluder.m_maxY < maxY ? occluder.m_maxY : maxY);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterizeOccluder(const Occluder& occluder, int minY, int maxY)
+{
+    //Whole groups of 4, pixels outside the silhouette fail the edge tests.
+    int startX = occluder.m_minX & ~3;
+    int endX = occluder.m_maxX;
+
+    __m128 edgeA[MAX_EDGES];
+    for(int edge = 0; edge < occluder.m_edgeCount; edge++)
+    {
+        edgeA[edge] = _mm_set1_ps(occluder.m_edges[edge][0]);
+    }
+
+    __m128 depthA[MAX_PLANES];
+    for(int plane = 0; plane < occluder.m_planeCount; plane++)
+    {
+        depthA[plane] = _mm_set1_ps(occluder.m_planes[plane][0]);
+    }
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 centerOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        float py = y + 0.5f;
+
+        __m128 edgeRow[MAX_EDGES];
+        for(int edge = 0; edge < occluder.m_edgeCount; edge++)
+        {
+            edgeRow[edge] = _mm_set1_ps(occluder.m_edges[edge][1] * py + occluder.m_edges[edge][2]);
+        }
+
+        __m128 depthRow[MAX_PLANES];
+        for(int plane = 0; plane < occluder.m_planeCount; plane++)
+        {
+            depthRow[plane] = _mm_set1_ps(occluder.m_planes[plane][1] * py + occluder.m_planes[plane][2]);
+        }
+
+        float* row = &m_depth[y * m_width];
+
+        for(int x = startX; x <= endX; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), centerOffsets);
+
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), zero);
+            for(int edge = 1; edge < occluder.m_edgeCount; edge++)
+            {
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[edge], px), edgeRow[edge]), zero));
+            }
+
+            if(!_mm_movemask_ps(inside))
+            {
+                continue;
+            }
+
+            __m128 depth = _mm_add_ps(_mm_mul_ps(depthA[0], px), depthRow[0]);
+            for(int plane = 1; plane < occluder.m_planeCount; plane++)
+            {
+                depth = _mm_max_ps(depth, _mm_add_ps(_mm_mul_ps(depthA[plane], px), depthRow[plane]));
+            }
+
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(old, depth);
+
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+}
+
+bool OcclusionBuffer::isOccluded(const AABB& box)
+{
+    m_stats.m_tests++;
+
+    float minX = FLT_MAX;
+    float maxX = -FLT_MAX;
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    float minZ = FLT_MAX;
+
+    for(int corner = 0; corner < 8; corner++)
+    {
+        Vertex vertex;
+        if(!project(getBoxCorner(box, corner), vertex))
+        {
+            return false;
+        }
+
+        minX = vertex.m_x < minX ? vertex.m_x : minX;
+        maxX = vertex.m_x > maxX ? vertex.m_x : maxX;
+        minY = vertex.m_y < minY ? vertex.m_y : minY;
+        maxY = vertex.m_y > maxY ? vertex.m_y : maxY;
+        minZ = vertex.m_z < minZ ? vertex.m_z : minZ;
+    }
+
+    //Every pixel the rectangle touches, clipped to the screen.
+    int startX = int(std::floor(minX));
+    int endX = int(std::ceil(maxX)) - 1;
+    int startY = int(std::floor(minY));
+    int endY = int(std::ceil(maxY)) - 1;
+
+    startX = startX < 0 ? 0 : startX;
+    startY = startY < 0 ? 0 : startY;
+    endX = endX > m_width - 1 ? m_width - 1 : endX;
+    endY = endY > m_height - 1 ? m_height - 1 : endY;
+
+    //Off screen, that's for the frustum test to decide.
+    if(startX > endX || startY > endY)
+    {
+        return false;
+    }
+
+    for(int y = startY; y <= endY; y++)
+    {
+        const float* row = &m_depth[y * m_width];
+
+        for(int x = startX; x <= endX; x++)
+        {
+            if(row[x] >= minZ)
+            {
+                return false;
+            }
+        }
+    }
+
+    m_stats.m_occluded++;
+    return true;
+}
+
+int OcclusionBuffer::getWidth() const
+{
+    return m_width;
+}
+
+int OcclusionBuffer::getHeight() const
+{
+    return m_height;
+}
+
+float OcclusionBuffer::getDepth(int x, int y) const
+{
+    return m_depth[y * m_width + x];
+}
+
+const OcclusionBuffer::Stats& OcclusionBuffer::getStats() const
+{
+    return m_stats;
+}
+
+void OcclusionBuffer::writeImage(std::ostream& out) const
+{
+    out << "P5\n" << m_width << ' ' << m_height << "\n255\n";
+
+    for(int y = m_height - 1; y >= 0; y--)
+    {
+        for(int x = 0; x < m_width; x++)
+        {
+            float depth = getDepth(x, y);
+
+            unsigned char value = 0;
+            if(depth != FLT_MAX)
+            {
+                float brightness = (1.0f - (depth * 0.5f + 0.5f)) * 255.0f;
+                value = (unsigned char)(brightness < 1.0f ? 1.0f : (brightness > 255.0f ? 255.0f : brightness));
+            }
+            out.put(char(value));
+        }
+    }
+}
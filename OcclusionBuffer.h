@@ -0,0 +1,117 @@
+#ifndef _OCCLUSIONBUFFER_H
+#define _OCCLUSIONBUFFER_H
+
+#include <vector>
+#include <ostream>
+#include <boost/noncopyable.hpp>
+
+#include "noisepp/core/NoiseThreadPool.h"
+
+#include "mgl/MathGeoLib.h"
+
+
+///Coarse depth buffer rasterized on the CPU, to skip chunks hidden behind terrain.
+///
+///Occluders are boxes known to be solid, see Chunk::m_occluder. They are rasterized
+/// conservatively, 4 pixels at a time with SSE: only pixels entirely inside the silhouette of a box
+/// are written, with the farthest depth of its front faces over the pixel, keeping the nearest
+/// occluder. The buffer is cut into bands of rows rasterized in parallel. A box is occluded if every
+/// pixel its screen rectangle touches has an occluder nearer than the nearest corner of the box.
+///Occluders crossing the near plane are skipped and boxes crossing it are never occluded, so
+/// mistakes only ever leave something visible.
+class OcclusionBuffer : boost::noncopyable
+{
+public:
+    struct Stats
+    {
+        std::size_t m_occluders;
+        ///Occluders skipped for crossing the near plane.
+        std::size_t m_skippedOccluders;
+        std::size_t m_tests;
+        std::size_t m_occluded;
+    };
+
+    ///Rows rasterized by one task.
+    static const int BAND_ROWS = 8;
+
+    ///width has to be a multiple of 4, height of BAND_ROWS.
+    OcclusionBuffer(int width = 256, int height = 128);
+
+    ///Clears the depth and the occluders, and takes the view of camera.
+    void begin(const Frustum& camera);
+
+    void addOccluder(const AABB& box);
+
+    ///Rasterizes the occluders added since begin. The bands are shared with the workers of pPool,
+    /// the calling thread takes part and while waiting for them runs no tasks below raster
+    /// priority, like chunk generation. NULL rasterizes on the calling thread only.
+    void rasterize(noisepp::ThreadPool* pPool);
+
+    ///True if box is hidden behind the rasterized occluders, in the view given to begin.
+    bool isOccluded(const AABB& box);
+
+    int getWidth() const;
+    int getHeight() const;
+
+    ///Depth of pixel x, y, from the bottom left. NDC z, FLT_MAX where nothing was rasterized.
+    float getDepth(int x, int y) const;
+
+    ///Counts since the last begin.
+    const Stats& getStats() const;
+
+    ///The depth as a binary greyscale PGM, near bright and empty black, top row first.
+    void writeImage(std::ostream& out) const;
+
+private:
+    struct Vertex
+    {
+        float m_x;
+        float m_y;
+        float m_z;
+    };
+
+    ///Silhouette edges and front faces of a box.
+    static const int MAX_EDGES = 6;
+    static const int MAX_PLANES = 3;
+
+    ///A box ready to rasterize, all in pixels from the bottom left.
+    struct Occluder
+    {
+        ///Edge functions a * x + b * y + c of the silhouette, at least 0 at the center of a pixel
+        /// entirely inside it.
+        float m_edges[MAX_EDGES][3];
+        int m_edgeCount;
+        ///Depth planes of the front faces, the farthest depth over a pixel at its center.
+        float m_planes[MAX_PLANES][3];
+        int m_planeCount;
+        ///Pixels within the bounds of the silhouette.
+        int m_minX;
+        int m_maxX;
+        int m_minY;
+        int m_maxY;
+    };
+
+    ///Twice the signed area of a, b, c, positive if counter clockwise.
+    static float cross(const Vertex& a, const Vertex& b, const Vertex& c);
+
+    ///Screen position and NDC depth of point, false if it is not in front of the near plane.
+    bool project(const float3& point, Vertex& vertex) const;
+
+    void rasterizeBand(int band);
+    void rasterizeOccluder(const Occluder& occluder, int minY, int maxY);
+
+    int m_width;
+    int m_height;
+
+    float m_viewProj[4][4];
+
+    ///Row major, bottom row first.
+    std::vector<float> m_depth;
+
+    std::vector<Occluder> m_occluders;
+
+    Stats m_stats;
+};
+
+
+#endif
@@ -1,34 +1,42 @@
 #ifndef _TOCTREE_H
 #define _TOCTREE_H
 
-#include <boost/scoped_ptr.hpp>
-#include <boost/array.hpp>
+#include <vector>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
 #include "cubelib/cube.hpp"
 
 template<class T>
-class TOctree
+class TOctreeArena;
+
+///Node of an octree stored in a TOctreeArena.
+///
+///The 8 children of a node are one block of 8 consecutive nodes in the arena, and nodes refer to
+/// their parent and children by 32 bit index instead of pointers. Walking the tree touches a few
+/// contiguous blocks instead of separately allocated nodes, and splitting allocates nothing once
+/// the arena has grown. Nodes never move, references stay valid until the node is joined away.
+///
+///Every node has a locational code: a 1 bit followed by the corner indices of the path from the
+/// root, 3 bits per level. It is the Morton code of the node position at its depth, so the arena can
+/// find the node at any depth and position by hash lookup, and face neighbours need no tree walk.
+template<class T>
+class TOctree : boost::noncopyable
 {
 public:
     typedef TOctree<T> ChildType;
-
-    typedef boost::array<boost::scoped_ptr<ChildType>, 8> ChildrenType;
-
-    TOctree(TOctree* root, 
-            TOctree* parent, 
-            T value, 
-            std::size_t level, 
-            const cube::corner_t& corner)
-        : m_pRoot(root)
-        , m_pParent(parent)
-        , m_value(value)
-        , m_level(level)
-        , m_corner(corner)
-
-    {
-
-    }
-
-    ~TOctree()
+    typedef TOctreeArena<T> ArenaType;
+
+    ///Index of no node: the parent of the root, the children of a leaf.
+    static const uint32_t NO_NODE = 0xffffffff;
+
+    TOctree()
+        : m_pArena(nullptr)
+        , m_code(0)
+        , m_index(NO_NODE)
+        , m_parent(NO_NODE)
+        , m_firstChild(NO_NODE)
+        , m_level(0)
+        , m_corner(0)
     {
 
     }
@@ -50,27 +58,27 @@ public:
 
     TOctree* getRoot()
     {
-        return m_pRoot;
+        return &m_pArena->getRoot();
     }
 
     const TOctree* getRoot() const
     {
-        return m_pRoot;
+        return &m_pArena->getRoot();
     }
 
     bool isRoot() const
     {
-        return (m_pParent == nullptr);
+        return (m_parent == NO_NODE);
     }
 
     bool hasChildren() const
     {
-        return (m_children != nullptr);
+        return (m_firstChild != NO_NODE);
     }
 
     bool isChild() const
     {
-        return (m_pParent != nullptr);
+        return (m_parent != NO_NODE);
     }
 
     bool isChildOf(const TOctree& other) const;
@@ -87,17 +95,17 @@ public:
 
     TOctree<T>* getParent()
     {
-        return m_pParent;
+        return isRoot() ? nullptr : &m_pArena->getNode(m_parent);
     }
 
     const TOctree<T>* getParent() const
     {
-        return m_pParent;
+        return isRoot() ? nullptr : &m_pArena->getNode(m_parent);
     }
 
     const cube::corner_t& getCorner() const
     {
-        return m_corner;
+        return cube::corner_t::get(m_corner);
     }
 
     std::size_t getLevel() const
@@ -105,53 +113,543 @@ public:
         return m_level;
     }
 
+    ///Position of the node in its arena, see TOctreeArena::getNode.
+    uint32_t getIndex() const
+    {
+        return m_index;
+    }
+
+    ///Locational code, 1 for the root, see TOctreeArena::encodeCode.
+    uint64_t getCode() const
+    {
+        return m_code;
+    }
+
+    ///Levels below the root.
+    std::size_t getDepth() const
+    {
+        return ArenaType::getCodeDepth(m_code);
+    }
+
+    ///Position in units of the node size, each coordinate in [0, 2^depth). Axes follow
+    /// cube::corner_t::x(), y() and z() of the corners on the path.
+    void getPosition(uint32_t& x, uint32_t& y, uint32_t& z) const
+    {
+        ArenaType::decodeCode(m_code, x, y, z);
+    }
+
+    ///The node of the same depth across the face in direction. Where the tree is coarser there, the
+    /// deepest node that covers that place. nullptr if the face is on the boundary of the root.
+    TOctree* getNeighbour(const cube::direction_t& direction);
+
+    const TOctree* getNeighbour(const cube::direction_t& direction) const
+    {
+        return const_cast<TOctree*>(this)->getNeighbour(direction);
+    }
+
+    ArenaType& getArena()
+    {
+        return *m_pArena;
+    }
+
+    const ArenaType& getArena() const
+    {
+        return *m_pArena;
+    }
+
     ChildType& getChild(const cube::corner_t& corner)
     {
-        return *(*m_children)[corner.index()].get();
+        return m_pArena->getNode(m_firstChild + corner.index());
+    }
+
+    const ChildType& getChild(const cube::corner_t& corner) const
+    {
+        return m_pArena->getNode(m_firstChild + corner.index());
+    }
+
+    ///Creates 8 children with default values, existing ones are joined first.
+    void split();
+
+    ///Drops all descendants and their values.
+    void join();
+
+private:
+    friend class TOctreeArena<T>;
+
+    void init(ArenaType* pArena, uint32_t index, uint32_t parent, uint64_t code, std::size_t level, uint8_t corner);
+
+    T m_value;
+
+    ArenaType* m_pArena;
+
+    uint64_t m_code;
+
+    ///NO_NODE while the node is not in use.
+    uint32_t m_index;
+    uint32_t m_parent;
+    ///First of the 8 consecutive children, NO_NODE for a leaf.
+    uint32_t m_firstChild;
+
+    uint16_t m_level;
+
+    uint8_t m_corner;
+};
+
+
+///Owns the nodes of one TOctree.
+///
+///Nodes are handed out in blocks of 8 from pages of PAGE_BLOCKS blocks. Pages are never moved or
+/// freed before the arena, blocks of joined nodes are reused by later splits.
+///
+///Locational codes are looked up in an open addressing table from the code of every split node to
+/// its block of children, so a split adds one entry, not eight.
+template<class T>
+class TOctreeArena : boost::noncopyable
+{
+public:
+    typedef TOctree<T> NodeType;
+
+    static const uint32_t PAGE_SHIFT = 9;
+    static const uint32_t PAGE_NODES = 1 << PAGE_SHIFT;
+    static const uint32_t PAGE_BLOCKS = PAGE_NODES / 8;
+
+    ///Deepest level below the root a locational code can address.
+    static const std::size_t MAX_DEPTH = 21;
+
+    TOctreeArena()
+        : m_usedBlocks(0)
+        , m_nodeCount(0)
+        , m_blockCount(0)
+    {
+        m_blockCodes.assign(64, 0);
+        m_blockNodes.assign(64, NodeType::NO_NODE);
+    }
+
+    ~TOctreeArena()
+    {
+        for(auto pPage : m_pages)
+        {
+            delete[] pPage;
+        }
+    }
+
+    ///The root takes the first block on its own, so every other block holds 8 siblings.
+    NodeType& createRoot(T value, std::size_t level, const cube::corner_t& corner)
+    {
+        BOOST_ASSERT(m_usedBlocks == 0);
+
+        uint32_t index = allocateBlock();
+
+        NodeType& root = getNode(index);
+        root.init(this, index, NodeType::NO_NODE, 1, level, corner.index());
+        root.m_value = value;
+
+        m_nodeCount++;
+
+        return root;
+    }
+
+    NodeType& getRoot()
+    {
+        return getNode(0);
+    }
+
+    const NodeType& getRoot() const
+    {
+        return getNode(0);
+    }
+
+    NodeType& getNode(uint32_t index)
+    {
+        return m_pages[index >> PAGE_SHIFT][index & (PAGE_NODES - 1)];
+    }
+
+    const NodeType& getNode(uint32_t index) const
+    {
+        return m_pages[index >> PAGE_SHIFT][index & (PAGE_NODES - 1)];
+    }
+
+    ///Nodes in the tree.
+    std::size_t getNodeCount() const
+    {
+        return m_nodeCount;
     }
 
-    ChildrenType& getChildren()
+    ///Nodes the pages have room for.
+    std::size_t getCapacity() const
     {
-        return (*m_children);
+        return m_pages.size() * PAGE_NODES;
     }
 
-    void split()
+    ///The node with the locational code, nullptr if the tree does not reach down there.
+    NodeType* findNode(uint64_t code)
     {
-        TOctree<T>* pRoot = (m_pParent == nullptr) ? this : m_pRoot; 
+        if(code == 1)
+        {
+            return m_usedBlocks ? &getRoot() : nullptr;
+        }
+
+        uint32_t first = findBlock(code >> 3);
+
+        return first == NodeType::NO_NODE ? nullptr : &getNode(first + uint32_t(code & 7));
+    }
 
-        m_children.reset( new ChildrenType() );
+    NodeType* findNode(std::size_t depth, uint32_t x, uint32_t y, uint32_t z)
+    {
+        return findNode(encodeCode(depth, x, y, z));
+    }
 
-        for(auto& corner : cube::corner_t::all())
+    ///The node with the locational code or, if the tree is coarser there, its deepest ancestor.
+    ///Ancestors of a node always exist, so this is a binary search over the depth.
+    NodeType* findDeepestNode(uint64_t code)
+    {
+        if(!m_usedBlocks)
         {
-            (*m_children)[corner.index()].reset(new ChildType(pRoot, this, T(), m_level + 1, corner));
+            return nullptr;
         }
+
+        std::size_t depth = getCodeDepth(code);
+
+        //The root is always there, code itself maybe not.
+        std::size_t found = 0;
+        std::size_t missing = depth + 1;
+
+        while(missing - found > 1)
+        {
+            std::size_t middle = (found + missing) / 2;
+
+            if(findNode(code >> (3 * (depth - middle))))
+            {
+                found = middle;
+            }
+            else
+            {
+                missing = middle;
+            }
+        }
+
+        return findNode(code >> (3 * (depth - found)));
     }
 
-    void join()
+    ///Locational code of the node at depth with position x, y, z, each in [0, 2^depth).
+    static uint64_t encodeCode(std::size_t depth, uint32_t x, uint32_t y, uint32_t z)
     {
-        m_children.reset();
+        BOOST_ASSERT(depth <= MAX_DEPTH);
+
+        return (uint64_t(1) << (3 * depth)) | spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+    }
+
+    static void decodeCode(uint64_t code, uint32_t& x, uint32_t& y, uint32_t& z)
+    {
+        //The marker bit ends up above the coordinates, masked off by compactBits.
+        uint64_t bits = code ^ (uint64_t(1) << (3 * getCodeDepth(code)));
+
+        x = compactBits(bits);
+        y = compactBits(bits >> 1);
+        z = compactBits(bits >> 2);
+    }
+
+    static std::size_t getCodeDepth(uint64_t code)
+    {
+        BOOST_ASSERT(code);
+
+        std::size_t depth = 0;
+        while(code >>= 3)
+        {
+            depth++;
+        }
+        return depth;
     }
 
-    boost::scoped_ptr< ChildrenType > m_children;
+    ///Calls f(node) for every node in the tree in arena order, a linear pass over the pages.
+    ///f must not split or join.
+    template<typename F>
+    void forEachNode(F f)
+    {
+        uint32_t end = m_usedBlocks * 8;
+
+        for(uint32_t index = 0; index < end; index++)
+        {
+            NodeType& node = getNode(index);
+
+            if(node.m_index != NodeType::NO_NODE)
+            {
+                f(node);
+            }
+        }
+    }
 
 private:
-    TOctree<T>* m_pRoot;
-    TOctree<T>* m_pParent;
+    friend class TOctree<T>;
 
-    T m_value;
+    ///First node of a free block of 8.
+    uint32_t allocateBlock()
+    {
+        if(!m_freeBlocks.empty())
+        {
+            uint32_t index = m_freeBlocks.back();
+            m_freeBlocks.pop_back();
+            return index;
+        }
+
+        if(m_usedBlocks % PAGE_BLOCKS == 0)
+        {
+            m_pages.push_back(new NodeType[PAGE_NODES]);
+        }
+
+        return 8 * m_usedBlocks++;
+    }
+
+    void freeBlock(uint32_t index)
+    {
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            NodeType& node = getNode(index + i);
+
+            node.m_value = T();
+            node.m_index = NodeType::NO_NODE;
+        }
+
+        m_freeBlocks.push_back(index);
+    }
+
+    ///Every third bit of the result is a bit of v, the lowest 21 bits of v are kept.
+    static uint64_t spreadBits(uint32_t v)
+    {
+        uint64_t bits = v & 0x1fffff;
+        bits = (bits | bits << 32) & 0x001f00000000ffffULL;
+        bits = (bits | bits << 16) & 0x001f0000ff0000ffULL;
+        bits = (bits | bits << 8) & 0x100f00f00f00f00fULL;
+        bits = (bits | bits << 4) & 0x10c30c30c30c30c3ULL;
+        bits = (bits | bits << 2) & 0x1249249249249249ULL;
+        return bits;
+    }
+
+    static uint32_t compactBits(uint64_t bits)
+    {
+        bits &= 0x1249249249249249ULL;
+        bits = (bits ^ (bits >> 2)) & 0x10c30c30c30c30c3ULL;
+        bits = (bits ^ (bits >> 4)) & 0x100f00f00f00f00fULL;
+        bits = (bits ^ (bits >> 8)) & 0x001f0000ff0000ffULL;
+        bits = (bits ^ (bits >> 16)) & 0x001f00000000ffffULL;
+        bits = (bits ^ (bits >> 32)) & 0x1fffff;
+        return uint32_t(bits);
+    }
+
+    std::size_t getBlockSlot(uint64_t code) const
+    {
+        return std::size_t((code * 0x9e3779b97f4a7c15ULL) >> 32) & (m_blockCodes.size() - 1);
+    }
+
+    ///First child of the node with code, NO_NODE if it has none.
+    uint32_t findBlock(uint64_t code) const
+    {
+        for(std::size_t slot = getBlockSlot(code); m_blockCodes[slot]; slot = (slot + 1) & (m_blockCodes.size() - 1))
+        {
+            if(m_blockCodes[slot] == code)
+            {
+                return m_blockNodes[slot];
+            }
+        }
+        return NodeType::NO_NODE;
+    }
 
-    std::size_t m_level;
+    void insertBlock(uint64_t code, uint32_t first)
+    {
+        //At most half full, probe sequences stay short.
+        if(2 * (m_blockCount + 1) > m_blockCodes.size())
+        {
+            std::vector<uint64_t> codes(2 * m_blockCodes.size(), 0);
+            std::vector<uint32_t> nodes(2 * m_blockCodes.size(), NodeType::NO_NODE);
+            codes.swap(m_blockCodes);
+            nodes.swap(m_blockNodes);
+
+            m_blockCount = 0;
+            for(std::size_t slot = 0; slot < codes.size(); slot++)
+            {
+                if(codes[slot])
+                {
+                    insertBlock(codes[slot], nodes[slot]);
+                }
+            }
+        }
+
+        std::size_t slot = getBlockSlot(code);
+        while(m_blockCodes[slot])
+        {
+            slot = (slot + 1) & (m_blockCodes.size() - 1);
+        }
+
+        m_blockCodes[slot] = code;
+        m_blockNodes[slot] = first;
+        m_blockCount++;
+    }
+
+    void eraseBlock(uint64_t code)
+    {
+        std::size_t mask = m_blockCodes.size() - 1;
+
+        std::size_t hole = getBlockSlot(code);
+        while(m_blockCodes[hole] != code)
+        {
+            BOOST_ASSERT(m_blockCodes[hole]);
+            hole = (hole + 1) & mask;
+        }
+
+        //Move later entries of the probe sequence back into the hole, no tombstones.
+        for(std::size_t slot = (hole + 1) & mask; m_blockCodes[slot]; slot = (slot + 1) & mask)
+        {
+            std::size_t home = getBlockSlot(m_blockCodes[slot]);
+
+            if(((slot - home) & mask) >= ((slot - hole) & mask))
+            {
+                m_blockCodes[hole] = m_blockCodes[slot];
+                m_blockNodes[hole] = m_blockNodes[slot];
+                hole = slot;
+            }
+        }
+
+        m_blockCodes[hole] = 0;
+        m_blockNodes[hole] = NodeType::NO_NODE;
+        m_blockCount--;
+    }
 
-    cube::corner_t m_corner;
+    std::vector<NodeType*> m_pages;
 
+    std::vector<uint32_t> m_freeBlocks;
 
+    ///Blocks taken from the pages so far, free ones included.
+    uint32_t m_usedBlocks;
 
+    std::size_t m_nodeCount;
 
-    
+    ///Code of a split node, 0 for an empty slot, and the first of its children.
+    std::vector<uint64_t> m_blockCodes;
+    std::vector<uint32_t> m_blockNodes;
+    std::size_t m_blockCount;
 };
 
 
+template<class T>
+const uint32_t TOctree<T>::NO_NODE;
+
+template<class T>
+void TOctree<T>::init(ArenaType* pArena, uint32_t index, uint32_t parent, uint64_t code, std::size_t level, uint8_t corner)
+{
+    m_pArena = pArena;
+    m_index = index;
+    m_parent = parent;
+    m_firstChild = NO_NODE;
+    m_code = code;
+    m_level = static_cast<uint16_t>(level);
+    m_corner = corner;
+}
+
+template<class T>
+bool TOctree<T>::isChildOf(const TOctree& other) const
+{
+    return m_pArena == other.m_pArena && m_parent == other.m_index;
+}
+
+template<class T>
+bool TOctree<T>::isParentOf(const TOctree& other) const
+{
+    return other.isChildOf(*this);
+}
+
+template<class T>
+const TOctree<T>* TOctree<T>::getPreviousBrother() const
+{
+    if(isRoot() || m_corner == 0)
+    {
+        return nullptr;
+    }
+
+    return &m_pArena->getNode(m_index - 1);
+}
+
+template<class T>
+const TOctree<T>* TOctree<T>::getNextBrother() const
+{
+    if(isRoot() || m_corner == 7)
+    {
+        return nullptr;
+    }
+
+    return &m_pArena->getNode(m_index + 1);
+}
+
+template<class T>
+const TOctree<T>* TOctree<T>::getFirstChild() const
+{
+    return hasChildren() ? &m_pArena->getNode(m_firstChild) : nullptr;
+}
+
+template<class T>
+const TOctree<T>* TOctree<T>::getLastChild() const
+{
+    return hasChildren() ? &m_pArena->getNode(m_firstChild + 7) : nullptr;
+}
+
+template<class T>
+TOctree<T>* TOctree<T>::getNeighbour(const cube::direction_t& direction)
+{
+    std::size_t depth = getDepth();
+
+    uint32_t x, y, z;
+    getPosition(x, y, z);
+
+    x += direction.x();
+    y += direction.y();
+    z += direction.z();
+
+    //Below 0 wraps around and fails the test as well.
+    uint32_t size = uint32_t(1) << depth;
+    if(x >= size || y >= size || z >= size)
+    {
+        return nullptr;
+    }
+
+    return m_pArena->findDeepestNode(ArenaType::encodeCode(depth, x, y, z));
+}
+
+template<class T>
+void TOctree<T>::split()
+{
+    join();
+
+    BOOST_ASSERT(getDepth() < ArenaType::MAX_DEPTH);
+
+    uint32_t first = m_pArena->allocateBlock();
+
+    for(uint8_t corner = 0; corner < 8; corner++)
+    {
+        m_pArena->getNode(first + corner).init(m_pArena, first + corner, m_index, (m_code << 3) | corner, m_level + 1, corner);
+    }
+
+    m_pArena->insertBlock(m_code, first);
+    m_pArena->m_nodeCount += 8;
+    m_firstChild = first;
+}
+
+template<class T>
+void TOctree<T>::join()
+{
+    if(!hasChildren())
+    {
+        return;
+    }
+
+    for(uint32_t corner = 0; corner < 8; corner++)
+    {
+        m_pArena->getNode(m_firstChild + corner).join();
+    }
 
+    m_pArena->eraseBlock(m_code);
+    m_pArena->freeBlock(m_firstChild);
+    m_pArena->m_nodeCount -= 8;
+    m_firstChild = NO_NODE;
+}
 
 
-#endif
\ No newline at end of file
+#endif
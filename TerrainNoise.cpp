@@ -0,0 +1,88 @@
+#include "TerrainNoise.h"
+
+#include "noisepp/utils/NoiseUtils.h"
+#include "xmlnoise/xml_noise3d.hpp"
+#include "xmlnoise/xml_noise3d_handlers.hpp"
+#include "xmlnoise/xml_noise_error.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <cassert>
+
+
+//something.npg is something.xml compiled with --compile-noise, mapped in without any parsing.
+// Returns false if there is none, if it can't be read, or if something.xml changed since it was
+// compiled.
+static bool loadCompiledTerrainNoise(xml_noise3d_t& xml_noise3d)
+{
+    if(!std::ifstream("something.npg"))
+    {
+        return false;
+    }
+
+    //Truncated, corrupt or written by another version, the xml is still there.
+    try
+    {
+        xml_noise3d.load_compiled("something.npg");
+    }
+    catch(const xml_noise_error_t& e)
+    {
+        std::cerr << "something.npg can't be loaded (" << e.what() << "), loading something.xml instead. "
+                     "Recompile it with --compile-noise." << std::endl;
+        return false;
+    }
+
+    //Without the xml there is nothing to be out of date with.
+    unsigned long long sourceHash = xml_noise3d_t::hash_source("something.xml");
+    if(sourceHash && sourceHash != xml_noise3d.source_hash)
+    {
+        std::cerr << "something.npg is older than something.xml, loading the xml instead. "
+                     "Recompile it with --compile-noise." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+TerrainNoise::TerrainNoise()
+    : m_pPipeline(noisepp::utils::System::createOptimalPipeline3D())
+{
+    m_pGraph.reset(new xml_noise3d_t(*m_pPipeline));
+
+    if(!loadCompiledTerrainNoise(*m_pGraph))
+    {
+        //A fresh graph, nothing of a stale compiled one was added to the pipeline yet.
+        m_pGraph.reset(new xml_noise3d_t(*m_pPipeline));
+        register_all_3dhandlers(m_pGraph->handlers);
+        m_pGraph->load("something.xml");
+        m_pGraph->optimize();
+    }
+    assert(m_pGraph->root);
+
+    noisepp::ElementID rootid = m_pGraph->root->addToPipeline(m_pPipeline.get());
+    m_pKernel.reset(new noisepp::PipelineKernel3D(noisepp::PipelineSchedule3D(m_pPipeline.get(), rootid)));
+
+    //Around the origin and at the spacing of a root chunk corner.
+    assert(m_pKernel->verify(m_pPipeline.get(), 0, 0, 0, 1, 4) == 0);
+    assert(m_pKernel->verify(m_pPipeline.get(), -1000, -1000, -1000, 2000.0 / 32, 4) == 0);
+}
+
+TerrainNoise::~TerrainNoise()
+{
+    //The graph goes first, before the pipeline its modules were added to.
+    m_pKernel.reset();
+    m_pGraph.reset();
+}
+
+void TerrainNoise::getGridValues(float x, float y, float z, double spacing, std::size_t count,
+                                 float* out, std::size_t strideY, std::size_t strideZ) const
+{
+    noisepp::Real* workspace = m_pKernel->createWorkspace();
+    noisepp::Cache* cache = m_pPipeline->createCache();
+
+    //Terms without x (the y gradients) are evaluated per row, plane or y and broadcast.
+    m_pKernel->getGridValues(x, y, z, spacing, count, count, count, out, strideY, strideZ, workspace, cache);
+
+    m_pKernel->freeWorkspace(workspace);
+    m_pPipeline->freeCache(cache);
+}
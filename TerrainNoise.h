@@ -0,0 +1,39 @@
+#ifndef _TERRAINNOISE_H
+#define _TERRAINNOISE_H
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "noisepp/core/Noise.h"
+
+struct xml_noise3d_t;
+
+
+///The terrain density graph, loaded and compiled into a kernel once per ChunkManager.
+///
+///The graph comes from something.npg if it is there and up to date with something.xml, otherwise
+/// the xml is parsed and optimized. Chunk generation tasks evaluate the shared kernel concurrently,
+/// each call with a workspace and cache of its own. Debug builds check the kernel against the
+/// interpreted pipeline once on construction.
+class TerrainNoise : boost::noncopyable
+{
+public:
+    TerrainNoise();
+    ~TerrainNoise();
+
+    ///Densities of count^3 grid positions from x, y, z, spacing apart, into out with the given
+    /// strides in values between rows and planes. Thread safe.
+    void getGridValues(float x, float y, float z, double spacing, std::size_t count,
+                       float* out, std::size_t strideY, std::size_t strideZ) const;
+
+private:
+    boost::scoped_ptr<noisepp::Pipeline3D> m_pPipeline;
+
+    ///The modules of the graph, they have to outlive the kernel using them.
+    boost::scoped_ptr<xml_noise3d_t> m_pGraph;
+
+    boost::scoped_ptr<noisepp::PipelineKernel3D> m_pKernel;
+};
+
+
+#endif
@@ -1,12 +1,245 @@
 #include <stdio.h>
 #include <iostream>
 
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <algorithm>
+
 #include "MainClass.h"
+#include "Chunk.h"
+#include "ChunkManager.h"
+#include "voxel/TVolume3d.h"
+#include "voxel/TCompressedVolume3d.h"
+
+#include "noisepp/core/Noise.h"
+#include "xmlnoise/xml_noise3d.hpp"
+#include "xmlnoise/xml_noise3d_handlers.hpp"
+#include "xmlnoise/xml_noise_profile.hpp"
+
+//GfxApi --compile-noise something.xml something.npg
+// Loads and optimizes the xml graph once, and writes it in the form Chunk loads at runtime.
+static void compileNoise(const std::string& xmlFile, const std::string& compiledFile)
+{
+    noisepp::Pipeline3D pipeline;
+    xml_noise3d_t xml_noise3d(pipeline);
+    register_all_3dhandlers(xml_noise3d.handlers);
+    xml_noise3d.load(xmlFile);
+    xml_noise3d.optimize();
+    xml_noise3d.save_compiled(compiledFile);
+
+    std::cout << compiledFile << ": " << xml_noise3d.optimize_stats.nodes_after << " modules" << std::endl;
+}
+
+//GfxApi --profile-noise something.xml [something.folded]
+// Evaluates the xml graph as written, unoptimized, over a 64^3 grid with every module measured,
+// prints where the cycles went and optionally writes a flame graph of it.
+static void profileNoise(const std::string& xmlFile, const std::string& flameGraphFile)
+{
+    noisepp::utils::ProfiledPipeline3D pipeline;
+    xml_noise3d_t xml_noise3d(pipeline);
+    register_all_3dhandlers(xml_noise3d.handlers);
+    xml_noise3d.keep_paths = true;
+    xml_noise3d.load(xmlFile);
+
+    noisepp::ElementID rootid = xml_noise3d.root->addToPipeline(&pipeline);
+    noisepp::PipelineKernel3D kernel(noisepp::PipelineSchedule3D(&pipeline, rootid));
+    noisepp::Real *workspace = kernel.createWorkspace();
+    noisepp::Cache *cache = pipeline.createCache();
+
+    const std::size_t gridSize = 64;
+    std::vector<float> values(gridSize * gridSize * gridSize);
+    kernel.getGridValues(-512.0, -512.0, -512.0, 16.0, gridSize, gridSize, gridSize,
+        &values[0], gridSize, gridSize * gridSize, workspace, cache);
+
+    kernel.freeWorkspace(workspace);
+    pipeline.freeCache(cache);
+
+    write_noise_profile(std::cout, xml_noise3d, pipeline);
+
+    if(!flameGraphFile.empty())
+    {
+        std::ofstream flameGraph(flameGraphFile.c_str());
+        write_noise_flame_graph(flameGraph, xml_noise3d, pipeline);
+    }
+}
+
+//GfxApi --profile-volumes something.xml
+// Generates a row of chunks of the xml graph at every other LoD level, compresses their densities
+// the way Chunk does after meshing and prints the bytes per chunk, the largest shift of a surface
+// vertex in cells, the cost of reading single cells in random order, of a full decode and of
+// generating the chunk again instead.
+static void profileVolumes(const std::string& xmlFile)
+{
+    noisepp::Pipeline3D pipeline;
+    xml_noise3d_t xml_noise3d(pipeline);
+    register_all_3dhandlers(xml_noise3d.handlers);
+    xml_noise3d.load(xmlFile);
+    xml_noise3d.optimize();
+
+    noisepp::ElementID rootid = xml_noise3d.root->addToPipeline(&pipeline);
+    noisepp::PipelineKernel3D kernel(noisepp::PipelineSchedule3D(&pipeline, rootid));
+    noisepp::Real *workspace = kernel.createWorkspace();
+    noisepp::Cache *cache = pipeline.createCache();
+
+    const std::size_t gridSize = ChunkManager::CHUNK_SIZE + 2;
+    const int chunkCount = 4;
+    //Size of the root chunk, see ChunkManager::ChunkManager.
+    const float rootSize = 2000.0f;
+
+    TVolume3d<float> volume(gridSize, gridSize, gridSize);
+    TVolume3d<float> decoded(gridSize, gridSize, gridSize);
+
+    //Every cell once, shuffled so that reads miss the way lookups from other chunks do.
+    std::vector<std::size_t> order(gridSize * gridSize * gridSize);
+    for(std::size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+
+    std::vector<Vector3Int> cells(order.size());
+    for(std::size_t i = 0; i < order.size(); i++)
+    {
+        std::size_t x, y, z;
+        volume.fromIndex(x, y, z, order[i]);
+        cells[i] = Vector3Int(int(x), int(y), int(z));
+    }
+
+    double nanosecondsPerTick = 1000000000.0 / double(Clock::TicksPerSec());
+    float sum = 0;
+
+    std::cout << std::setw(10) << "size"
+              << std::setw(12) << "float"
+              << std::setw(12) << "compressed"
+              << std::setw(12) << "max shift"
+              << std::setw(12) << "float ns"
+              << std::setw(14) << "compressed ns"
+              << std::setw(12) << "decode us"
+              << std::setw(12) << "generate us" << std::endl;
+
+    for(int level = 0; level <= ChunkManager::MAX_LOD_LEVEL; level += 2)
+    {
+        float size = rootSize / float(1 << level);
+        double res = size / ChunkManager::CHUNK_SIZE;
+
+        std::size_t floatBytes = 0;
+        std::size_t compressedBytes = 0;
+        float maxShift = 0;
+        tick_t floatTicks = 0;
+        tick_t compressedTicks = 0;
+        tick_t decodeTicks = 0;
+        tick_t generateTicks = 0;
+
+        //Along x through the middle of the root, where the surface is.
+        for(int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            float* values = &volume(0, 0, 0);
+            tick_t begin = Clock::Tick();
+            kernel.getGridValues((chunk - chunkCount / 2) * size, -0.5f * size, -0.5f * size, res,
+                gridSize, gridSize, gridSize, values, &volume(0, 1, 0) - values, &volume(0, 0, 1) - values,
+                workspace, cache);
+            generateTicks += Clock::Tick() - begin;
+
+            TCompressedVolume3d<float> compressed(volume, Chunk::ISO_VALUE, Chunk::DENSITY_RANGE, Chunk::DENSITY_MAX_SHIFT);
+
+            floatBytes += volume.getMemoryUsage();
+            compressedBytes += compressed.getMemoryUsage();
+
+            begin = Clock::Tick();
+            compressed.decode(decoded);
+            decodeTicks += Clock::Tick() - begin;
+
+            //Where marching cubes puts the vertex on every edge crossing the surface, both ways.
+            for(std::size_t y = 0; y < gridSize; y++)
+            for(std::size_t z = 0; z < gridSize; z++)
+            for(std::size_t x = 0; x < gridSize; x++)
+            {
+                std::size_t ends[3][3] = { { x + 1, y, z }, { x, y + 1, z }, { x, y, z + 1 } };
+                for(auto& end : ends)
+                {
+                    if(end[0] == gridSize || end[1] == gridSize || end[2] == gridSize)
+                    {
+                        continue;
+                    }
+
+                    float a = volume(x, y, z);
+                    float b = volume(end[0], end[1], end[2]);
+                    if((a <= Chunk::ISO_VALUE) == (b <= Chunk::ISO_VALUE))
+                    {
+                        continue;
+                    }
+
+                    float restoredA = decoded(x, y, z);
+                    float restoredB = decoded(end[0], end[1], end[2]);
+
+                    float exact = (Chunk::ISO_VALUE - a) / (b - a);
+                    float restored = (Chunk::ISO_VALUE - restoredA) / (restoredB - restoredA);
+                    maxShift = std::max(maxShift, std::fabs(restored - exact));
+                }
+            }
+
+            begin = Clock::Tick();
+            for(auto& cell : cells)
+            {
+                sum += volume(std::get<0>(cell), std::get<1>(cell), std::get<2>(cell));
+            }
+            floatTicks += Clock::Tick() - begin;
+
+            begin = Clock::Tick();
+            for(auto& cell : cells)
+            {
+                sum += compressed(std::get<0>(cell), std::get<1>(cell), std::get<2>(cell));
+            }
+            compressedTicks += Clock::Tick() - begin;
+        }
+
+        double reads = double(cells.size()) * chunkCount;
+
+        std::cout << std::setw(10) << std::fixed << std::setprecision(1) << size
+                  << std::setw(12) << floatBytes / chunkCount
+                  << std::setw(12) << compressedBytes / chunkCount
+                  << std::setw(12) << std::setprecision(4) << maxShift
+                  << std::setw(12) << std::setprecision(2) << floatTicks * nanosecondsPerTick / reads
+                  << std::setw(14) << compressedTicks * nanosecondsPerTick / reads
+                  << std::setw(12) << std::setprecision(1) << decodeTicks * nanosecondsPerTick / 1000.0 / chunkCount
+                  << std::setw(12) << generateTicks * nanosecondsPerTick / 1000.0 / chunkCount << std::endl;
+    }
+
+    kernel.freeWorkspace(workspace);
+    pipeline.freeCache(cache);
+
+    //Keeps the reads from being optimized away.
+    if(sum == 12345.0f)
+    {
+        std::cout << std::endl;
+    }
+}
 
 int main(int argc, char *argv[]) 
 {
     try 
     {
+        if(argc == 4 && std::string(argv[1]) == "--compile-noise")
+        {
+            compileNoise(argv[2], argv[3]);
+            return EXIT_SUCCESS;
+        }
+
+        if((argc == 3 || argc == 4) && std::string(argv[1]) == "--profile-noise")
+        {
+            profileNoise(argv[2], argc == 4 ? argv[3] : "");
+            return EXIT_SUCCESS;
+        }
+
+        if(argc == 3 && std::string(argv[1]) == "--profile-volumes")
+        {
+            profileVolumes(argv[2]);
+            return EXIT_SUCCESS;
+        }
+
         MainClass* mainApp = new MainClass();
         mainApp->mainLoop();
     } 
@@ -31,6 +31,8 @@
 #include "NoiseMath.h"
 #include "NoisePipeline.h"
 #include "NoisePipelineJobs.h"
+#include "NoisePipelineSchedule.h"
+#include "NoisePipelineKernel.h"
 #include "NoiseModule.h"
 #include "NoisePerlin.h"
 #include "NoiseBillow.h"
@@ -49,6 +51,7 @@
 #include "NoiseMultiply.h"
 #include "NoisePower.h"
 #include "NoiseRidgedMulti.h"
+#include "NoiseSimplex.h"
 #include "NoiseScaleBias.h"
 #include "NoiseSelect.h"
 #include "NoiseScalePoint.h"
@@ -59,6 +62,7 @@
 #include "NoiseY.h"
 
 #if NOISEPP_ENABLE_THREADS
+#include "NoiseThreadPool.h"
 #include "NoiseThreadedPipeline.h"
 #endif
 
@@ -86,6 +86,19 @@ namespace noisepp
 				value = getElementValue (mElementPtr, mElement, x, y, z, cache);
 				return std::fabs(value);
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return std::fabs(slots[mElement]);
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_ABSOLUTE;
+				op.sources[0] = mElement;
+			}
 	};
 
 	/** Module that outputs the absolute value of the input value from the source module.
@@ -175,6 +175,13 @@ namespace noisepp
 
 				return value;
 			}
+			virtual void getValues (const Real *x, const Real *y, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = BillowElement2D::getValue (x[i], y[i], cache);
+				}
+			}
 	};
 
 	class BillowElement3D : public PipelineElement3D
@@ -249,6 +256,30 @@ namespace noisepp
 
 				return value;
 			}
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = BillowElement3D::getValue (x[i], y[i], z[i], cache);
+				}
+			}
+			virtual void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real *out, Cache *cache) const
+			{
+				const size_t total = countX * countY * countZ;
+				std::vector<Real> signals(total);
+				GridGenerator3D generator;
+				std::fill (out, out + total, Real(0.5));
+				for (size_t o=0;o<mOctaveCount;++o)
+				{
+					generator.setGrid (x, y, z, spacing, countX, countY, countZ, mOctaves[o].scale, mQuality);
+					generator.calcGradientCoherentNoise (mOctaves[o].seed, mScale, &signals[0]);
+					for (size_t i=0;i<total;++i)
+					{
+						const Real signal = Real(2.0) * std::fabs (signals[i]) - Real(1.0);
+						out[i] += signal * mOctaves[o].persistence;
+					}
+				}
+			}
 	};
 
 	/** Module for generating "billowy" perlin noise.
@@ -110,6 +110,23 @@ namespace noisepp
 
 				return Math::InterpLinear (leftValue, rightValue, (blendValue + Real(1.0)) / Real(2.0));
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mLeft);
+				sources.push_back (mRight);
+				sources.push_back (mControl);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return Math::InterpLinear (slots[mLeft], slots[mRight], (slots[mControl] + Real(1.0)) / Real(2.0));
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_BLEND;
+				op.sources[0] = mLeft;
+				op.sources[1] = mRight;
+				op.sources[2] = mControl;
+			}
 	};
 
 	/** Module for blending.
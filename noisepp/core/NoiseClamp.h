@@ -101,6 +101,26 @@ namespace noisepp
 					value = mUpperBound;
 				return value;
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				Real value = slots[mElement];
+				if (value < mLowerBound)
+					value = mLowerBound;
+				else if (value > mUpperBound)
+					value = mUpperBound;
+				return value;
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_CLAMP;
+				op.sources[0] = mElement;
+				op.params[0] = mLowerBound;
+				op.params[1] = mUpperBound;
+			}
 	};
 
 	/** Module clamping the value of the source module.
@@ -53,6 +53,11 @@ namespace noisepp
 			{
 				return mValue;
 			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_CONSTANT;
+				op.params[0] = mValue;
+			}
 	};
 
 	typedef ConstantElement<PipelineElement1D> ConstantElement1D;
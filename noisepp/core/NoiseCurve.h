@@ -146,6 +146,14 @@ namespace noisepp
 				value = getElementValue (mElementPtr, mElement, x, y, z, cache);
 				return CurveElementBase<PipelineElement3D>::mapValue(value);
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return CurveElementBase<PipelineElement3D>::mapValue(slots[mElement]);
+			}
 	};
 
 	/** Module that maps the values from the source module onto a curve.
@@ -89,6 +89,20 @@ namespace noisepp
 				value = getElementValue (mElementPtr, mElement, x, y, z, cache);
 				return (std::pow (std::fabs ((value + Real(1.0)) / Real(2.0)), mExponent) * Real(2.0) - Real(1.0));
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return (std::pow (std::fabs ((slots[mElement] + Real(1.0)) / Real(2.0)), mExponent) * Real(2.0) - Real(1.0));
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_EXPONENT;
+				op.sources[0] = mElement;
+				op.params[0] = mExponent;
+			}
 	};
 
 	/** Exponent module.
@@ -437,6 +437,207 @@ namespace noisepp
 				return Real(1.0) - ((Real)intNoise(x, y, z, seed) / Real(1073741824.0));
 			}
 	};
+
+	/** Gradient coherent noise of one octave over a regular grid of positions.
+		Gives exactly the values of the matching Generator3D::calcGradientCoherent*() functions,
+		with the work shared between positions: the lattice cell, fade curve and corner distances
+		are computed once per position along each axis, and every lattice corner the grid touches
+		is hashed once instead of once per position and cell corner. If the grid is so coarse that
+		there are more corners than positions, corners are hashed per position instead.
+	*/
+	class GridGenerator3D
+	{
+		private:
+			struct Axis
+			{
+				/// Lower lattice coordinate, relative to minCell.
+				std::vector<int> cell;
+				/// Lower lattice coordinate times the hash factor of the axis.
+				std::vector<int> hash;
+				/// Fade curve value.
+				std::vector<Real> fade;
+				/// Distances to the lower and upper lattice coordinate.
+				std::vector<Real> delta0, delta1;
+				int minCell;
+				/// Lattice coordinates touched.
+				size_t cornerCount;
+			};
+			Axis mAxes[3];
+			int mQuality;
+			std::vector<unsigned char> mCorners;
+
+			void setAxis (Axis &axis, Real start, Real spacing, size_t count, Real frequency, int factor)
+			{
+				axis.cell.resize (count);
+				axis.hash.resize (count);
+				axis.fade.resize (count);
+				axis.delta0.resize (count);
+				axis.delta1.resize (count);
+				int maxCell = 0;
+				for (size_t i=0;i<count;++i)
+				{
+					const Real x = Math::MakeInt32Range ((start + Real(i) * spacing) * frequency);
+					NOISE_GENERATOR_INTEGER_CLAMP_X;
+					if (i == 0 || x0 < axis.minCell)
+						axis.minCell = x0;
+					if (i == 0 || x0 > maxCell)
+						maxCell = x0;
+					axis.cell[i] = x0;
+					axis.hash[i] = factor * x0;
+					if (mQuality == NOISE_QUALITY_HIGH || mQuality == NOISE_QUALITY_FAST_HIGH)
+						axis.fade[i] = Math::CubicCurve5 (x - Real(x0));
+					else if (mQuality == NOISE_QUALITY_STD || mQuality == NOISE_QUALITY_FAST_STD)
+						axis.fade[i] = Math::CubicCurve3 (x - Real(x0));
+					else
+						axis.fade[i] = x - Real(x0);
+					axis.delta0[i] = x - Real(x0);
+					axis.delta1[i] = x - Real(x1);
+				}
+				for (size_t i=0;i<count;++i)
+				{
+					axis.cell[i] -= axis.minCell;
+				}
+				axis.cornerCount = count ? size_t(maxCell - axis.minCell) + 2 : 0;
+			}
+
+			static NOISEPP_INLINE int hashCorner (int hx, int hy, int hz, int seed)
+			{
+				int vIndex = (hx + hy + hz + NOISE_SEED_FACTOR * seed) & 0xffffffff;
+				vIndex ^= (vIndex >> NOISE_SHIFT);
+				vIndex &= 0xff;
+				return vIndex;
+			}
+
+			static NOISEPP_INLINE Real calcGradient (int vIndex, Real xDelta, Real yDelta, Real zDelta)
+			{
+				const Real xGradient = randomVectors3D[(vIndex<<2)];
+				const Real yGradient = randomVectors3D[(vIndex<<2)+1];
+				const Real zGradient = randomVectors3D[(vIndex<<2)+2];
+				return (xGradient * xDelta + yGradient * yDelta + zGradient * zDelta);
+			}
+
+		public:
+			GridGenerator3D () : mQuality(NOISE_QUALITY_STD)
+			{
+			}
+			/// Sets the grid: position (i, j, k) is (x + i*spacing, y + j*spacing, z + k*spacing) multiplied by frequency.
+			/// @param quality One of the NOISE_QUALITY_* values.
+			void setGrid (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real frequency, int quality)
+			{
+				mQuality = quality;
+				setAxis (mAxes[0], x, spacing, countX, frequency, NOISE_X_FACTOR);
+				setAxis (mAxes[1], y, spacing, countY, frequency, NOISE_Y_FACTOR);
+				setAxis (mAxes[2], z, spacing, countZ, frequency, NOISE_Z_FACTOR);
+			}
+			/// Writes the noise of every grid position to out, x running fastest, then y, then z.
+			void calcGradientCoherentNoise (int seed, Real scale, Real *out)
+			{
+				const Axis &ax = mAxes[0];
+				const Axis &ay = mAxes[1];
+				const Axis &az = mAxes[2];
+				const size_t countX = ax.cell.size();
+				const size_t countY = ay.cell.size();
+				const size_t countZ = az.cell.size();
+				const size_t cornersX = ax.cornerCount;
+				const size_t cornersXY = ax.cornerCount * ay.cornerCount;
+				const bool table = cornersXY * az.cornerCount <= countX * countY * countZ;
+				if (table)
+				{
+					mCorners.resize (cornersXY * az.cornerCount);
+					size_t index = 0;
+					for (size_t k=0;k<az.cornerCount;++k)
+					{
+						const int hz = NOISE_Z_FACTOR * (az.minCell + int(k));
+						for (size_t j=0;j<ay.cornerCount;++j)
+						{
+							const int hy = NOISE_Y_FACTOR * (ay.minCell + int(j));
+							for (size_t i=0;i<ax.cornerCount;++i,++index)
+							{
+								mCorners[index] = (unsigned char)hashCorner (NOISE_X_FACTOR * (ax.minCell + int(i)), hy, hz, seed);
+							}
+						}
+					}
+				}
+				const bool fast = mQuality > NOISE_QUALITY_HIGH;
+				for (size_t k=0;k<countZ;++k)
+				{
+					const Real zs = az.fade[k];
+					const Real dz0 = az.delta0[k];
+					const Real dz1 = az.delta1[k];
+					const int hz0 = az.hash[k];
+					const int hz1 = hz0 + NOISE_Z_FACTOR;
+					for (size_t j=0;j<countY;++j)
+					{
+						const Real ys = ay.fade[j];
+						const Real dy0 = ay.delta0[j];
+						const Real dy1 = ay.delta1[j];
+						const int hy0 = ay.hash[j];
+						const int hy1 = hy0 + NOISE_Y_FACTOR;
+						const size_t cornerRow = az.cell[k] * cornersXY + ay.cell[j] * cornersX;
+						for (size_t i=0;i<countX;++i)
+						{
+							int c[8];
+							if (table)
+							{
+								const size_t corner = cornerRow + ax.cell[i];
+								c[0] = mCorners[corner];
+								c[1] = mCorners[corner + 1];
+								c[2] = mCorners[corner + cornersX];
+								c[3] = mCorners[corner + cornersX + 1];
+								c[4] = mCorners[corner + cornersXY];
+								c[5] = mCorners[corner + cornersXY + 1];
+								c[6] = mCorners[corner + cornersXY + cornersX];
+								c[7] = mCorners[corner + cornersXY + cornersX + 1];
+							}
+							else
+							{
+								const int hx0 = ax.hash[i];
+								const int hx1 = hx0 + NOISE_X_FACTOR;
+								c[0] = hashCorner (hx0, hy0, hz0, seed);
+								c[1] = hashCorner (hx1, hy0, hz0, seed);
+								c[2] = hashCorner (hx0, hy1, hz0, seed);
+								c[3] = hashCorner (hx1, hy1, hz0, seed);
+								c[4] = hashCorner (hx0, hy0, hz1, seed);
+								c[5] = hashCorner (hx1, hy0, hz1, seed);
+								c[6] = hashCorner (hx0, hy1, hz1, seed);
+								c[7] = hashCorner (hx1, hy1, hz1, seed);
+							}
+							const Real xs = ax.fade[i];
+							const Real dx0 = ax.delta0[i];
+							const Real dx1 = ax.delta1[i];
+							Real n0, n1, ix0, ix1, iy0, iy1;
+							if (fast)
+							{
+								ix0 = Math::InterpLinear (gradientVector[c[0]], gradientVector[c[1]], xs);
+								ix1 = Math::InterpLinear (gradientVector[c[2]], gradientVector[c[3]], xs);
+								iy0 = Math::InterpLinear (ix0, ix1, ys);
+								ix0 = Math::InterpLinear (gradientVector[c[4]], gradientVector[c[5]], xs);
+								ix1 = Math::InterpLinear (gradientVector[c[6]], gradientVector[c[7]], xs);
+								iy1 = Math::InterpLinear (ix0, ix1, ys);
+							}
+							else
+							{
+								n0 = calcGradient (c[0], dx0, dy0, dz0);
+								n1 = calcGradient (c[1], dx1, dy0, dz0);
+								ix0 = Math::InterpLinear (n0, n1, xs);
+								n0 = calcGradient (c[2], dx0, dy1, dz0);
+								n1 = calcGradient (c[3], dx1, dy1, dz0);
+								ix1 = Math::InterpLinear (n0, n1, xs);
+								iy0 = Math::InterpLinear (ix0, ix1, ys);
+								n0 = calcGradient (c[4], dx0, dy0, dz1);
+								n1 = calcGradient (c[5], dx1, dy0, dz1);
+								ix0 = Math::InterpLinear (n0, n1, xs);
+								n0 = calcGradient (c[6], dx0, dy1, dz1);
+								n1 = calcGradient (c[7], dx1, dy1, dz1);
+								ix1 = Math::InterpLinear (n0, n1, xs);
+								iy1 = Math::InterpLinear (ix0, ix1, ys);
+							}
+							*out++ = Math::InterpLinear (iy0, iy1, zs) * scale;
+						}
+					}
+				}
+			}
+	};
 };
 
 #endif
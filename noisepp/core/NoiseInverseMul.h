@@ -87,6 +87,20 @@ namespace noisepp
                 
 				return value != 0 ? (1/value) : 0;
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				Real value = slots[mElement];
+				return value != 0 ? (1/value) : 0;
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_INVERSEMUL;
+				op.sources[0] = mElement;
+			}
 	};
 
 	/** Inversion module.
@@ -86,6 +86,19 @@ namespace noisepp
 				value = getElementValue (mElementPtr, mElement, x, y, z, cache);
 				return -(value);
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return -(slots[mElement]);
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_INVERT;
+				op.sources[0] = mElement;
+			}
 	};
 
 	/** Inversion module.
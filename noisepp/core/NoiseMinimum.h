@@ -104,6 +104,24 @@ namespace noisepp
 				else
 					return right;
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mLeft);
+				sources.push_back (mRight);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				if (slots[mLeft] < slots[mRight])
+					return slots[mLeft];
+				else
+					return slots[mRight];
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_MINIMUM;
+				op.sources[0] = mLeft;
+				op.sources[1] = mRight;
+			}
 	};
 
 	/** Minimum module.
@@ -59,6 +59,8 @@ namespace noisepp
 		MODULE_VORONOI=22,
         MODULE_Y=23,
         MODULE_INVERTMUL=24,
+        MODULE_SIMPLEX=25,
+        MODULE_RIDGEDSIMPLEX=26,
 	};
 
 #if NOISEPP_ENABLE_UTILS
@@ -77,10 +79,12 @@ namespace noisepp
 			const Module **mSourceModules;
 			/// Number of source modules.
 			size_t mSourceModuleCount;
+			/// Set once the module is the source of another one; until then nothing can reach it.
+			mutable bool mIsSourceModule;
 
 		public:
 			/// @param sourceModuleCount The number of source modules.
-			Module (size_t sourceModuleCount=0) : mSourceModules(NULL), mSourceModuleCount(sourceModuleCount)
+			Module (size_t sourceModuleCount=0) : mSourceModules(NULL), mSourceModuleCount(sourceModuleCount), mIsSourceModule(false)
 			{
 				if (mSourceModuleCount)
 				{
@@ -117,8 +121,10 @@ namespace noisepp
 				NoiseAssertRange (id, mSourceModuleCount);
 				NoiseAssert (module != NULL, module);
 				NoiseAssert (module != this, module);
-				NoiseAssert (!module->walkTree(this), module);
+				// A module nothing points at can't be part of a cycle, graphs built bottom up skip the walk.
+				NoiseAssert (!mIsSourceModule || !module->walkTree(this), module);
 				mSourceModules[id] = module;
+				module->mIsSourceModule = true;
 			}
 			/// @copydoc setSourceModule(size_t, const Module*).
 			void setSourceModule (size_t id, const Module &module)
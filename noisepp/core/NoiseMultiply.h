@@ -95,6 +95,21 @@ namespace noisepp
 				value *= getElementValue (mRightPtr, mRight, x, y, z, cache);
 				return value;
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mLeft);
+				sources.push_back (mRight);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return slots[mLeft] * slots[mRight];
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_MULTIPLY;
+				op.sources[0] = mLeft;
+				op.sources[1] = mRight;
+			}
 	};
 
 	/** Multiplication module.
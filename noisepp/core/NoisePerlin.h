@@ -277,6 +277,13 @@ namespace noisepp
 
 				return value;
 			}
+			virtual void getValues (const Real *x, const Real *y, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = PerlinElement2D::getValue (x[i], y[i], cache);
+				}
+			}
 	};
 
 	class PerlinElement3D : public PipelineElement3D
@@ -350,6 +357,29 @@ namespace noisepp
 
 				return value;
 			}
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = PerlinElement3D::getValue (x[i], y[i], z[i], cache);
+				}
+			}
+			virtual void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real *out, Cache *cache) const
+			{
+				const size_t total = countX * countY * countZ;
+				std::vector<Real> signals(total);
+				GridGenerator3D generator;
+				std::fill (out, out + total, Real(0.0));
+				for (size_t o=0;o<mOctaveCount;++o)
+				{
+					generator.setGrid (x, y, z, spacing, countX, countY, countZ, mOctaves[o].scale, mQuality);
+					generator.calcGradientCoherentNoise (mOctaves[o].seed, mScale, &signals[0]);
+					for (size_t i=0;i<total;++i)
+					{
+						out[i] += signals[i] * mOctaves[o].persistence;
+					}
+				}
+			}
 	};
 
 	/** Module for generating perlin noise.
@@ -133,9 +133,9 @@ namespace noisepp
 			{
 				delete[] cache;
 			}
-			/// Adds the specified element to the pipeline.
-			/// This is used internally by modules.
-			ElementID addElement (const Module *parent, Element *element)
+			/// Adds the specified element to the pipeline and returns the ID its users refer to it by.
+			/// This is used internally by modules. The pipeline owns the element afterwards.
+			virtual ElementID addElement (const Module *parent, Element *element)
 			{
 				NoiseAssert (element != NULL, element);
 				NoiseAssert (parent != NULL, parent);
@@ -283,9 +283,64 @@ namespace noisepp
 
 		public:
 			virtual Real getValue (Real x, Real y, Cache *cache) const = 0;
+			/// Evaluates count positions given as coordinate arrays into out.
+			/// Generators override this with a loop the compiler can inline, so a row costs one virtual call instead of one per position.
+			virtual void getValues (const Real *x, const Real *y, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = getValue (x[i], y[i], cache);
+				}
+			}
 			virtual ~PipelineElement2D () {}
 	};
 
+	/// Operation types of compiled 3D kernels (see PipelineKernel3D).
+	enum KernelOpType
+	{
+		/// Not compiled, the kernel calls the element.
+		KERNELOP_ELEMENT,
+		/// params[0]
+		KERNELOP_CONSTANT,
+		/// The y coordinate.
+		KERNELOP_Y,
+		/// sources[0] + sources[1]
+		KERNELOP_ADD,
+		/// sources[0] * sources[1]
+		KERNELOP_MULTIPLY,
+		/// min(sources[0], sources[1])
+		KERNELOP_MINIMUM,
+		/// max(sources[0], sources[1])
+		KERNELOP_MAXIMUM,
+		/// pow(sources[0], sources[1])
+		KERNELOP_POWER,
+		/// Blends sources[0] and sources[1] by sources[2].
+		KERNELOP_BLEND,
+		/// |sources[0]|
+		KERNELOP_ABSOLUTE,
+		/// sources[0] clamped to [params[0], params[1]]
+		KERNELOP_CLAMP,
+		/// Normalized sources[0] raised to params[0].
+		KERNELOP_EXPONENT,
+		/// -sources[0]
+		KERNELOP_INVERT,
+		/// 1 / sources[0], 0 for 0
+		KERNELOP_INVERSEMUL,
+		/// sources[0] * params[0] + params[1]
+		KERNELOP_SCALEBIAS
+	};
+
+	/// Description of an element as an operation of a compiled kernel, see PipelineElement3D::getKernelOp().
+	struct KernelOp
+	{
+		/// Operation type.
+		KernelOpType type;
+		/// Source element IDs, as many as the operation reads.
+		ElementID sources[3];
+		/// Parameters.
+		Real params[2];
+	};
+
 	class PipelineElement3D
 	{
 		protected:
@@ -307,6 +362,51 @@ namespace noisepp
 
 		public:
 			virtual Real getValue (Real x, Real y, Real z, Cache *cache) const = 0;
+			/// Appends the IDs of the elements this element reads at the same position.
+			/// Elements which list their sources get the source values from the slot array in scheduled evaluation (see PipelineSchedule3D).
+			/// The default lists none, so the element is evaluated through getValue() and takes care of its sources itself.
+			virtual void getSourceElements (std::vector<ElementID> &sources) const {}
+			/// Returns the value computed from the source values in slots, which is indexed by element ID.
+			/// Only called after all elements returned by getSourceElements() have been stored.
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return getValue (x, y, z, cache);
+			}
+			/// Describes the element as a kernel operation (see PipelineKernel3D).
+			/// The sources of the operation have to be the ones listed by getSourceElements(). The default leaves the element to be called by the kernel.
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_ELEMENT;
+			}
+			/// Evaluates count positions given as coordinate arrays into out.
+			/// Generators override this with a loop the compiler can inline, so a block costs one virtual call instead of one per position.
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = getValue (x[i], y[i], z[i], cache);
+				}
+			}
+			/// Evaluates a regular grid into out, x running fastest, then y, then z.
+			/// Position (i, j, k) is (x + i*spacing, y + j*spacing, z + k*spacing).
+			/// Generators override this to share work between neighbouring positions.
+			virtual void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real *out, Cache *cache) const
+			{
+				std::vector<Real> px(countX), py(countX), pz(countX);
+				for (size_t i=0;i<countX;++i)
+				{
+					px[i] = x + Real(i) * spacing;
+				}
+				for (size_t k=0;k<countZ;++k)
+				{
+					std::fill (pz.begin(), pz.end(), z + Real(k) * spacing);
+					for (size_t j=0;j<countY;++j,out+=countX)
+					{
+						std::fill (py.begin(), py.end(), y + Real(j) * spacing);
+						getValues (&px[0], &py[0], &pz[0], countX, out, cache);
+					}
+				}
+			}
 			virtual ~PipelineElement3D () {}
 	};
 };
@@ -0,0 +1,591 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef NOISEPP_PIPELINEKERNEL_H
+#define NOISEPP_PIPELINEKERNEL_H
+
+#include "NoisePipelineSchedule.h"
+
+namespace noisepp
+{
+	/** A 3D pipeline element and everything it depends on, compiled into a flat list of operations.
+		The kernel takes the evaluation order of a PipelineSchedule3D and turns each element that
+		describes itself through PipelineElement3D::getKernelOp() into an operation on registers of
+		BLOCK_SIZE values. Positions are evaluated a block at a time and every operation is one tight
+		loop over the block, so there is no virtual call per position and element left and the
+		compiler can vectorize the arithmetic. A register is reused once its last reader has run,
+		which keeps the working set small for big graphs.
+		Elements without kernel operation are still called: once per block through
+		PipelineElement3D::getValues() if they list no sources, otherwise once per position through
+		PipelineElement3D::getScheduledValue().
+		The kernel also knows which coordinates each operation depends on. getGridValues() uses this
+		to evaluate constants once per grid, y-only terms once per y, z-only terms once per z and
+		terms without x once per row, broadcasting the results to the operations which need them
+		per position. Called elements are assumed to depend on all coordinates; those without
+		sources evaluate the whole grid up front through PipelineElement3D::getGridValues().
+		verify() compares the results with the interpreted pipeline.
+	*/
+	class PipelineKernel3D
+	{
+		public:
+			/// Number of positions evaluated together.
+			static const size_t BLOCK_SIZE = 64;
+			/// Coordinate dependencies, see getDependencies().
+			enum
+			{
+				DEPENDS_X = 1,
+				DEPENDS_Y = 2,
+				DEPENDS_Z = 4
+			};
+
+		private:
+			struct Instruction
+			{
+				KernelOpType type;
+				const PipelineElement3D *element;
+				size_t target;
+				size_t sources[3];
+				Real params[2];
+				/// Source element IDs and registers of elements called per position.
+				std::vector<std::pair<ElementID, size_t> > slotSources;
+				/// Index of the precomputed grid of elements without sources in getGridValues(), or NO_GRID.
+				size_t grid;
+			};
+			static const size_t NO_GRID = ~size_t(0);
+			struct Step
+			{
+				const PipelineElement3D *element;
+				ElementID slot;
+				KernelOp op;
+				std::vector<ElementID> sources;
+			};
+			typedef std::vector<Instruction> Program;
+
+			size_t mSlotCount;
+			ElementID mRoot;
+			std::vector<int> mDependencies;
+
+			Program mProgram;
+			size_t mRegisterCount;
+			size_t mResult;
+
+			/// Operations without x dependency, by dependencies / DEPENDS_Y: none, y, z, y and z.
+			/// Their registers are single values which live for the whole grid.
+			Program mUniformPrograms[4];
+			size_t mUniformCount;
+			/// Operations with x dependency.
+			Program mRowProgram;
+			size_t mRowRegisterCount;
+			/// Elements of the row program evaluated through PipelineElement3D::getGridValues().
+			size_t mGridCount;
+			/// Uniform values copied into row registers before a block.
+			std::vector<std::pair<size_t, size_t> > mBroadcasts;
+			size_t mRowResult;
+			bool mUniformResult;
+
+			static size_t getSourceCount (KernelOpType type)
+			{
+				switch (type)
+				{
+					case KERNELOP_ELEMENT:
+					case KERNELOP_CONSTANT:
+					case KERNELOP_Y:
+						return 0;
+					case KERNELOP_ADD:
+					case KERNELOP_MULTIPLY:
+					case KERNELOP_MINIMUM:
+					case KERNELOP_MAXIMUM:
+					case KERNELOP_POWER:
+						return 2;
+					case KERNELOP_BLEND:
+						return 3;
+					default:
+						return 1;
+				}
+			}
+
+			static Instruction createInstruction (const Step &step)
+			{
+				Instruction ins;
+				ins.type = step.op.type;
+				ins.element = step.element;
+				ins.target = 0;
+				ins.sources[0] = ins.sources[1] = ins.sources[2] = 0;
+				ins.params[0] = step.op.params[0];
+				ins.params[1] = step.op.params[1];
+				ins.grid = NO_GRID;
+				return ins;
+			}
+
+			/// Compiles the steps in order, registers holds the register of each slot computed before.
+			/// Registers of values computed here are reused after their last reader.
+			void compile (const std::vector<Step> &steps, const std::vector<size_t> &order, std::vector<size_t> &registers, size_t &registerCount, Program &program) const
+			{
+				std::vector<size_t> lastUse(mSlotCount, 0);
+				std::vector<char> produced(mSlotCount, 0);
+				for (size_t i=0;i<order.size();++i)
+				{
+					const std::vector<ElementID> &sources = steps[order[i]].sources;
+					for (size_t s=0;s<sources.size();++s)
+					{
+						lastUse[sources[s]] = i;
+					}
+				}
+				lastUse[mRoot] = order.size();
+
+				std::vector<size_t> freeRegisters;
+				for (size_t i=0;i<order.size();++i)
+				{
+					const Step &step = steps[order[i]];
+					const std::vector<ElementID> &sources = step.sources;
+					Instruction ins = createInstruction (step);
+					for (size_t s=0;s<sources.size();++s)
+					{
+						if (ins.type == KERNELOP_ELEMENT)
+							ins.slotSources.push_back (std::make_pair(sources[s], registers[sources[s]]));
+						else
+							ins.sources[s] = registers[sources[s]];
+					}
+					// operations read position i of their sources before writing it, so the target may reuse a source register
+					for (size_t s=0;s<sources.size();++s)
+					{
+						if (produced[sources[s]] && lastUse[sources[s]] == i && std::find(sources.begin(), sources.begin()+s, sources[s]) == sources.begin()+s)
+							freeRegisters.push_back (registers[sources[s]]);
+					}
+					if (freeRegisters.empty())
+					{
+						ins.target = registerCount++;
+					}
+					else
+					{
+						ins.target = freeRegisters.back ();
+						freeRegisters.pop_back ();
+					}
+					registers[step.slot] = ins.target;
+					produced[step.slot] = 1;
+					program.push_back (ins);
+				}
+			}
+
+			/// Runs one operation other than KERNELOP_ELEMENT on count positions.
+			static NOISEPP_INLINE void executeOperation (const Instruction &ins, const Real *y, size_t count, const Real *a, const Real *b, const Real *c, Real *t)
+			{
+				const Real p0 = ins.params[0];
+				const Real p1 = ins.params[1];
+				size_t i;
+				switch (ins.type)
+				{
+					case KERNELOP_ELEMENT:
+						break;
+					case KERNELOP_CONSTANT:
+						for (i=0;i<count;++i)
+							t[i] = p0;
+						break;
+					case KERNELOP_Y:
+						for (i=0;i<count;++i)
+							t[i] = y[i];
+						break;
+					case KERNELOP_ADD:
+						for (i=0;i<count;++i)
+							t[i] = a[i] + b[i];
+						break;
+					case KERNELOP_MULTIPLY:
+						for (i=0;i<count;++i)
+							t[i] = a[i] * b[i];
+						break;
+					case KERNELOP_MINIMUM:
+						for (i=0;i<count;++i)
+							t[i] = a[i] < b[i] ? a[i] : b[i];
+						break;
+					case KERNELOP_MAXIMUM:
+						for (i=0;i<count;++i)
+							t[i] = a[i] > b[i] ? a[i] : b[i];
+						break;
+					case KERNELOP_POWER:
+						for (i=0;i<count;++i)
+							t[i] = std::pow (a[i], b[i]);
+						break;
+					case KERNELOP_BLEND:
+						for (i=0;i<count;++i)
+							t[i] = Math::InterpLinear (a[i], b[i], (c[i] + Real(1.0)) / Real(2.0));
+						break;
+					case KERNELOP_ABSOLUTE:
+						for (i=0;i<count;++i)
+							t[i] = std::fabs (a[i]);
+						break;
+					case KERNELOP_CLAMP:
+						for (i=0;i<count;++i)
+							t[i] = a[i] < p0 ? p0 : (a[i] > p1 ? p1 : a[i]);
+						break;
+					case KERNELOP_EXPONENT:
+						for (i=0;i<count;++i)
+							t[i] = std::pow (std::fabs ((a[i] + Real(1.0)) / Real(2.0)), p0) * Real(2.0) - Real(1.0);
+						break;
+					case KERNELOP_INVERT:
+						for (i=0;i<count;++i)
+							t[i] = -a[i];
+						break;
+					case KERNELOP_INVERSEMUL:
+						for (i=0;i<count;++i)
+							t[i] = a[i] != 0 ? (1/a[i]) : 0;
+						break;
+					case KERNELOP_SCALEBIAS:
+						for (i=0;i<count;++i)
+							t[i] = a[i] * p0 + p1;
+						break;
+				}
+			}
+
+			/// grids holds the values of the elements evaluated per grid, starting at the first position of the block.
+			void executeBlock (const Program &program, const Real *x, const Real *y, const Real *z, size_t count, Real *registers, Real *slots, const Real *const *grids, Cache *cache) const
+			{
+				const Instruction *ins = &program[0];
+				const Instruction *end = ins + program.size();
+				for (;ins!=end;++ins)
+				{
+					Real *t = registers + ins->target * BLOCK_SIZE;
+					if (ins->type != KERNELOP_ELEMENT)
+					{
+						executeOperation (*ins, y, count, registers + ins->sources[0] * BLOCK_SIZE, registers + ins->sources[1] * BLOCK_SIZE, registers + ins->sources[2] * BLOCK_SIZE, t);
+					}
+					else if (ins->grid != NO_GRID)
+					{
+						const Real *values = grids[ins->grid];
+						for (size_t i=0;i<count;++i)
+							t[i] = values[i];
+					}
+					else if (ins->slotSources.empty())
+					{
+						ins->element->getValues (x, y, z, count, t, cache);
+					}
+					else
+					{
+						const size_t sourceCount = ins->slotSources.size();
+						for (size_t i=0;i<count;++i)
+						{
+							for (size_t s=0;s<sourceCount;++s)
+							{
+								slots[ins->slotSources[s].first] = registers[ins->slotSources[s].second * BLOCK_SIZE + i];
+							}
+							t[i] = ins->element->getScheduledValue (x[i], y[i], z[i], slots, cache);
+						}
+					}
+				}
+			}
+
+			void executeUniform (const Program &program, Real y, Real *values) const
+			{
+				for (size_t i=0;i<program.size();++i)
+				{
+					const Instruction &ins = program[i];
+					executeOperation (ins, &y, 1, values + ins.sources[0], values + ins.sources[1], values + ins.sources[2], values + ins.target);
+				}
+			}
+
+		public:
+			/// Constructor.
+			/// @param schedule The schedule to compile, it is not needed afterwards.
+			PipelineKernel3D (const PipelineSchedule3D &schedule) : mSlotCount(schedule.getSlotCount()), mRoot(schedule.getRoot()), mDependencies(mSlotCount, 0),
+				mRegisterCount(0), mResult(0), mUniformCount(0), mRowRegisterCount(0), mGridCount(0), mRowResult(0), mUniformResult(false)
+			{
+				const size_t stepCount = schedule.getStepCount ();
+				std::vector<Step> steps(stepCount);
+				std::vector<size_t> order(stepCount);
+				for (size_t i=0;i<stepCount;++i)
+				{
+					Step &step = steps[i];
+					step.element = schedule.getStepElement (i);
+					step.slot = schedule.getStepSlot (i);
+					step.op.type = KERNELOP_ELEMENT;
+					step.op.params[0] = step.op.params[1] = 0;
+					step.element->getKernelOp (step.op);
+					if (step.op.type == KERNELOP_ELEMENT)
+						step.element->getSourceElements (step.sources);
+					else
+						step.sources.assign (step.op.sources, step.op.sources + getSourceCount(step.op.type));
+
+					int dependencies = 0;
+					if (step.op.type == KERNELOP_ELEMENT)
+						dependencies = DEPENDS_X | DEPENDS_Y | DEPENDS_Z;
+					else if (step.op.type == KERNELOP_Y)
+						dependencies = DEPENDS_Y;
+					for (size_t s=0;s<step.sources.size();++s)
+					{
+						dependencies |= mDependencies[step.sources[s]];
+					}
+					mDependencies[step.slot] = dependencies;
+					order[i] = i;
+				}
+
+				std::vector<size_t> registers(mSlotCount, 0);
+				compile (steps, order, registers, mRegisterCount, mProgram);
+				mResult = registers[mRoot];
+
+				// grid evaluation: uniform values get a register each, in evaluation order
+				std::vector<size_t> uniformIDs(mSlotCount, 0);
+				std::vector<size_t> rowOrder;
+				for (size_t i=0;i<stepCount;++i)
+				{
+					const Step &step = steps[i];
+					const int dependencies = mDependencies[step.slot];
+					if (dependencies & DEPENDS_X)
+					{
+						rowOrder.push_back (i);
+						continue;
+					}
+					Instruction ins = createInstruction (step);
+					for (size_t s=0;s<step.sources.size();++s)
+					{
+						ins.sources[s] = uniformIDs[step.sources[s]];
+					}
+					ins.target = uniformIDs[step.slot] = mUniformCount++;
+					mUniformPrograms[dependencies / DEPENDS_Y].push_back (ins);
+				}
+				registers.assign (mSlotCount, 0);
+				std::vector<char> broadcast(mSlotCount, 0);
+				for (size_t i=0;i<rowOrder.size();++i)
+				{
+					const std::vector<ElementID> &sources = steps[rowOrder[i]].sources;
+					for (size_t s=0;s<sources.size();++s)
+					{
+						if (!(mDependencies[sources[s]] & DEPENDS_X) && !broadcast[sources[s]])
+						{
+							broadcast[sources[s]] = 1;
+							registers[sources[s]] = mRowRegisterCount++;
+							mBroadcasts.push_back (std::make_pair(uniformIDs[sources[s]], registers[sources[s]]));
+						}
+					}
+				}
+				compile (steps, rowOrder, registers, mRowRegisterCount, mRowProgram);
+				for (size_t i=0;i<mRowProgram.size();++i)
+				{
+					if (mRowProgram[i].type == KERNELOP_ELEMENT && mRowProgram[i].slotSources.empty())
+						mRowProgram[i].grid = mGridCount++;
+				}
+				mUniformResult = !(mDependencies[mRoot] & DEPENDS_X);
+				mRowResult = mUniformResult ? uniformIDs[mRoot] : registers[mRoot];
+			}
+			/// Returns the number of operations per block.
+			size_t getInstructionCount () const
+			{
+				return mProgram.size ();
+			}
+			/// Returns the number of operations which call their element.
+			size_t getElementCallCount () const
+			{
+				size_t count = 0;
+				for (size_t i=0;i<mProgram.size();++i)
+				{
+					if (mProgram[i].type == KERNELOP_ELEMENT)
+						++count;
+				}
+				return count;
+			}
+			/// Returns the number of operations getGridValues() runs per position; the others run per row or less.
+			size_t getRowInstructionCount () const
+			{
+				return mRowProgram.size ();
+			}
+			/// Returns the number of registers of BLOCK_SIZE values.
+			size_t getRegisterCount () const
+			{
+				return mRegisterCount > mRowRegisterCount ? mRegisterCount : mRowRegisterCount;
+			}
+			/// Returns the coordinates the value of the specified element depends on, as DEPENDS_* flags.
+			/// Only valid for elements the root depends on.
+			int getDependencies (ElementID element) const
+			{
+				NoiseAssertRange (element, mSlotCount);
+				return mDependencies[element];
+			}
+			/// Creates the memory getValues() and getGridValues() work in.
+			/// You need one workspace per kernel and thread. Don't forget to free it.
+			Real *createWorkspace () const
+			{
+				return new Real[getRegisterCount() * BLOCK_SIZE + mSlotCount + mUniformCount];
+			}
+			/// Frees the specified workspace.
+			void freeWorkspace (Real *workspace) const
+			{
+				delete[] workspace;
+			}
+			/// Evaluates count positions given as coordinate arrays into out.
+			/// @param workspace Workspace from createWorkspace(), one per thread.
+			/// @param cache Cache of the pipeline for elements called by the kernel, one per thread.
+			void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Real *workspace, Cache *cache) const
+			{
+				Real *slots = workspace + getRegisterCount() * BLOCK_SIZE;
+				const Real *result = workspace + mResult * BLOCK_SIZE;
+				while (count > 0)
+				{
+					const size_t n = count < BLOCK_SIZE ? count : BLOCK_SIZE;
+					executeBlock (mProgram, x, y, z, n, workspace, slots, 0, cache);
+					for (size_t i=0;i<n;++i)
+					{
+						out[i] = result[i];
+					}
+					x += n;
+					y += n;
+					z += n;
+					out += n;
+					count -= n;
+				}
+			}
+			/// Evaluates a regular grid of positions, every operation at the dimensionality of its dependencies.
+			/// Position (i, j, k) is (x + i*spacing, y + j*spacing, z + k*spacing) and its value goes to out[i + j*strideY + k*strideZ].
+			/// @param workspace Workspace from createWorkspace(), one per thread.
+			/// @param cache Cache of the pipeline for elements called by the kernel, one per thread.
+			template <class T>
+			void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, T *out, size_t strideY, size_t strideZ, Real *workspace, Cache *cache) const
+			{
+				Real *slots = workspace + getRegisterCount() * BLOCK_SIZE;
+				Real *uniforms = slots + mSlotCount;
+				const Program &constants = mUniformPrograms[0];
+				const Program &yTerms = mUniformPrograms[DEPENDS_Y / DEPENDS_Y];
+				const Program &zTerms = mUniformPrograms[DEPENDS_Z / DEPENDS_Y];
+				const Program &yzTerms = mUniformPrograms[(DEPENDS_Y | DEPENDS_Z) / DEPENDS_Y];
+
+				// elements without sources evaluate the whole grid at once, sharing work between positions
+				const size_t total = countX * countY * countZ;
+				std::vector<Real> gridValues(mGridCount * total);
+				std::vector<const Real*> grids(mGridCount + 1);
+				for (size_t i=0;i<mRowProgram.size();++i)
+				{
+					const Instruction &ins = mRowProgram[i];
+					if (ins.grid != NO_GRID)
+						ins.element->getGridValues (x, y, z, spacing, countX, countY, countZ, &gridValues[ins.grid * total], cache);
+				}
+
+				// constants once, y terms once per y
+				executeUniform (constants, y, uniforms);
+				std::vector<Real> yValues(countY * yTerms.size());
+				for (size_t j=0;j<countY;++j)
+				{
+					executeUniform (yTerms, y + Real(j) * spacing, uniforms);
+					for (size_t t=0;t<yTerms.size();++t)
+					{
+						yValues[j * yTerms.size() + t] = uniforms[yTerms[t].target];
+					}
+				}
+
+				std::vector<Real> px(BLOCK_SIZE), py(BLOCK_SIZE), pz(BLOCK_SIZE);
+				const Real *result = mUniformResult ? uniforms + mRowResult : workspace + mRowResult * BLOCK_SIZE;
+				const size_t resultStride = mUniformResult ? 0 : 1;
+				for (size_t k=0;k<countZ;++k)
+				{
+					const Real pointZ = z + Real(k) * spacing;
+					std::fill (pz.begin(), pz.end(), pointZ);
+					executeUniform (zTerms, pointZ, uniforms);
+					for (size_t j=0;j<countY;++j)
+					{
+						const Real pointY = y + Real(j) * spacing;
+						std::fill (py.begin(), py.end(), pointY);
+						for (size_t t=0;t<yTerms.size();++t)
+						{
+							uniforms[yTerms[t].target] = yValues[j * yTerms.size() + t];
+						}
+						executeUniform (yzTerms, pointY, uniforms);
+
+						T *row = out + j * strideY + k * strideZ;
+						for (size_t i=0;i<countX;i+=BLOCK_SIZE)
+						{
+							const size_t n = (countX - i) < BLOCK_SIZE ? (countX - i) : BLOCK_SIZE;
+							if (!mUniformResult)
+							{
+								for (size_t b=0;b<n;++b)
+								{
+									px[b] = x + Real(i + b) * spacing;
+								}
+								for (size_t b=0;b<mBroadcasts.size();++b)
+								{
+									std::fill (workspace + mBroadcasts[b].second * BLOCK_SIZE, workspace + mBroadcasts[b].second * BLOCK_SIZE + n, uniforms[mBroadcasts[b].first]);
+								}
+								const size_t position = (k * countY + j) * countX + i;
+								for (size_t g=0;g<mGridCount;++g)
+								{
+									grids[g] = &gridValues[g * total + position];
+								}
+								executeBlock (mRowProgram, &px[0], &py[0], &pz[0], n, workspace, slots, &grids[0], cache);
+							}
+							for (size_t b=0;b<n;++b)
+							{
+								row[i + b] = T(result[b * resultStride]);
+							}
+						}
+					}
+				}
+			}
+			/// Evaluates a grid of count^3 positions through getValues(), getGridValues() and the interpreted pipeline and returns the largest difference.
+			/// All should agree exactly, up to compilers contracting the arithmetic differently.
+			/// @param pipe The pipeline the schedule was built from.
+			/// @param x,y,z The first grid position.
+			/// @param spacing The distance between grid positions.
+			Real verify (const Pipeline3D *pipe, Real x, Real y, Real z, Real spacing, size_t count) const
+			{
+				const size_t total = count * count * count;
+				std::vector<Real> px(total), py(total), pz(total), values(total), gridValues(total);
+				size_t index = 0;
+				for (size_t k=0;k<count;++k)
+				{
+					for (size_t j=0;j<count;++j)
+					{
+						for (size_t i=0;i<count;++i,++index)
+						{
+							px[index] = x + Real(i) * spacing;
+							py[index] = y + Real(j) * spacing;
+							pz[index] = z + Real(k) * spacing;
+						}
+					}
+				}
+				Cache *cache = pipe->createCache ();
+				Real *workspace = createWorkspace ();
+				getValues (&px[0], &py[0], &pz[0], total, &values[0], workspace, cache);
+				getGridValues (x, y, z, spacing, count, count, count, &gridValues[0], count, count * count, workspace, cache);
+				freeWorkspace (workspace);
+
+				pipe->cleanCache (cache);
+				const PipelineElement3D *root = pipe->getElement (mRoot);
+				Real maxError = 0;
+				for (index=0;index<total;++index)
+				{
+					const Real expected = root->getValue (px[index], py[index], pz[index], cache);
+					for (int pass=0;pass<2;++pass)
+					{
+						const Real value = pass ? gridValues[index] : values[index];
+						// NaN on both sides counts as equal, on one side as infinitely wrong
+						if (value == expected || (value != value && expected != expected))
+							continue;
+						const Real error = (value == value && expected == expected) ? std::fabs (value - expected) : std::numeric_limits<Real>::infinity();
+						if (error > maxError)
+							maxError = error;
+					}
+				}
+				pipe->freeCache (cache);
+				return maxError;
+			}
+	};
+};
+
+#endif
@@ -0,0 +1,132 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef NOISEPP_PIPELINESCHEDULE_H
+#define NOISEPP_PIPELINESCHEDULE_H
+
+#include "NoisePipeline.h"
+
+namespace noisepp
+{
+	/** Explicit evaluation order for a 3D pipeline element and everything it depends on.
+		The element DAG below the root is sorted topologically once. Evaluating a position then
+		runs every element exactly once, in that order, storing the results into a slot array
+		indexed by element ID. Elements read their sources from the slots, so shared elements
+		are neither evaluated twice nor looked up in the cache.
+		Elements which don't list their sources (see PipelineElement3D::getSourceElements())
+		are evaluated through getValue() and use the cache for their own sources as before.
+	*/
+	class PipelineSchedule3D
+	{
+		private:
+			struct Step
+			{
+				const PipelineElement3D *element;
+				ElementID slot;
+			};
+			std::vector<Step> mSteps;
+			ElementID mRoot;
+			size_t mSlotCount;
+
+			void visit (const Pipeline3D *pipe, ElementID id, std::vector<char> &visited)
+			{
+				if (visited[id])
+					return;
+				visited[id] = 1;
+				const PipelineElement3D *element = pipe->getElement (id);
+				std::vector<ElementID> sources;
+				element->getSourceElements (sources);
+				for (size_t i=0;i<sources.size();++i)
+				{
+					visit (pipe, sources[i], visited);
+				}
+				Step step;
+				step.element = element;
+				step.slot = id;
+				mSteps.push_back (step);
+			}
+
+		public:
+			/// Constructor.
+			/// @param pipe The pipeline, all modules have to be added already.
+			/// @param root The element to evaluate.
+			PipelineSchedule3D (const Pipeline3D *pipe, ElementID root) : mRoot(root), mSlotCount(pipe->getElementCount())
+			{
+				NoiseAssertRange (root, mSlotCount);
+				std::vector<char> visited(mSlotCount, 0);
+				visit (pipe, root, visited);
+			}
+			/// Returns the number of slots the slot array passed to getValue() needs.
+			size_t getSlotCount () const
+			{
+				return mSlotCount;
+			}
+			/// Returns the number of elements evaluated per position.
+			size_t getStepCount () const
+			{
+				return mSteps.size ();
+			}
+			/// Returns the element evaluated at the specified step.
+			const PipelineElement3D *getStepElement (size_t i) const
+			{
+				NoiseAssertRange (i, mSteps.size());
+				return mSteps[i].element;
+			}
+			/// Returns the slot (element ID) written at the specified step.
+			ElementID getStepSlot (size_t i) const
+			{
+				NoiseAssertRange (i, mSteps.size());
+				return mSteps[i].slot;
+			}
+			/// Returns the root element ID.
+			ElementID getRoot () const
+			{
+				return mRoot;
+			}
+			/// Returns the value of the root element at the specified position.
+			/// @param slots Array of getSlotCount() values, one per thread.
+			/// @param cache Cache of the pipeline for elements evaluated through getValue(), one per thread.
+			NOISEPP_INLINE Real getValue (Real x, Real y, Real z, Real *slots, Cache *cache) const
+			{
+				const Step *step = &mSteps[0];
+				const Step *end = step + mSteps.size();
+				for (;step!=end;++step)
+				{
+					slots[step->slot] = step->element->getScheduledValue (x, y, z, slots, cache);
+				}
+				return slots[mRoot];
+			}
+			/// Evaluates count positions given as coordinate arrays into out.
+			void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Real *slots, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = getValue (x[i], y[i], z[i], slots, cache);
+				}
+			}
+	};
+};
+
+#endif
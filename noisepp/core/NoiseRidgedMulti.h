@@ -196,6 +196,13 @@ namespace noisepp
 
 				return (value * Real(1.25)) - Real(1.0);
 			}
+			virtual void getValues (const Real *x, const Real *y, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = RidgedMultiElement2D::getValue (x[i], y[i], cache);
+				}
+			}
 	};
 
 	class RidgedMultiElement3D : public PipelineElement3D
@@ -280,6 +287,44 @@ namespace noisepp
 
 				return (value * Real(1.25)) - Real(1.0);
 			}
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				for (size_t i=0;i<count;++i)
+				{
+					out[i] = RidgedMultiElement3D::getValue (x[i], y[i], z[i], cache);
+				}
+			}
+			virtual void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real *out, Cache *cache) const
+			{
+				const size_t total = countX * countY * countZ;
+				std::vector<Real> signals(total);
+				GridGenerator3D generator;
+				std::vector<Real> weights(total, Real(1.0));
+				std::fill (out, out + total, Real(0.0));
+				for (size_t o=0;o<mOctaveCount;++o)
+				{
+					generator.setGrid (x, y, z, spacing, countX, countY, countZ, mOctaves[o].scale, mQuality);
+					generator.calcGradientCoherentNoise (mOctaves[o].seed, mScale, &signals[0]);
+					for (size_t i=0;i<total;++i)
+					{
+						Real signal = mOffset - std::fabs(signals[i]);
+						signal *= signal;
+						signal *= weights[i];
+						Real weight = signal * mGain;
+						if (weight > Real(1.0))
+							weight = Real(1.0);
+						if (weight < Real(-1.0))
+							weight = Real(-1.0);
+						weights[i] = weight;
+
+						out[i] += signal * mOctaves[o].spectralWeight;
+					}
+				}
+				for (size_t i=0;i<total;++i)
+				{
+					out[i] = (out[i] * Real(1.25)) - Real(1.0);
+				}
+			}
 	};
 
 	/** Module for generating ridged-multifractal noise.
@@ -89,6 +89,21 @@ namespace noisepp
 				value = getElementValue (mElementPtr, mElement, x, y, z, cache);
 				return value * mScale + mBias;
 			}
+			virtual void getSourceElements (std::vector<ElementID> &sources) const
+			{
+				sources.push_back (mElement);
+			}
+			virtual Real getScheduledValue (Real x, Real y, Real z, const Real *slots, Cache *cache) const
+			{
+				return slots[mElement] * mScale + mBias;
+			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_SCALEBIAS;
+				op.sources[0] = mElement;
+				op.params[0] = mScale;
+				op.params[1] = mBias;
+			}
 	};
 
 	/** Module for scaling with bias.
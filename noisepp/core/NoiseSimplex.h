@@ -0,0 +1,351 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef NOISEPP_SIMPLEX_H
+#define NOISEPP_SIMPLEX_H
+
+#include "NoisePrerequisites.h"
+#include "NoiseModule.h"
+#include "NoiseGenerator.h"
+#include "NoisePipeline.h"
+#include "NoisePerlin.h"
+#include "NoiseRidgedMulti.h"
+
+namespace noisepp
+{
+	/// Scales the sum of the simplex corner contributions to [-1, 1].
+	const Real SIMPLEX_NOISE_SCALE = 108.0;
+
+	/** 3D simplex noise.
+		The position is skewed onto a lattice of tetrahedra, and only the 4 corners of the
+		tetrahedron containing it contribute, against 8 cube corners for gradient noise.
+		The code has no branches, so loops over many positions can be vectorized.
+	*/
+	class SimplexGenerator3D
+	{
+		private:
+			static NOISEPP_INLINE int floorInt (Real v)
+			{
+				const int i = (int)v;
+				return i - (v < Real(i));
+			}
+			static NOISEPP_INLINE Real calcCorner (Real x, Real y, Real z, int ix, int iy, int iz, int seed)
+			{
+				int vIndex = (NOISE_X_FACTOR * ix + NOISE_Y_FACTOR * iy + NOISE_Z_FACTOR * iz + NOISE_SEED_FACTOR * seed) & 0xffffffff;
+				vIndex ^= (vIndex >> NOISE_SHIFT);
+				vIndex &= 0xff;
+
+				Real t = Real(0.5) - x * x - y * y - z * z;
+				t = t > Real(0.0) ? t : Real(0.0);
+				t *= t;
+				return t * t * (randomVectors3D[(vIndex<<2)] * x + randomVectors3D[(vIndex<<2)+1] * y + randomVectors3D[(vIndex<<2)+2] * z);
+			}
+		public:
+			/// Returns the noise at the specified position, about [-1, 1].
+			static NOISEPP_INLINE Real calcNoise (Real x, Real y, Real z, int seed)
+			{
+				const Real F3 = Real(1.0 / 3.0);
+				const Real G3 = Real(1.0 / 6.0);
+
+				const Real s = (x + y + z) * F3;
+				const int i = floorInt (x + s);
+				const int j = floorInt (y + s);
+				const int k = floorInt (z + s);
+				const Real t = Real(i + j + k) * G3;
+				const Real x0 = x - (Real(i) - t);
+				const Real y0 = y - (Real(j) - t);
+				const Real z0 = z - (Real(k) - t);
+
+				// corner order from the ranking of x0, y0 and z0
+				const int xGy = x0 >= y0;
+				const int yGz = y0 >= z0;
+				const int xGz = x0 >= z0;
+				const int i1 = xGy & xGz;
+				const int j1 = (1 - xGy) & yGz;
+				const int k1 = (1 - xGz) & (1 - yGz);
+				const int i2 = xGy | xGz;
+				const int j2 = (1 - xGy) | yGz;
+				const int k2 = (1 - xGz) | (1 - yGz);
+
+				Real n = calcCorner (x0, y0, z0, i, j, k, seed);
+				n += calcCorner (x0 - Real(i1) + G3, y0 - Real(j1) + G3, z0 - Real(k1) + G3, i + i1, j + j1, k + k1, seed);
+				n += calcCorner (x0 - Real(i2) + Real(2.0) * G3, y0 - Real(j2) + Real(2.0) * G3, z0 - Real(k2) + Real(2.0) * G3, i + i2, j + j2, k + k2, seed);
+				n += calcCorner (x0 - Real(1.0) + Real(3.0) * G3, y0 - Real(1.0) + Real(3.0) * G3, z0 - Real(1.0) + Real(3.0) * G3, i + 1, j + 1, k + 1, seed);
+				return n * SIMPLEX_NOISE_SCALE;
+			}
+	};
+
+	template <class PipelineElement>
+	class SimplexElement : public PipelineElement
+	{
+		private:
+			struct Octave
+			{
+				int seed;
+				Real scale;
+				Real persistence;
+			};
+			std::vector<Octave> mOctaves;
+			Real mScale;
+
+			NOISEPP_INLINE Real calculate (Real x, Real y, Real z) const
+			{
+				Real value = 0.0;
+				for (size_t o=0;o<mOctaves.size();++o)
+				{
+					const Real nx = Math::MakeInt32Range (x * mOctaves[o].scale);
+					const Real ny = Math::MakeInt32Range (y * mOctaves[o].scale);
+					const Real nz = Math::MakeInt32Range (z * mOctaves[o].scale);
+					const Real signal = SimplexGenerator3D::calcNoise (nx, ny, nz, mOctaves[o].seed) * mScale;
+
+					value += signal * mOctaves[o].persistence;
+				}
+				return value;
+			}
+		public:
+			SimplexElement (size_t octaves, Real frequency, Real lacunarity, Real persistence, int mainSeed, Real nscale) : mOctaves(octaves), mScale(nscale)
+			{
+				Real curPersistence = 1.0;
+				Real scale = frequency;
+				for (size_t o=0;o<octaves;++o)
+				{
+					mOctaves[o].persistence = curPersistence;
+					mOctaves[o].scale = scale;
+					mOctaves[o].seed = (mainSeed + int(o)) & 0xffffffff;
+
+					scale *= lacunarity;
+					curPersistence *= persistence;
+				}
+			}
+			virtual Real getValue (Real x, Cache *cache) const
+			{
+				return calculate (x, 0, 0);
+			}
+			virtual Real getValue (Real x, Real y, Cache *cache) const
+			{
+				return calculate (x, y, 0);
+			}
+			virtual Real getValue (Real x, Real y, Real z, Cache *cache) const
+			{
+				return calculate (x, y, z);
+			}
+			/// Octave by octave, so the loop over the positions can be vectorized.
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				std::fill (out, out + count, Real(0.0));
+				for (size_t o=0;o<mOctaves.size();++o)
+				{
+					const Octave octave = mOctaves[o];
+					for (size_t i=0;i<count;++i)
+					{
+						const Real nx = Math::MakeInt32Range (x[i] * octave.scale);
+						const Real ny = Math::MakeInt32Range (y[i] * octave.scale);
+						const Real nz = Math::MakeInt32Range (z[i] * octave.scale);
+						const Real signal = SimplexGenerator3D::calcNoise (nx, ny, nz, octave.seed) * mScale;
+
+						out[i] += signal * octave.persistence;
+					}
+				}
+			}
+	};
+
+	typedef SimplexElement<PipelineElement1D> SimplexElement1D;
+	typedef SimplexElement<PipelineElement2D> SimplexElement2D;
+	typedef SimplexElement<PipelineElement3D> SimplexElement3D;
+
+	template <class PipelineElement>
+	class RidgedSimplexElement : public PipelineElement
+	{
+		private:
+			struct Octave
+			{
+				int seed;
+				Real scale;
+				Real spectralWeight;
+			};
+			std::vector<Octave> mOctaves;
+			Real mOffset;
+			Real mGain;
+			Real mScale;
+
+			NOISEPP_INLINE Real calculate (Real x, Real y, Real z) const
+			{
+				Real value = 0.0;
+				Real weight = 1.0;
+				for (size_t o=0;o<mOctaves.size();++o)
+				{
+					const Real nx = Math::MakeInt32Range (x * mOctaves[o].scale);
+					const Real ny = Math::MakeInt32Range (y * mOctaves[o].scale);
+					const Real nz = Math::MakeInt32Range (z * mOctaves[o].scale);
+					Real signal = SimplexGenerator3D::calcNoise (nx, ny, nz, mOctaves[o].seed) * mScale;
+					signal = mOffset - std::fabs(signal);
+					signal *= signal;
+					signal *= weight;
+					weight = signal * mGain;
+					if (weight > Real(1.0))
+						weight = Real(1.0);
+					if (weight < Real(-1.0))
+						weight = Real(-1.0);
+
+					value += signal * mOctaves[o].spectralWeight;
+				}
+				return (value * Real(1.25)) - Real(1.0);
+			}
+		public:
+			RidgedSimplexElement (size_t octaves, Real frequency, Real lacunarity, Real exponent, Real offset, Real gain, int mainSeed, Real nscale) : mOctaves(octaves), mOffset(offset), mGain(gain), mScale(nscale)
+			{
+				Real scale = frequency;
+				Real sw_freq = 1.0;
+				for (size_t o=0;o<octaves;++o)
+				{
+					mOctaves[o].spectralWeight = pow(sw_freq, -exponent);
+					mOctaves[o].scale = scale;
+					mOctaves[o].seed = (mainSeed + int(o)) & 0x7fffffff;
+
+					scale *= lacunarity;
+					sw_freq *= lacunarity;
+				}
+			}
+			virtual Real getValue (Real x, Cache *cache) const
+			{
+				return calculate (x, 0, 0);
+			}
+			virtual Real getValue (Real x, Real y, Cache *cache) const
+			{
+				return calculate (x, y, 0);
+			}
+			virtual Real getValue (Real x, Real y, Real z, Cache *cache) const
+			{
+				return calculate (x, y, z);
+			}
+			/// Octave by octave, so the loop over the positions can be vectorized.
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				const size_t BATCH = 64;
+				Real weights[BATCH];
+				for (size_t start=0;start<count;start+=BATCH)
+				{
+					const size_t n = (count - start) < BATCH ? (count - start) : BATCH;
+					Real *values = out + start;
+					std::fill (values, values + n, Real(0.0));
+					std::fill (weights, weights + n, Real(1.0));
+					for (size_t o=0;o<mOctaves.size();++o)
+					{
+						const Octave octave = mOctaves[o];
+						for (size_t i=0;i<n;++i)
+						{
+							const Real nx = Math::MakeInt32Range (x[start + i] * octave.scale);
+							const Real ny = Math::MakeInt32Range (y[start + i] * octave.scale);
+							const Real nz = Math::MakeInt32Range (z[start + i] * octave.scale);
+							Real signal = SimplexGenerator3D::calcNoise (nx, ny, nz, octave.seed) * mScale;
+							signal = mOffset - std::fabs(signal);
+							signal *= signal;
+							signal *= weights[i];
+							Real weight = signal * mGain;
+							weight = weight > Real(1.0) ? Real(1.0) : weight;
+							weight = weight < Real(-1.0) ? Real(-1.0) : weight;
+							weights[i] = weight;
+
+							values[i] += signal * octave.spectralWeight;
+						}
+					}
+					for (size_t i=0;i<n;++i)
+					{
+						values[i] = (values[i] * Real(1.25)) - Real(1.0);
+					}
+				}
+			}
+	};
+
+	typedef RidgedSimplexElement<PipelineElement1D> RidgedSimplexElement1D;
+	typedef RidgedSimplexElement<PipelineElement2D> RidgedSimplexElement2D;
+	typedef RidgedSimplexElement<PipelineElement3D> RidgedSimplexElement3D;
+
+	/** Module for generating simplex noise.
+		Generates a fractal sum of simplex noise octaves like the perlin module does with gradient noise; an octave count of 1 gives plain simplex noise.
+		The noise quality setting has no effect and the scale factor defaults to 1.
+		1D and 2D pipelines get the slices at y = 0 and z = 0.
+	*/
+	class SimplexModule : public PerlinModuleBase
+	{
+		public:
+			/// Constructor.
+			SimplexModule ()
+			{
+				mScale = 1.0;
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline1D *pipe) const
+			{
+				return pipe->addElement (this, new SimplexElement1D(mOctaveCount, mFrequency, mLacunarity, mPersistence, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline2D *pipe) const
+			{
+				return pipe->addElement (this, new SimplexElement2D(mOctaveCount, mFrequency, mLacunarity, mPersistence, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline3D *pipe) const
+			{
+				return pipe->addElement (this, new SimplexElement3D(mOctaveCount, mFrequency, mLacunarity, mPersistence, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::getType()
+			ModuleTypeId getType() const { return MODULE_SIMPLEX; }
+	};
+
+	/** Module for generating ridged-multifractal simplex noise.
+		The ridged-multifractal module on simplex noise instead of gradient noise.
+		The noise quality setting has no effect and the scale factor defaults to 1.
+		1D and 2D pipelines get the slices at y = 0 and z = 0.
+	*/
+	class RidgedSimplexModule : public RidgedMultiModule
+	{
+		public:
+			/// Constructor.
+			RidgedSimplexModule ()
+			{
+				mScale = 1.0;
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline1D *pipe) const
+			{
+				return pipe->addElement (this, new RidgedSimplexElement1D(mOctaveCount, mFrequency, mLacunarity, mExponent, mOffset, mGain, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline2D *pipe) const
+			{
+				return pipe->addElement (this, new RidgedSimplexElement2D(mOctaveCount, mFrequency, mLacunarity, mExponent, mOffset, mGain, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::addToPipeline()
+			ElementID addToPipeline (Pipeline3D *pipe) const
+			{
+				return pipe->addElement (this, new RidgedSimplexElement3D(mOctaveCount, mFrequency, mLacunarity, mExponent, mOffset, mGain, mSeed+pipe->getSeed(), mScale));
+			}
+			/// @copydoc noisepp::Module::getType()
+			ModuleTypeId getType() const { return MODULE_RIDGEDSIMPLEX; }
+	};
+};
+
+#endif
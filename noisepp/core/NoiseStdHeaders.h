@@ -36,6 +36,8 @@
 #include <vector>
 #include <algorithm>
 #include <memory>
+#include <functional>
+#include <exception>
 #include <map>
 #include <queue>
 #include <stdexcept>
@@ -0,0 +1,415 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#ifndef NOISEPP_THREADPOOL_H
+#define NOISEPP_THREADPOOL_H
+
+#include "NoisePrerequisites.h"
+
+#if NOISEPP_ENABLE_THREADS == 0
+#error To use this classes please set NOISEPP_ENABLE_THREADS to 1
+#endif
+
+namespace noisepp
+{
+	class ThreadPool;
+
+	/// Names for task priorities. Any int can be used, tasks with higher priorities run first.
+	enum TaskPriority
+	{
+		TASK_PRIORITY_LOW = -1,
+		TASK_PRIORITY_NORMAL = 0,
+		TASK_PRIORITY_HIGH = 1
+	};
+
+	/// Settings for creating a ThreadPool.
+	struct ThreadPoolConfig
+	{
+		/// The number of worker threads.
+		size_t numberOfThreads;
+		/// Worker threads are named after this, followed by their index. Leave empty to keep the default names.
+		std::string name;
+		/// CPUs the worker threads may run on, bit 0 being the first CPU. 0 leaves them unrestricted.
+		unsigned long long affinityMask;
+		/// Constructor.
+		ThreadPoolConfig (size_t threads=1) : numberOfThreads(threads), affinityMask(0) {}
+	};
+
+	/// State of a task shared between the thread pool and its handles. Use TaskHandle to access it.
+	class TaskState
+	{
+		friend class ThreadPool;
+		friend class TaskHandle;
+		private:
+			enum Status
+			{
+				/// Waiting for its predecessor, see TaskHandle::then().
+				STATUS_WAITING,
+				STATUS_QUEUED,
+				STATUS_RUNNING,
+				STATUS_DONE,
+				STATUS_CANCELLED
+			};
+
+			ThreadPool *mPool;
+			std::function<void ()> mFunction;
+			int mPriority;
+			Status mStatus;
+			std::exception_ptr mException;
+			std::vector<std::shared_ptr<TaskState> > mContinuations;
+
+		public:
+			TaskState (ThreadPool *pool, const std::function<void ()> &function, int priority) :
+				mPool(pool), mFunction(function), mPriority(priority), mStatus(STATUS_WAITING)
+			{
+			}
+	};
+
+	/** Handle of a task submitted to a ThreadPool.
+		Handles are cheap to copy, all copies refer to the same task.
+		They must not be used anymore once the pool is destroyed.
+	*/
+	class TaskHandle
+	{
+		private:
+			std::shared_ptr<TaskState> mState;
+
+		public:
+			/// Creates an invalid handle.
+			TaskHandle ()
+			{
+			}
+			/// Constructor.
+			explicit TaskHandle (const std::shared_ptr<TaskState> &state) : mState(state)
+			{
+			}
+			/// Returns if the handle refers to a task.
+			bool isValid () const
+			{
+				return mState.get() != NULL;
+			}
+			/// Returns if the task has run or was cancelled.
+			inline bool isDone () const;
+			/// Returns if the task was cancelled before it ran.
+			inline bool isCancelled () const;
+			/// Cancels the task and its continuations if it has not started yet.
+			/// @return True if the task will not run.
+			inline bool cancel ();
+			/// Waits until the task has run or was cancelled.
+			/// The calling thread runs the task itself if it is still queued, and queued tasks of at least
+			/// its priority meanwhile, so waiting from inside a task is fine. Lower priority tasks are
+			/// left to the workers, they could keep the caller busy long after the task is done.
+			/// If the task threw an exception it is thrown again here.
+			inline void wait ();
+			/// Adds a task which is queued when this one has run.
+			/// It is cancelled if this task is cancelled or throws.
+			inline TaskHandle then (const std::function<void ()> &function, int priority=TASK_PRIORITY_NORMAL);
+	};
+
+	/** Pool of worker threads running tasks by priority.
+		Tasks of the same priority run in submission order. Everything which can run in parallel
+		should go to one pool, so the number of busy threads matches the number of cores instead
+		of adding up over independent thread groups.
+	*/
+	class ThreadPool
+	{
+		friend class TaskHandle;
+		private:
+			struct QueueEntry
+			{
+				int priority;
+				unsigned long long sequence;
+				std::shared_ptr<TaskState> task;
+
+				bool operator< (const QueueEntry &other) const
+				{
+					if (priority != other.priority)
+						return priority < other.priority;
+					return sequence > other.sequence;
+				}
+			};
+
+			threadpp::ThreadGroup mThreads;
+			threadpp::Mutex mMutex;
+			threadpp::Condition mQueueCond, mDoneCond;
+			std::priority_queue<QueueEntry> mQueue;
+			unsigned long long mSequence;
+			size_t mThreadCount;
+			bool mShutdown;
+
+			/// Expects mMutex to be locked.
+			void enqueue (const std::shared_ptr<TaskState> &task)
+			{
+				task->mStatus = TaskState::STATUS_QUEUED;
+				QueueEntry entry;
+				entry.priority = task->mPriority;
+				entry.sequence = mSequence++;
+				entry.task = task;
+				mQueue.push (entry);
+				mQueueCond.notifyOne ();
+			}
+			/// Expects mMutex to be locked.
+			void cancelTask (const std::shared_ptr<TaskState> &task)
+			{
+				task->mStatus = TaskState::STATUS_CANCELLED;
+				task->mFunction = std::function<void ()>();
+				for (size_t i=0;i<task->mContinuations.size();++i)
+				{
+					cancelTask (task->mContinuations[i]);
+				}
+				task->mContinuations.clear ();
+			}
+			/// Pops the next task which was not cancelled meanwhile. Expects mMutex to be locked.
+			std::shared_ptr<TaskState> popTask ()
+			{
+				while (!mQueue.empty())
+				{
+					std::shared_ptr<TaskState> task = mQueue.top().task;
+					mQueue.pop ();
+					if (task->mStatus == TaskState::STATUS_QUEUED)
+						return task;
+				}
+				return std::shared_ptr<TaskState>();
+			}
+			/// Pops the next task if its priority is at least minPriority. Expects mMutex to be locked.
+			std::shared_ptr<TaskState> popTask (int minPriority)
+			{
+				while (!mQueue.empty() && mQueue.top().task->mStatus != TaskState::STATUS_QUEUED)
+					mQueue.pop ();
+				if (mQueue.empty() || mQueue.top().priority < minPriority)
+					return std::shared_ptr<TaskState>();
+				return popTask ();
+			}
+			/// Runs the task with mMutex unlocked. Expects lk to be locked.
+			void runTask (const std::shared_ptr<TaskState> &task, threadpp::Mutex::Lock &lk)
+			{
+				task->mStatus = TaskState::STATUS_RUNNING;
+				std::function<void ()> function;
+				function.swap (task->mFunction);
+				lk.unlock ();
+				std::exception_ptr exception;
+				try
+				{
+					function ();
+				}
+				catch (...)
+				{
+					exception = std::current_exception ();
+				}
+				function = std::function<void ()>();
+				lk.lock ();
+				task->mException = exception;
+				task->mStatus = TaskState::STATUS_DONE;
+				for (size_t i=0;i<task->mContinuations.size();++i)
+				{
+					if (exception)
+						cancelTask (task->mContinuations[i]);
+					else
+						enqueue (task->mContinuations[i]);
+				}
+				task->mContinuations.clear ();
+				mDoneCond.notifyAll ();
+			}
+			void threadFunction ()
+			{
+				threadpp::Mutex::Lock lk(mMutex);
+				while (!mShutdown)
+				{
+					std::shared_ptr<TaskState> task = popTask ();
+					if (task)
+						runTask (task, lk);
+					else
+						mQueueCond.wait (lk);
+				}
+			}
+			static void *threadEntry (void *pool)
+			{
+				(static_cast<ThreadPool*>(pool))->threadFunction ();
+				return NULL;
+			}
+			static bool isFinished (const TaskState &task)
+			{
+				return task.mStatus == TaskState::STATUS_DONE || task.mStatus == TaskState::STATUS_CANCELLED;
+			}
+			void createThreads (const ThreadPoolConfig &config)
+			{
+				NoiseAssert (config.numberOfThreads > 0, numberOfThreads);
+				for (size_t i=0;i<config.numberOfThreads;++i)
+				{
+					mThreads.createThread (threadEntry, this);
+					threadpp::Thread &thread = mThreads.getThread (i);
+					if (!config.name.empty())
+					{
+						std::string digits;
+						size_t index = i;
+						do
+						{
+							digits.insert (digits.begin(), char('0' + index % 10));
+							index /= 10;
+						} while (index);
+						thread.setName ((config.name + ' ' + digits).c_str());
+					}
+					if (config.affinityMask)
+						thread.setAffinity (config.affinityMask);
+				}
+			}
+
+		public:
+			/// Constructor.
+			/// @param numberOfThreads The number of worker threads
+			ThreadPool (size_t numberOfThreads) : mSequence(0), mThreadCount(numberOfThreads), mShutdown(false)
+			{
+				createThreads (ThreadPoolConfig(numberOfThreads));
+			}
+			/// Constructor.
+			/// @param config Number, names and CPU affinity of the worker threads
+			ThreadPool (const ThreadPoolConfig &config) : mSequence(0), mThreadCount(config.numberOfThreads), mShutdown(false)
+			{
+				createThreads (config);
+			}
+			/// Destructor. Cancels the tasks which have not started and waits for the running ones.
+			~ThreadPool ()
+			{
+				{
+					threadpp::Mutex::Lock lk(mMutex);
+					mShutdown = true;
+					while (!mQueue.empty())
+					{
+						if (mQueue.top().task->mStatus == TaskState::STATUS_QUEUED)
+							cancelTask (mQueue.top().task);
+						mQueue.pop ();
+					}
+					mQueueCond.notifyAll ();
+					mDoneCond.notifyAll ();
+				}
+				mThreads.join ();
+			}
+			/// Queues a function.
+			/// @param function The function, called on one of the worker threads or on a thread waiting for a task.
+			/// @param priority Tasks with higher priority run first.
+			TaskHandle submit (const std::function<void ()> &function, int priority=TASK_PRIORITY_NORMAL)
+			{
+				std::shared_ptr<TaskState> task = std::make_shared<TaskState> (this, function, priority);
+				threadpp::Mutex::Lock lk(mMutex);
+				if (mShutdown)
+					cancelTask (task);
+				else
+					enqueue (task);
+				return TaskHandle(task);
+			}
+			/// Runs one queued task on the calling thread.
+			/// @return False if there was no task to run.
+			bool runPendingTask ()
+			{
+				threadpp::Mutex::Lock lk(mMutex);
+				std::shared_ptr<TaskState> task = popTask ();
+				if (!task)
+					return false;
+				runTask (task, lk);
+				return true;
+			}
+			/// Returns the number of worker threads.
+			size_t getThreadCount () const
+			{
+				return mThreadCount;
+			}
+			/// Returns the number of tasks waiting to run, cancelled ones may still be counted.
+			size_t getQueuedTaskCount ()
+			{
+				threadpp::Mutex::Lock lk(mMutex);
+				return mQueue.size ();
+			}
+	};
+
+	inline bool TaskHandle::isDone () const
+	{
+		NoiseAssert (mState.get() != NULL, mState);
+		threadpp::Mutex::Lock lk(mState->mPool->mMutex);
+		return ThreadPool::isFinished (*mState);
+	}
+
+	inline bool TaskHandle::isCancelled () const
+	{
+		NoiseAssert (mState.get() != NULL, mState);
+		threadpp::Mutex::Lock lk(mState->mPool->mMutex);
+		return mState->mStatus == TaskState::STATUS_CANCELLED;
+	}
+
+	inline bool TaskHandle::cancel ()
+	{
+		NoiseAssert (mState.get() != NULL, mState);
+		ThreadPool *pool = mState->mPool;
+		threadpp::Mutex::Lock lk(pool->mMutex);
+		if (mState->mStatus == TaskState::STATUS_WAITING || mState->mStatus == TaskState::STATUS_QUEUED)
+		{
+			pool->cancelTask (mState);
+			pool->mDoneCond.notifyAll ();
+		}
+		return mState->mStatus == TaskState::STATUS_CANCELLED;
+	}
+
+	inline void TaskHandle::wait ()
+	{
+		NoiseAssert (mState.get() != NULL, mState);
+		ThreadPool *pool = mState->mPool;
+		threadpp::Mutex::Lock lk(pool->mMutex);
+		while (!ThreadPool::isFinished (*mState))
+		{
+			// its queue entry is skipped once it is running
+			if (mState->mStatus == TaskState::STATUS_QUEUED)
+			{
+				pool->runTask (mState, lk);
+				continue;
+			}
+			std::shared_ptr<TaskState> task = pool->popTask (mState->mPriority);
+			if (task)
+				pool->runTask (task, lk);
+			else
+				pool->mDoneCond.wait (lk);
+		}
+		if (mState->mException)
+		{
+			std::exception_ptr exception = mState->mException;
+			lk.unlock ();
+			std::rethrow_exception (exception);
+		}
+	}
+
+	inline TaskHandle TaskHandle::then (const std::function<void ()> &function, int priority)
+	{
+		NoiseAssert (mState.get() != NULL, mState);
+		ThreadPool *pool = mState->mPool;
+		std::shared_ptr<TaskState> task = std::make_shared<TaskState> (pool, function, priority);
+		threadpp::Mutex::Lock lk(pool->mMutex);
+		if (mState->mStatus == TaskState::STATUS_CANCELLED || (mState->mStatus == TaskState::STATUS_DONE && mState->mException) || pool->mShutdown)
+			pool->cancelTask (task);
+		else if (mState->mStatus == TaskState::STATUS_DONE)
+			pool->enqueue (task);
+		else
+			mState->mContinuations.push_back (task);
+		return TaskHandle(task);
+	}
+};
+
+#endif // NOISEPP_THREADPOOL_H
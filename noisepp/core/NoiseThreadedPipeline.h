@@ -27,6 +27,7 @@
 #define NOISEPP_THREADEDPIPELINE_H
 
 #include "NoisePipeline.h"
+#include "NoiseThreadPool.h"
 
 #if NOISEPP_ENABLE_THREADS == 0
 #error To use this classes please set NOISEPP_ENABLE_THREADS to 1
@@ -46,93 +47,124 @@ namespace noisepp
 	class ThreadedPipeline : public Pipeline<Element>
 	{
 		private:
-			threadpp::ThreadGroup mThreads;
+			ThreadPool *mPool;
+			bool mOwnsPool;
+			int mPriority;
 			threadpp::Mutex mMutex;
-			threadpp::Condition mCond, mMainCond;
 
-			bool mThreadsDone;
-			unsigned mWorkingThreads;
+			/// Caches not in use by a job during executeJobs().
+			std::vector<Cache*> mCaches;
 			PipelineJobQueue mJobsDone;
-			void threadFunction ()
+
+			void runJob (PipelineJob *job)
 			{
 				Cache *cache = NULL;
-				threadpp::Mutex::Lock lk(mMutex);
-				while (!mThreadsDone)
 				{
-					if (Pipeline<Element>::mJobs.empty())
-						mCond.wait(lk);
-					if (!Pipeline<Element>::mJobs.empty())
+					threadpp::Mutex::Lock lk(mMutex);
+					if (!mCaches.empty())
 					{
-						PipelineJob *job = Pipeline<Element>::mJobs.front ();
-						Pipeline<Element>::mJobs.pop ();
-						++mWorkingThreads;
-						lk.unlock ();
-						if (!cache)
-							cache = Pipeline<Element>::createCache();
-						job->execute(cache);
-						lk.lock ();
-						--mWorkingThreads;
-						mJobsDone.push (job);
-						mMainCond.notifyOne ();
+						cache = mCaches.back ();
+						mCaches.pop_back ();
 					}
 				}
-				lk.unlock ();
-				if (cache)
+				if (!cache)
+					cache = Pipeline<Element>::createCache();
+				try
+				{
+					job->execute(cache);
+				}
+				catch (...)
 				{
-					Pipeline<Element>::freeCache (cache);
+					// a failed job is not finished, only deleted
+					delete job;
+					threadpp::Mutex::Lock lk(mMutex);
+					mCaches.push_back (cache);
+					throw;
 				}
+				threadpp::Mutex::Lock lk(mMutex);
+				mCaches.push_back (cache);
+				mJobsDone.push (job);
 			}
-			static void *threadEntry (void *pipe)
+			void finishJobs ()
 			{
-				(static_cast<ThreadedPipeline<Element>*>(pipe))->threadFunction ();
-				return NULL;
+				threadpp::Mutex::Lock lk(mMutex);
+				while (!mJobsDone.empty())
+				{
+					PipelineJob *job = mJobsDone.front ();
+					mJobsDone.pop ();
+					lk.unlock ();
+					job->finish ();
+					delete job;
+					lk.lock ();
+				}
 			}
 
 		public:
-			/// Constructor.
+			/// Constructor. Creates a thread pool used by this pipeline only.
 			/// @param numberOfThreads The number of threads
-			ThreadedPipeline (size_t numberOfThreads) : mThreadsDone(false), mWorkingThreads(0)
+			ThreadedPipeline (size_t numberOfThreads) : mPool(new ThreadPool(numberOfThreads)), mOwnsPool(true), mPriority(TASK_PRIORITY_NORMAL)
 			{
-				NoiseAssert (numberOfThreads > 0, numberOfThreads);
-				for (size_t i=0;i<numberOfThreads;++i)
-				{
-					mThreads.createThread (threadEntry, this);
-				}
+			}
+			/// Constructor. Runs the jobs in a shared thread pool.
+			/// @param pool The thread pool, has to outlive the pipeline
+			ThreadedPipeline (ThreadPool &pool) : mPool(&pool), mOwnsPool(false), mPriority(TASK_PRIORITY_NORMAL)
+			{
+			}
+			/// Sets the priority the jobs are submitted to the thread pool with.
+			void setPriority (int priority)
+			{
+				mPriority = priority;
+			}
+			/// Returns the priority the jobs are submitted to the thread pool with.
+			int getPriority () const
+			{
+				return mPriority;
+			}
+			/// Returns the thread pool running the jobs.
+			ThreadPool &getThreadPool () const
+			{
+				return *mPool;
 			}
 			/// executes the jobs in queue
+			/// The calling thread helps running them, so this can be called from a task of the same pool.
 			/// WARNING: Don't change the pipeline after calling this function
 			virtual void executeJobs ()
 			{
-				mCond.notifyAll();
-				threadpp::Mutex::Lock lk(mMutex);
-				while (!Pipeline<Element>::mJobs.empty() || mWorkingThreads > 0)
+				std::vector<TaskHandle> tasks;
+				tasks.reserve (Pipeline<Element>::mJobs.size());
+				while (!Pipeline<Element>::mJobs.empty())
+				{
+					PipelineJob *job = Pipeline<Element>::mJobs.front ();
+					Pipeline<Element>::mJobs.pop ();
+					tasks.push_back (mPool->submit (std::bind(&ThreadedPipeline<Element>::runJob, this, job), mPriority));
+				}
+				std::exception_ptr exception;
+				for (size_t i=0;i<tasks.size();++i)
 				{
-					if (!Pipeline<Element>::mJobs.empty() || mWorkingThreads > 0)
-						mMainCond.wait(lk);
-					while (!mJobsDone.empty())
+					try
 					{
-						PipelineJob *job = mJobsDone.front ();
-						mJobsDone.pop ();
-						lk.unlock ();
-						job->finish ();
-						delete job;
-						lk.lock ();
+						tasks[i].wait ();
 					}
+					catch (...)
+					{
+						if (!exception)
+							exception = std::current_exception ();
+					}
+					finishJobs ();
 				}
-			}
-			/// @copydoc noisepp::Pipeline::addJob()
-			virtual void addJob (PipelineJob *job)
-			{
-				NoiseAssert (job != NULL, job);
-				threadpp::Mutex::Lock lk(mMutex);
-				Pipeline<Element>::mJobs.push (job);
+				for (size_t i=0;i<mCaches.size();++i)
+				{
+					Pipeline<Element>::freeCache (mCaches[i]);
+				}
+				mCaches.clear ();
+				if (exception)
+					std::rethrow_exception (exception);
 			}
 			/// Destructor.
 			virtual ~ThreadedPipeline ()
 			{
-				mThreadsDone = true;
-				mCond.notifyAll();
-				mThreads.join ();
+				if (mOwnsPool)
+					delete mPool;
 			}
 	};
 
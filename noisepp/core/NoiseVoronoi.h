@@ -92,6 +92,118 @@ namespace noisepp
 			}
 	};
 
+	/** Feature points of a box of Voronoi lattice cells.
+		The points are computed once per cell and stored per axis, so every position inside the box
+		finds its nearest point with table lookups and a distance loop the compiler can vectorize,
+		instead of hashing the 125 surrounding cells again.
+	*/
+	class VoronoiCells3D
+	{
+		private:
+			int mX0, mY0, mZ0;
+			int mSizeX, mSizeY, mSizeZ;
+			std::vector<Real> mPointX, mPointY, mPointZ;
+
+		public:
+			/// Upper limit for the number of cells of a box.
+			static const size_t MAX_CELLS = 1 << 18;
+
+			/// Returns the lattice cell of a coordinate already multiplied by the frequency.
+			static NOISEPP_INLINE int getCell (Real v)
+			{
+				return (v > Real(0.0) ? (int)v : (int)v - 1);
+			}
+			/// Returns the number of cells searching the cells x0 to x1, y0 to y1 and z0 to z1 touches, or MAX_CELLS+1 if there are more.
+			static size_t getCellCount (int x0, int y0, int z0, int x1, int y1, int z1)
+			{
+				const Real count = (Real(x1) - Real(x0) + 5) * (Real(y1) - Real(y0) + 5) * (Real(z1) - Real(z0) + 5);
+				if (!(count <= Real(MAX_CELLS)))
+					return MAX_CELLS + 1;
+				return size_t(count);
+			}
+			/// Computes the feature points of the cells x0 to x1, y0 to y1 and z0 to z1 and of two more cells on every side.
+			void setCells (int x0, int y0, int z0, int x1, int y1, int z1, int seed)
+			{
+				NoiseAssert (getCellCount(x0, y0, z0, x1, y1, z1) <= MAX_CELLS, x1);
+				mX0 = x0 - 2;
+				mY0 = y0 - 2;
+				mZ0 = z0 - 2;
+				mSizeX = x1 - x0 + 5;
+				mSizeY = y1 - y0 + 5;
+				mSizeZ = z1 - z0 + 5;
+				const size_t count = size_t(mSizeX) * size_t(mSizeY) * size_t(mSizeZ);
+				mPointX.resize (count);
+				mPointY.resize (count);
+				mPointZ.resize (count);
+				size_t i = 0;
+				for (int xc=mX0;xc<mX0+mSizeX;++xc)
+				{
+					for (int yc=mY0;yc<mY0+mSizeY;++yc)
+					{
+						for (int zc=mZ0;zc<mZ0+mSizeZ;++zc,++i)
+						{
+							mPointX[i] = xc + Generator3D::calcNoise(xc, yc, zc, seed);
+							mPointY[i] = yc + Generator3D::calcNoise(xc, yc, zc, seed+1);
+							mPointZ[i] = zc + Generator3D::calcNoise(xc, yc, zc, seed+2);
+						}
+					}
+				}
+			}
+			/// Finds the feature point nearest to (x, y, z), which has to lie in one of the cells passed to setCells().
+			/// Cells are tested in the order of VoronoiElement3D::getValue() and the first of equally near points wins, so the result is the same.
+			NOISEPP_INLINE void findNearest (Real x, Real y, Real z, Real &xmin, Real &ymin, Real &zmin) const
+			{
+				const int xi = getCell (x) - 2 - mX0;
+				const int yi = getCell (y) - 2 - mY0;
+				const int zi = getCell (z) - 2 - mZ0;
+				assert (xi >= 0 && xi + 5 <= mSizeX);
+				assert (yi >= 0 && yi + 5 <= mSizeY);
+				assert (zi >= 0 && zi + 5 <= mSizeZ);
+
+				Real dist[125];
+				size_t n = 0;
+				for (int a=0;a<5;++a)
+				{
+					for (int b=0;b<5;++b)
+					{
+						const size_t cell = (size_t(xi + a) * mSizeY + size_t(yi + b)) * mSizeZ + size_t(zi);
+						const Real *px = &mPointX[cell];
+						const Real *py = &mPointY[cell];
+						const Real *pz = &mPointZ[cell];
+						for (int c=0;c<5;++c)
+						{
+							const Real xd = px[c] - x;
+							const Real yd = py[c] - y;
+							const Real zd = pz[c] - z;
+							dist[n+c] = xd * xd + yd * yd + zd * zd;
+						}
+						n += 5;
+					}
+				}
+
+				Real minDist = Real(2147483647.0);
+				size_t nearest = 125;
+				for (n=0;n<125;++n)
+				{
+					if (dist[n] < minDist)
+					{
+						minDist = dist[n];
+						nearest = n;
+					}
+				}
+
+				if (nearest == 125)
+				{
+					xmin = ymin = zmin = Real(0);
+					return;
+				}
+				const size_t cell = (size_t(xi + int(nearest / 25)) * mSizeY + size_t(yi + int(nearest / 5 % 5))) * mSizeZ + size_t(zi + int(nearest % 5));
+				xmin = mPointX[cell];
+				ymin = mPointY[cell];
+				zmin = mPointZ[cell];
+			}
+	};
+
 	class VoronoiElement3D : public PipelineElement3D
 	{
 		private:
@@ -100,6 +212,25 @@ namespace noisepp
 			Real mDisplacement;
 			bool mEnableDistance;
 
+			NOISEPP_INLINE Real getCellValue (Real x, Real y, Real z, Real xmin, Real ymin, Real zmin) const
+			{
+				Real value;
+				if (mEnableDistance)
+				{
+					const Real SQRT_THREE = 1.7320508075688772;
+					Real xDist = xmin - x;
+					Real yDist = ymin - y;
+					Real zDist = zmin - z;
+					value = (std::sqrt(xDist * xDist + yDist * yDist + zDist * zDist)) * SQRT_THREE - Real(1.0);
+				}
+				else
+				{
+					value = Real(0.0);
+				}
+
+				return value + (mDisplacement * (Real)Generator3D::calcNoise((int)floor(xmin), (int)floor(ymin), (int)floor(zmin)));
+			}
+
 		public:
 			VoronoiElement3D (Real frequency, int seed, Real displacement, bool enableDistance) : mFrequency(frequency), mSeed(seed), mDisplacement(displacement), mEnableDistance(enableDistance)
 			{
@@ -110,9 +241,9 @@ namespace noisepp
 				y *= mFrequency;
 				z *= mFrequency;
 
-				int xi = (x > Real(0.0) ? (int)x : (int)x - 1);
-				int yi = (y > Real(0.0) ? (int)y : (int)y - 1);
-				int zi = (z > Real(0.0) ? (int)z : (int)z - 1);
+				int xi = VoronoiCells3D::getCell (x);
+				int yi = VoronoiCells3D::getCell (y);
+				int zi = VoronoiCells3D::getCell (z);
 
 				Real minDist = Real(2147483647.0);
 				Real xmin = Real(0);
@@ -143,21 +274,100 @@ namespace noisepp
 					}
 				}
 
-				Real value;
-				if (mEnableDistance)
+				return getCellValue (x, y, z, xmin, ymin, zmin);
+			}
+			/// Computes the feature points of all cells the block touches once, unless the block is spread over so many cells that searching per position is cheaper.
+			virtual void getValues (const Real *x, const Real *y, const Real *z, size_t count, Real *out, Cache *cache) const
+			{
+				if (count == 0)
+					return;
+				std::vector<Real> scaled(count * 3);
+				Real *sx = &scaled[0];
+				Real *sy = sx + count;
+				Real *sz = sy + count;
+				int x0, y0, z0, x1, y1, z1;
+				for (size_t i=0;i<count;++i)
 				{
-					const Real SQRT_THREE = 1.7320508075688772;
-					Real xDist = xmin - x;
-					Real yDist = ymin - y;
-					Real zDist = zmin - z;
-					value = (std::sqrt(xDist * xDist + yDist * yDist + zDist * zDist)) * SQRT_THREE - Real(1.0);
+					sx[i] = x[i] * mFrequency;
+					sy[i] = y[i] * mFrequency;
+					sz[i] = z[i] * mFrequency;
+					const int xi = VoronoiCells3D::getCell (sx[i]);
+					const int yi = VoronoiCells3D::getCell (sy[i]);
+					const int zi = VoronoiCells3D::getCell (sz[i]);
+					if (i == 0)
+					{
+						x0 = x1 = xi;
+						y0 = y1 = yi;
+						z0 = z1 = zi;
+					}
+					else
+					{
+						if (xi < x0) x0 = xi; else if (xi > x1) x1 = xi;
+						if (yi < y0) y0 = yi; else if (yi > y1) y1 = yi;
+						if (zi < z0) z0 = zi; else if (zi > z1) z1 = zi;
+					}
 				}
-				else
+
+				const size_t cellCount = VoronoiCells3D::getCellCount (x0, y0, z0, x1, y1, z1);
+				if (cellCount > VoronoiCells3D::MAX_CELLS || cellCount > count * 125)
 				{
-					value = Real(0.0);
+					for (size_t i=0;i<count;++i)
+					{
+						out[i] = VoronoiElement3D::getValue (x[i], y[i], z[i], cache);
+					}
+					return;
 				}
 
-				return value + (mDisplacement * (Real)Generator3D::calcNoise((int)floor(xmin), (int)floor(ymin), (int)floor(zmin)));
+				VoronoiCells3D cells;
+				cells.setCells (x0, y0, z0, x1, y1, z1, mSeed);
+				for (size_t i=0;i<count;++i)
+				{
+					Real xmin, ymin, zmin;
+					cells.findNearest (sx[i], sy[i], sz[i], xmin, ymin, zmin);
+					out[i] = getCellValue (sx[i], sy[i], sz[i], xmin, ymin, zmin);
+				}
+			}
+			/// Computes the feature points of all cells the grid touches once. Grids spread over too many cells go row by row through getValues().
+			virtual void getGridValues (Real x, Real y, Real z, Real spacing, size_t countX, size_t countY, size_t countZ, Real *out, Cache *cache) const
+			{
+				if (countX == 0 || countY == 0 || countZ == 0)
+					return;
+				std::vector<Real> px(countX), py(countY), pz(countZ);
+				for (size_t i=0;i<countX;++i)
+					px[i] = (x + Real(i) * spacing) * mFrequency;
+				for (size_t j=0;j<countY;++j)
+					py[j] = (y + Real(j) * spacing) * mFrequency;
+				for (size_t k=0;k<countZ;++k)
+					pz[k] = (z + Real(k) * spacing) * mFrequency;
+
+				const int xa = VoronoiCells3D::getCell (px.front()), xb = VoronoiCells3D::getCell (px.back());
+				const int ya = VoronoiCells3D::getCell (py.front()), yb = VoronoiCells3D::getCell (py.back());
+				const int za = VoronoiCells3D::getCell (pz.front()), zb = VoronoiCells3D::getCell (pz.back());
+				const int x0 = (xa < xb ? xa : xb), x1 = (xa < xb ? xb : xa);
+				const int y0 = (ya < yb ? ya : yb), y1 = (ya < yb ? yb : ya);
+				const int z0 = (za < zb ? za : zb), z1 = (za < zb ? zb : za);
+
+				const size_t cellCount = VoronoiCells3D::getCellCount (x0, y0, z0, x1, y1, z1);
+				if (cellCount > VoronoiCells3D::MAX_CELLS || cellCount > countX * countY * countZ * 125)
+				{
+					PipelineElement3D::getGridValues (x, y, z, spacing, countX, countY, countZ, out, cache);
+					return;
+				}
+
+				VoronoiCells3D cells;
+				cells.setCells (x0, y0, z0, x1, y1, z1, mSeed);
+				for (size_t k=0;k<countZ;++k)
+				{
+					for (size_t j=0;j<countY;++j)
+					{
+						for (size_t i=0;i<countX;++i,++out)
+						{
+							Real xmin, ymin, zmin;
+							cells.findNearest (px[i], py[j], pz[k], xmin, ymin, zmin);
+							*out = getCellValue (px[i], py[j], pz[k], xmin, ymin, zmin);
+						}
+					}
+				}
 			}
 	};
 
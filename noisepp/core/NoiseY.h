@@ -51,6 +51,10 @@ namespace noisepp
 			{
 				return y;
 			}
+			virtual void getKernelOp (KernelOp &op) const
+			{
+				op.type = KERNELOP_Y;
+			}
 	};
 
 	typedef YElement<PipelineElement1D> YElement1D;
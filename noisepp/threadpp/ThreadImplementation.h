@@ -71,6 +71,59 @@ namespace threadpp
 #endif
 				mJoinable = false;
 			}
+			/// Sets the name debuggers and profilers show for the thread.
+			/// Does nothing where the platform has no thread names.
+			THREADPP_INLINE void setName (const char *name)
+			{
+#if THREADPP_PLATFORM == THREADPP_PLATFORM_UNIX
+#	if defined(__linux__)
+				// the kernel limits names to 15 characters
+				char shortName[16];
+				strncpy (shortName, name, 15);
+				shortName[15] = 0;
+				pthread_setname_np (mThread, shortName);
+#	endif
+#elif THREADPP_PLATFORM == THREADPP_PLATFORM_WINDOWS
+#	if defined(_MSC_VER)
+				// the way the Visual Studio debugger picks up thread names
+#		pragma pack(push,8)
+				struct
+				{
+					DWORD dwType;
+					LPCSTR szName;
+					DWORD dwThreadID;
+					DWORD dwFlags;
+				} info = { 0x1000, name, mThreadId, 0 };
+#		pragma pack(pop)
+				__try
+				{
+					RaiseException (0x406D1388, 0, sizeof(info) / sizeof(ULONG_PTR), (ULONG_PTR*)&info);
+				}
+				__except (EXCEPTION_EXECUTE_HANDLER)
+				{
+				}
+#	endif
+#endif
+			}
+			/// Restricts the thread to the CPUs whose bits are set in mask, bit 0 being the first CPU.
+			/// Does nothing where the platform doesn't support it.
+			THREADPP_INLINE void setAffinity (unsigned long long mask)
+			{
+#if THREADPP_PLATFORM == THREADPP_PLATFORM_UNIX
+#	if defined(__linux__)
+				cpu_set_t cpus;
+				CPU_ZERO (&cpus);
+				for (unsigned i=0;i<64 && i<CPU_SETSIZE;++i)
+				{
+					if (mask & (1ULL << i))
+						CPU_SET (i, &cpus);
+				}
+				pthread_setaffinity_np (mThread, sizeof(cpus), &cpus);
+#	endif
+#elif THREADPP_PLATFORM == THREADPP_PLATFORM_WINDOWS
+				SetThreadAffinityMask (mThreadHandle, (DWORD_PTR)mask);
+#endif
+			}
 	};
 	/// Thread group
 	class ThreadGroup
@@ -86,6 +139,17 @@ namespace threadpp
 				Thread *thread = new Thread (start_routine, arg);
 				mThreads.push_back (thread);
 			}
+			/// Returns the number of threads.
+			THREADPP_INLINE size_t size () const
+			{
+				return mThreads.size ();
+			}
+			/// Returns the thread with the specified index.
+			THREADPP_INLINE Thread &getThread (size_t index)
+			{
+				assert (index < mThreads.size());
+				return *mThreads[index];
+			}
 			/// Join all threads.
 			THREADPP_INLINE void join ()
 			{
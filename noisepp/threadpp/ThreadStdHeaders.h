@@ -24,6 +24,7 @@
 #define THREADPP_STDHEADERS_H
 
 #include <cassert>
+#include <cstring>
 #include <vector>
 #include <limits>
 
@@ -28,6 +28,10 @@
 #include "NoisePipelineJobs.h"
 #include "NoiseMath.h"
 
+#if NOISEPP_ENABLE_THREADS
+#	include "NoiseThreadedPipeline.h"
+#endif
+
 namespace noisepp
 {
 namespace utils
@@ -76,76 +80,118 @@ Builder::~Builder ()
 	}
 }
 
-class ProgressLineJob2D : public LineJob2D
+/// One PlaneBuilder2D::build() call, split into square tiles built independently.
+class PlaneTiles2D
 {
 	private:
-		BuilderCallback *callback;
+		Pipeline2D *mPipe;
+		const PipelineElement2D *mElement;
+		Real *mDest;
+		int mWidth, mHeight;
+		int mTileSize;
+		Real mLowerX, mLowerY;
+		Real mXDelta, mYDelta;
+		Real mXExtent, mYExtent;
+		bool mSeamless;
+		BuilderCallback *mCallback;
+#if NOISEPP_ENABLE_THREADS
+		threadpp::Mutex mCallbackMutex;
+#endif
 
-	public:
-		ProgressLineJob2D (Pipeline2D *pipe, PipelineElement2D *element, Real x, Real y, int n, Real xDelta, Real *buffer, BuilderCallback *callback) : LineJob2D(pipe, element, x, y, n, xDelta, buffer), callback(callback)
-		{}
-		void finish ()
+		void buildRows (int x0, int y0, int n, int rows, Cache *cache)
 		{
-			if (callback)
+			std::vector<Real> xs(n), ys(n);
+			for (int i=0;i<n;++i)
 			{
-				callback->callback ();
+				xs[i] = mLowerX + Real(x0 + i) * mXDelta;
+			}
+			if (!mSeamless)
+			{
+				for (int j=y0;j<y0+rows;++j)
+				{
+					std::fill (ys.begin(), ys.end(), mLowerY + Real(j) * mYDelta);
+					mElement->getValues (&xs[0], &ys[0], n, mDest + size_t(j) * mWidth + x0, cache);
+				}
+				return;
 			}
-		}
-};
 
-class SeamlessPlaneLineJob2D : public PipelineJob
-{
-	private:
-		Pipeline2D *mPipe;
-		PipelineElement2D *mElement;
-		Real x, y;
-		int n;
-		Real xDelta;
-		Real xExtent, yExtent;
-		Real yBlend;
-		Real *buffer;
-		BuilderCallback *callback;
+			// blends the plane with its copies shifted by the extents, so opposite edges match
+			std::vector<Real> xsRight(n), ysTop(n), xBlend(n);
+			std::vector<Real> bl(n), br(n), tl(n), tr(n);
+			for (int i=0;i<n;++i)
+			{
+				xsRight[i] = xs[i] + mXExtent;
+				xBlend[i] = Real(1) - ((xs[i] - mLowerX) / mXExtent);
+			}
+			for (int j=y0;j<y0+rows;++j)
+			{
+				const Real y = mLowerY + Real(j) * mYDelta;
+				const Real yBlend = Real(1) - ((y - mLowerY) / mYExtent);
+				const Real yBlendM = Real(1) - yBlend;
+				std::fill (ys.begin(), ys.end(), y);
+				std::fill (ysTop.begin(), ysTop.end(), y + mYExtent);
+				mElement->getValues (&xs[0], &ys[0], n, &bl[0], cache);
+				mElement->getValues (&xsRight[0], &ys[0], n, &br[0], cache);
+				mElement->getValues (&xs[0], &ysTop[0], n, &tl[0], cache);
+				mElement->getValues (&xsRight[0], &ysTop[0], n, &tr[0], cache);
+				Real *out = mDest + size_t(j) * mWidth + x0;
+				for (int i=0;i<n;++i)
+				{
+					const Real y0 = Math::InterpLinear(bl[i], br[i], xBlend[i]);
+					const Real y1 = Math::InterpLinear(tl[i], tr[i], xBlend[i]);
+					out[i] = yBlendM * y0 + yBlend * y1;
+				}
+			}
+		}
 
 	public:
-		SeamlessPlaneLineJob2D (Pipeline2D *pipe, PipelineElement2D *element, Real x, Real y, int n, Real xDelta, Real xExtent, Real yExtent, Real yBlend, Real *buffer, BuilderCallback *callback) :
-			mPipe(pipe), mElement(element), x(x), y(y), n(n), xDelta(xDelta), xExtent(xExtent), yExtent(yExtent), yBlend(yBlend), buffer(buffer), callback(callback)
+		PlaneTiles2D (Pipeline2D *pipe, const PipelineElement2D *element, Real *dest, int width, int height, int tileSize,
+			Real lowerX, Real lowerY, Real upperX, Real upperY, bool seamless, BuilderCallback *callback) :
+			mPipe(pipe), mElement(element), mDest(dest), mWidth(width), mHeight(height), mTileSize(tileSize),
+			mLowerX(lowerX), mLowerY(lowerY), mXExtent(upperX - lowerX), mYExtent(upperY - lowerY), mSeamless(seamless), mCallback(callback)
 		{
+			mXDelta = mXExtent / (Real)mWidth;
+			mYDelta = mYExtent / (Real)mHeight;
 		}
-		void execute (Cache *cache)
+		int getTilesX () const
 		{
-			Real blValue, brValue, tlValue, trValue;
-			Real xBlend;
-			Real yBlendM = Real(1) - yBlend;
-			Real lowerX = x;
-			Real y0, y1;
-			for (int i=0;i<n;++i)
-			{
-				// cleans the cache
-				mPipe->cleanCache (cache);
-				// calculates the values
-				blValue = mElement->getValue(x, y, cache);
-				brValue = mElement->getValue(x+xExtent, y, cache);
-				tlValue = mElement->getValue(x, y+yExtent, cache);
-				trValue = mElement->getValue(x+xExtent, y+yExtent, cache);
-				xBlend = Real(1) - ((x-lowerX) / xExtent);
-				y0 = Math::InterpLinear(blValue, brValue, xBlend);
-				y1 = Math::InterpLinear(tlValue, trValue, xBlend);
-				buffer[i] = yBlendM * y0 + yBlend * y1;
-
-				// move on
-				x += xDelta;
-			}
+			return (mWidth + mTileSize - 1) / mTileSize;
+		}
+		int getTilesY () const
+		{
+			return (mHeight + mTileSize - 1) / mTileSize;
 		}
-		void finish ()
+		/// Builds a tile straight into the destination and reports it to the callback. Thread safe.
+		void buildTile (int tileX, int tileY)
 		{
-			if (callback)
+			const int x0 = tileX * mTileSize;
+			const int y0 = tileY * mTileSize;
+			const int n = (x0 + mTileSize < mWidth ? mTileSize : mWidth - x0);
+			const int rows = (y0 + mTileSize < mHeight ? mTileSize : mHeight - y0);
+
+			Cache *cache = mPipe->createCache ();
+			try
 			{
-				callback->callback ();
+				buildRows (x0, y0, n, rows, cache);
+			}
+			catch (...)
+			{
+				mPipe->freeCache (cache);
+				throw;
+			}
+			mPipe->freeCache (cache);
+
+			if (mCallback)
+			{
+#if NOISEPP_ENABLE_THREADS
+				threadpp::Mutex::Lock lk(mCallbackMutex);
+#endif
+				mCallback->callback ();
 			}
 		}
 };
 
-PlaneBuilder2D::PlaneBuilder2D () : mLowerBoundX(0), mLowerBoundY(0), mUpperBoundX(0), mUpperBoundY(0), mSeamless(false)
+PlaneBuilder2D::PlaneBuilder2D () : mLowerBoundX(0), mLowerBoundY(0), mUpperBoundX(0), mUpperBoundY(0), mSeamless(false), mTileSize(64)
 {
 }
 
@@ -170,40 +216,78 @@ void PlaneBuilder2D::build (Pipeline2D *pipeline, PipelineElement2D *element)
 		destroyPipe = true;
 	}
 
-	Real xExtent = (mUpperBoundX - mLowerBoundX);
-	Real yExtent = (mUpperBoundY - mLowerBoundY);
-	Real xDelta = xExtent / (Real)mWidth;
-	Real yDelta = yExtent / (Real)mHeight;
-	Real yp = mLowerBoundY;
-	if (!mSeamless)
+	PlaneTiles2D tiles(pipeline, element, mDest, mWidth, mHeight, mTileSize,
+		mLowerBoundX, mLowerBoundY, mUpperBoundX, mUpperBoundY, mSeamless, mCallback);
+
+	std::exception_ptr exception;
+#if NOISEPP_ENABLE_THREADS
+	ThreadedPipeline2D *threaded = dynamic_cast<ThreadedPipeline2D*>(pipeline);
+	if (threaded)
 	{
-		for (int y=0;y<mHeight;++y)
+		std::vector<TaskHandle> tasks;
+		tasks.reserve (tiles.getTilesX() * tiles.getTilesY());
+		for (int ty=0;ty<tiles.getTilesY();++ty)
 		{
-			pipeline->addJob (new ProgressLineJob2D(pipeline, element, mLowerBoundX, yp, mWidth, xDelta, mDest+(y*mWidth), mCallback));
-			yp += yDelta;
+			for (int tx=0;tx<tiles.getTilesX();++tx)
+			{
+				tasks.push_back (threaded->getThreadPool().submit (std::bind(&PlaneTiles2D::buildTile, &tiles, tx, ty), threaded->getPriority()));
+			}
+		}
+		for (size_t i=0;i<tasks.size();++i)
+		{
+			try
+			{
+				tasks[i].wait ();
+			}
+			catch (...)
+			{
+				if (!exception)
+					exception = std::current_exception ();
+			}
 		}
 	}
 	else
+#endif
 	{
-		for (int y=0;y<mHeight;++y)
+		try
+		{
+			for (int ty=0;ty<tiles.getTilesY();++ty)
+			{
+				for (int tx=0;tx<tiles.getTilesX();++tx)
+				{
+					tiles.buildTile (tx, ty);
+				}
+			}
+		}
+		catch (...)
 		{
-			Real yBlend = Real(1) - ((yp-mLowerBoundY) / yExtent);
-			pipeline->addJob (new SeamlessPlaneLineJob2D(pipeline, element, mLowerBoundX, yp, mWidth, xDelta, xExtent, yExtent, yBlend, mDest+(y*mWidth), mCallback));
-			yp += yDelta;
+			exception = std::current_exception ();
 		}
 	}
-	pipeline->executeJobs ();
 
 	if (destroyPipe)
 	{
 		delete pipeline;
 		pipeline = 0;
 	}
+	if (exception)
+		std::rethrow_exception (exception);
 }
 
 int PlaneBuilder2D::getProgressMaximum () const
 {
-	return mHeight;
+	return ((mWidth + mTileSize - 1) / mTileSize) * ((mHeight + mTileSize - 1) / mTileSize);
+}
+
+void PlaneBuilder2D::setTileSize (int size)
+{
+	NoiseAssert(size > 0, size);
+	mTileSize = size;
+}
+
+int PlaneBuilder2D::getTileSize () const
+{
+	return mTileSize;
 }
 
 void PlaneBuilder2D::setBounds (Real lowerBoundX, Real lowerBoundY, Real upperBoundX, Real upperBoundY)
@@ -113,12 +113,17 @@ class Builder
 };
 
 /// Builder class for a 2D plane
+/// The plane is built in square tiles written straight into the destination. With a threaded pipeline
+/// the tiles run as tasks in its thread pool, otherwise one after another on the calling thread.
+/// The callback gets one call per finished tile. With a threaded pipeline it is called on the thread
+/// that built the tile, never on two threads at once.
 class PlaneBuilder2D : public Builder
 {
 	private:
 		Real mLowerBoundX, mLowerBoundY;
 		Real mUpperBoundX, mUpperBoundY;
 		bool mSeamless;
+		int mTileSize;
 
 	public:
 		/// Constructor.
@@ -148,6 +153,11 @@ class PlaneBuilder2D : public Builder
 		void setSeamless (bool v=true);
 		/// Returns if building a seamless plane is enabled.
 		bool isSeamless () const;
+		/// Sets the edge length of the tiles in pixels, 64 by default.
+		/// A tile should fit into the CPU cache with some room to spare.
+		void setTileSize (int size);
+		/// Returns the edge length of the tiles in pixels.
+		int getTileSize () const;
 };
 
 };
@@ -60,75 +60,91 @@ JobQueue::~JobQueue ()
 }
 
 #if NOISEPP_ENABLE_THREADS
-void ThreadedJobQueue::threadFunction ()
+void ThreadedJobQueue::runJob (Job *job)
+{
+	try
+	{
+		job->execute();
+	}
+	catch (...)
+	{
+		// a failed job is not finished, only deleted
+		delete job;
+		throw;
+	}
+	threadpp::Mutex::Lock lk(mMutex);
+	mJobsDone.push (job);
+}
+
+void ThreadedJobQueue::finishJobs ()
 {
 	threadpp::Mutex::Lock lk(mMutex);
-	while (!mThreadsDone)
+	while (!mJobsDone.empty())
 	{
-		if (mJobs.empty())
-			mCond.wait(lk);
-		if (!mJobs.empty())
-		{
-			Job *job = mJobs.front ();
-			mJobs.pop ();
-			++mWorkingThreads;
-			lk.unlock ();
-			job->execute();
-			lk.lock ();
-			--mWorkingThreads;
-			mJobsDone.push (job);
-			mMainCond.notifyOne ();
-		}
+		Job *job = mJobsDone.front ();
+		mJobsDone.pop ();
+		lk.unlock ();
+		job->finish ();
+		delete job;
+		lk.lock ();
 	}
 }
 
-void *ThreadedJobQueue::threadEntry (void *queue)
+ThreadedJobQueue::ThreadedJobQueue (size_t numberOfThreads) : mPool(new ThreadPool(numberOfThreads)), mOwnsPool(true), mPriority(TASK_PRIORITY_NORMAL)
 {
-	(static_cast<ThreadedJobQueue*>(queue))->threadFunction ();
-	return NULL;
 }
 
-ThreadedJobQueue::ThreadedJobQueue (size_t numberOfThreads) : mThreadsDone(false), mWorkingThreads(0)
+ThreadedJobQueue::ThreadedJobQueue (ThreadPool &pool) : mPool(&pool), mOwnsPool(false), mPriority(TASK_PRIORITY_NORMAL)
 {
-	NoiseAssert (numberOfThreads > 0, numberOfThreads);
-	for (size_t i=0;i<numberOfThreads;++i)
-	{
-		mThreads.createThread (threadEntry, this);
-	}
+}
+
+void ThreadedJobQueue::setPriority (int priority)
+{
+	mPriority = priority;
+}
+
+int ThreadedJobQueue::getPriority () const
+{
+	return mPriority;
+}
+
+ThreadPool &ThreadedJobQueue::getThreadPool () const
+{
+	return *mPool;
 }
 
 void ThreadedJobQueue::executeJobs ()
 {
-	mCond.notifyAll();
-	threadpp::Mutex::Lock lk(mMutex);
-	while (!mJobs.empty() || mWorkingThreads > 0)
+	std::vector<TaskHandle> tasks;
+	tasks.reserve (mJobs.size());
+	while (!mJobs.empty())
+	{
+		Job *job = mJobs.front ();
+		mJobs.pop ();
+		tasks.push_back (mPool->submit (std::bind(&ThreadedJobQueue::runJob, this, job), mPriority));
+	}
+	std::exception_ptr exception;
+	for (size_t i=0;i<tasks.size();++i)
 	{
-		if (!mJobs.empty() || mWorkingThreads > 0)
-			mMainCond.wait(lk);
-		while (!mJobsDone.empty())
+		try
+		{
+			tasks[i].wait ();
+		}
+		catch (...)
 		{
-			Job *job = mJobsDone.front ();
-			mJobsDone.pop ();
-			lk.unlock ();
-			job->finish ();
-			delete job;
-			lk.lock ();
+			if (!exception)
+				exception = std::current_exception ();
 		}
+		finishJobs ();
 	}
-}
-
-void ThreadedJobQueue::addJob (Job *job)
-{
-	NoiseAssert (job != NULL, job);
-	threadpp::Mutex::Lock lk(mMutex);
-	mJobs.push (job);
+	if (exception)
+		std::rethrow_exception (exception);
 }
 
 ThreadedJobQueue::~ThreadedJobQueue ()
 {
-	mThreadsDone = true;
-	mCond.notifyAll();
-	mThreads.join ();
+	if (mOwnsPool)
+		delete mPool;
 }
 #endif
 
@@ -28,6 +28,10 @@
 
 #include "NoisePrerequisites.h"
 
+#if NOISEPP_ENABLE_THREADS
+#	include "NoiseThreadPool.h"
+#endif
+
 namespace noisepp
 {
 namespace utils
@@ -73,23 +77,29 @@ class ThreadedJobQueue : public JobQueue
 		/// A queue for done jobs
 		std::queue<Job*> mJobsDone;
 
-		threadpp::ThreadGroup mThreads;
+		ThreadPool *mPool;
+		bool mOwnsPool;
+		int mPriority;
 		threadpp::Mutex mMutex;
-		threadpp::Condition mCond, mMainCond;
 
-		bool mThreadsDone;
-		unsigned mWorkingThreads;
-
-		void threadFunction ();
-		static void *threadEntry (void *queue);
+		void runJob (Job *job);
+		void finishJobs ();
 	public:
-		/// Constructor.
+		/// Constructor. Creates a thread pool used by this queue only.
 		/// @param numberOfThreads The number of threads
 		ThreadedJobQueue (size_t numberOfThreads);
+		/// Constructor. Runs the jobs in a shared thread pool.
+		/// @param pool The thread pool, has to outlive the queue
+		ThreadedJobQueue (ThreadPool &pool);
+		/// Sets the priority the jobs are submitted to the thread pool with.
+		void setPriority (int priority);
+		/// Returns the priority the jobs are submitted to the thread pool with.
+		int getPriority () const;
+		/// Returns the thread pool running the jobs.
+		ThreadPool &getThreadPool () const;
 		/// @copydoc noisepp::utils::JobQueue::executeJobs()
+		/// The calling thread helps running the jobs, so this can be called from a task of the same pool.
 		virtual void executeJobs ();
-		/// @copydoc noisepp::utils::JobQueue::addJob()
-		virtual void addJob (Job *job);
 		/// Destructor.
 		virtual ~ThreadedJobQueue ();
 };
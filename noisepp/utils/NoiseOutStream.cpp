@@ -126,5 +126,37 @@ void MemoryOutStream::seek (size_t pos)
 	mPosition = pos;
 }
 
+HashOutStream::HashOutStream ()
+{
+	reset ();
+}
+
+void HashOutStream::reset ()
+{
+	mHash = 14695981039346656037ULL;
+	mPosition = 0;
+}
+
+void HashOutStream::write (const void *buffer, size_t len)
+{
+	const unsigned char *bytes = (const unsigned char *)buffer;
+	for (size_t i=0;i<len;++i)
+	{
+		mHash ^= bytes[i];
+		mHash *= 1099511628211ULL;
+	}
+	mPosition += len;
+}
+
+size_t HashOutStream::tell ()
+{
+	return mPosition;
+}
+
+void HashOutStream::seek (size_t pos)
+{
+	assert (pos == mPosition);
+}
+
 };
 };
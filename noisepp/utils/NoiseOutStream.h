@@ -146,6 +146,38 @@ class MemoryOutStream : public OutStream
 		virtual void seek (size_t pos);
 };
 
+/// Output stream that doesn't store anything but hashes everything written to it.
+/// Useful to get a fingerprint of a serialized module graph.
+class HashOutStream : public OutStream
+{
+	private:
+		unsigned long long mHash;
+		size_t mPosition;
+	public:
+		/// Constructor.
+		HashOutStream ();
+		/// Resets the hash.
+		void reset ();
+		/// Returns the 64 bit FNV-1a hash of all bytes written so far.
+		unsigned long long getHash () const
+		{
+			return mHash;
+		}
+		/// @copydoc noisepp::utils::OutStream::write(T)
+		template <class T>
+		void write (T t)
+		{
+			EndianUtils::flipEndian (&t, sizeof(T));
+			write (&t, sizeof(T));
+		}
+		/// @copydoc noisepp::utils::OutStream::write(const void *, size_t)
+		virtual void write (const void *buffer, size_t len);
+		/// @copydoc noisepp::utils::OutStream::tell()
+		virtual size_t tell ();
+		/// Not supported, a hash can't be rewound.
+		virtual void seek (size_t pos);
+};
+
 };
 };
 
@@ -0,0 +1,132 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "NoisePrerequisites.h"
+#include "NoiseProfiler.h"
+
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#	include <x86intrin.h>
+#else
+#	include <ctime>
+#endif
+
+namespace noisepp
+{
+namespace utils
+{
+
+ProfiledPipeline3D::ProfiledPipeline3D () : mSourceCycles(0)
+{
+}
+
+ElementID ProfiledPipeline3D::addElement (const Module *parent, PipelineElement3D *element)
+{
+	NoiseAssert (element != NULL, element);
+	NoiseAssert (parent != NULL, parent);
+	ElementID id = getElementID (parent);
+	if (id != ELEMENTID_INVALID)
+	{
+		delete element;
+		return id;
+	}
+	// Users of the module only get to see the wrapper, the element itself keeps its ID for the cache.
+	ElementID elementID = mElements.size ();
+	mElements.push_back (element);
+	id = mElements.size ();
+	mElements.push_back (new ProfiledElement3D(this, elementID, id));
+	mElementIDs.insert (std::make_pair(parent, id));
+	return id;
+}
+
+const ElementProfile &ProfiledPipeline3D::getProfile (ElementID id) const
+{
+	const ProfiledElement3D *wrapper = dynamic_cast<const ProfiledElement3D*>(getElement (id));
+	NoiseAssert (wrapper != NULL, id);
+	return wrapper->mProfile;
+}
+
+const ElementProfile *ProfiledPipeline3D::getProfile (const Module *module) const
+{
+	ElementID id = getElementID (module);
+	if (id == ELEMENTID_INVALID)
+		return NULL;
+	return &getProfile (id);
+}
+
+void ProfiledPipeline3D::resetProfiles ()
+{
+	for (std::vector<PipelineElement3D*>::iterator it=mElements.begin();it!=mElements.end();++it)
+	{
+		ProfiledElement3D *wrapper = dynamic_cast<ProfiledElement3D*>(*it);
+		if (wrapper)
+			wrapper->mProfile = ElementProfile ();
+	}
+	mSourceCycles = 0;
+}
+
+unsigned long long ProfiledPipeline3D::getCycles ()
+{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+	return __rdtsc ();
+#else
+	return (unsigned long long)clock ();
+#endif
+}
+
+ProfiledElement3D::ProfiledElement3D (ProfiledPipeline3D *pipe, ElementID element, ElementID wrapper) : mPipeline(pipe), mElement(element), mWrapper(wrapper)
+{
+	mElementPtr = pipe->getElement (mElement);
+}
+
+Real ProfiledElement3D::getValue (Real x, Real y, Real z, Cache *cache) const
+{
+	// Sources look up the wrapper's entry before calling it; keeping that empty brings every lookup here.
+	cache[mWrapper].filled = false;
+	++mProfile.calls;
+	Cache &entry = cache[mElement];
+	if (entry.filled && entry.x == x && entry.y == y && entry.z == z)
+	{
+		++mProfile.cacheHits;
+		return entry.value;
+	}
+	entry.filled = true;
+	entry.x = x;
+	entry.y = y;
+	entry.z = z;
+	const unsigned long long outerSourceCycles = mPipeline->mSourceCycles;
+	mPipeline->mSourceCycles = 0;
+	const unsigned long long start = ProfiledPipeline3D::getCycles ();
+	entry.value = mElementPtr->getValue (x, y, z, cache);
+	const unsigned long long cycles = ProfiledPipeline3D::getCycles () - start;
+	mProfile.inclusiveCycles += cycles;
+	mProfile.exclusiveCycles += cycles > mPipeline->mSourceCycles ? cycles - mPipeline->mSourceCycles : 0;
+	mPipeline->mSourceCycles = outerSourceCycles + cycles;
+	return entry.value;
+}
+
+};
+};
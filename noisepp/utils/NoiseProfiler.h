@@ -0,0 +1,115 @@
+// Noise++ Library
+// Copyright (c) 2008, Urs C. Hanselmann
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright notice,
+//      this list of conditions and the following disclaimer in the documentation
+//      and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef NOISEPROFILER_H
+#define NOISEPROFILER_H
+
+#include "NoisePipeline.h"
+#include "NoiseModule.h"
+
+namespace noisepp
+{
+namespace utils
+{
+
+/// Counters of one pipeline element, see ProfiledPipeline3D.
+struct ElementProfile
+{
+	/// Number of times the element was asked for a value, cache hits included.
+	unsigned long long calls;
+	/// Number of calls answered from the cache.
+	unsigned long long cacheHits;
+	/// Cycles spent evaluating the element, its sources included.
+	unsigned long long inclusiveCycles;
+	/// Cycles spent in the element itself.
+	unsigned long long exclusiveCycles;
+	/// Constructor.
+	ElementProfile () : calls(0), cacheHits(0), inclusiveCycles(0), exclusiveCycles(0) {}
+};
+
+class ProfiledElement3D;
+
+/** 3D pipeline which measures every element added to it.
+	Each element gets a wrapper in front of it which does the cache lookup of the element itself,
+	so every lookup is counted, and reads the time stamp counter around the evaluation.
+	The wrappers describe themselves as plain elements, so PipelineSchedule3D and PipelineKernel3D
+	evaluate the whole graph through PipelineElement3D::getValue() as well. Use it to find out where
+	the time goes, not to generate: the counters are not thread safe, so evaluate from one thread
+	at a time, and the wrappers cost some cycles of their own.
+*/
+class ProfiledPipeline3D : public Pipeline3D
+{
+	private:
+		/// Cycles spent in the sources of the element currently being evaluated.
+		unsigned long long mSourceCycles;
+
+		friend class ProfiledElement3D;
+
+	public:
+		/// Constructor.
+		ProfiledPipeline3D ();
+		/// @copydoc noisepp::Pipeline::addElement()
+		/// Adds the element and a wrapper measuring it, and returns the ID of the wrapper.
+		virtual ElementID addElement (const Module *parent, PipelineElement3D *element);
+		/// Returns the counters of the element with the specified ID, as returned by Module::addToPipeline().
+		const ElementProfile &getProfile (ElementID id) const;
+		/// Returns the counters of the element of the specified module or NULL if it was not added.
+		const ElementProfile *getProfile (const Module *module) const;
+		/// Sets all counters back to zero.
+		void resetProfiles ();
+		/// Returns the time stamp counter of the CPU.
+		static unsigned long long getCycles ();
+};
+
+/// The wrapper ProfiledPipeline3D puts in front of each element.
+class ProfiledElement3D : public PipelineElement3D
+{
+	private:
+		ProfiledPipeline3D *mPipeline;
+		const PipelineElement3D *mElementPtr;
+		ElementID mElement;
+		ElementID mWrapper;
+		mutable ElementProfile mProfile;
+
+		friend class ProfiledPipeline3D;
+
+	public:
+		/// Constructor.
+		/// @param element The ID of the wrapped element, which has the cache entry used.
+		/// @param wrapper The ID of this wrapper.
+		ProfiledElement3D (ProfiledPipeline3D *pipe, ElementID element, ElementID wrapper);
+		/// @copydoc noisepp::PipelineElement3D::getValue()
+		virtual Real getValue (Real x, Real y, Real z, Cache *cache) const;
+		/// Returns the wrapped element.
+		const PipelineElement3D *getElement () const
+		{
+			return mElementPtr;
+		}
+};
+
+};
+};
+
+#endif // NOISEPROFILER_H
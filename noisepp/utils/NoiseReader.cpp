@@ -51,10 +51,8 @@ Reader::Reader (InStream &stream) : mStream(stream), mModuleCount(0)
 	}
 }
 
-void Reader::readModule ()
+Module *Reader::createModule (unsigned short typeID)
 {
-	unsigned short typeID;
-	mStream.read (typeID);
 	Module *module = NULL;
 	switch (typeID)
 	{
@@ -133,8 +131,22 @@ void Reader::readModule ()
         case MODULE_INVERTMUL:
 			module = new InverseMulModule;
 			break;
+        case MODULE_SIMPLEX:
+			module = new SimplexModule;
+			break;
+        case MODULE_RIDGEDSIMPLEX:
+			module = new RidgedSimplexModule;
+			break;
         
 	}
+	return module;
+}
+
+void Reader::readModule ()
+{
+	unsigned short typeID;
+	mStream.read (typeID);
+	Module *module = createModule (typeID);
 	if (!module)
 		throw ReaderException ("Invalid module type ID");
 	assert (module->getType() == typeID);
@@ -57,6 +57,9 @@ class Reader
 		~Reader ();
 		/// Returns a pointer to the module with the specified ID or NULL if it does not exist.
 		Module *getModule (unsigned short id=0);
+		/// Creates a module of the specified type with default parameters or returns NULL for an unknown type.
+		/// The caller owns the module.
+		static Module *createModule (unsigned short typeID);
 };
 
 };
@@ -60,11 +60,43 @@ int System::getNumberOfCPUs()
 	return mNumberOfCPUs;
 }
 
+#if NOISEPP_ENABLE_THREADS
+static threadpp::Mutex threadPoolMutex;
+
+ThreadPool *System::mThreadPool = NULL;
+ThreadPoolConfig System::mThreadPoolConfig = System::getDefaultThreadPoolConfig();
+
+ThreadPoolConfig System::getDefaultThreadPoolConfig()
+{
+	ThreadPoolConfig config(mNumberOfCPUs > 1 ? mNumberOfCPUs : 1);
+	config.name = "noisepp";
+	return config;
+}
+
+bool System::setThreadPoolConfig (const ThreadPoolConfig &config)
+{
+	NoiseAssert (config.numberOfThreads > 0, numberOfThreads);
+	threadpp::Mutex::Lock lk(threadPoolMutex);
+	if (mThreadPool)
+		return false;
+	mThreadPoolConfig = config;
+	return true;
+}
+
+ThreadPool &System::getThreadPool ()
+{
+	threadpp::Mutex::Lock lk(threadPoolMutex);
+	if (!mThreadPool)
+		mThreadPool = new ThreadPool(mThreadPoolConfig);
+	return *mThreadPool;
+}
+#endif
+
 Pipeline1D *System::createOptimalPipeline1D ()
 {
 #if NOISEPP_ENABLE_THREADS
 	if (mNumberOfCPUs > 1)
-		return new ThreadedPipeline1D (mNumberOfCPUs);
+		return new ThreadedPipeline1D (getThreadPool());
 #endif
 	return new Pipeline1D;
 }
@@ -73,7 +105,7 @@ Pipeline2D *System::createOptimalPipeline2D ()
 {
 #if NOISEPP_ENABLE_THREADS
 	if (mNumberOfCPUs > 1)
-		return new ThreadedPipeline2D (mNumberOfCPUs);
+		return new ThreadedPipeline2D (getThreadPool());
 #endif
 	return new Pipeline2D;
 }
@@ -82,7 +114,7 @@ Pipeline3D *System::createOptimalPipeline3D ()
 {
 #if NOISEPP_ENABLE_THREADS
 	if (mNumberOfCPUs > 1)
-		return new ThreadedPipeline3D (mNumberOfCPUs);
+		return new ThreadedPipeline3D (getThreadPool());
 #endif
 	return new Pipeline3D;
 }
@@ -91,7 +123,7 @@ JobQueue *System::createOptimalJobQueue ()
 {
 #if NOISEPP_ENABLE_THREADS
 	if (mNumberOfCPUs > 1)
-		return new ThreadedJobQueue (mNumberOfCPUs);
+		return new ThreadedJobQueue (getThreadPool());
 #endif
 	return new JobQueue;
 }
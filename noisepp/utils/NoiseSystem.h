@@ -40,18 +40,31 @@ class System
 	public:
 		/// Returns the number of CPU cores avaible on the running system.
 		static int getNumberOfCPUs();
-		/// Creates an optimal 1D pipeline using as many threads as there are CPU cores avaible.
+		/// Creates an optimal 1D pipeline running its jobs in the thread pool returned by getThreadPool().
 		static Pipeline1D *createOptimalPipeline1D ();
-		/// Creates an optimal 2D pipeline using as many threads as there are CPU cores avaible.
+		/// Creates an optimal 2D pipeline running its jobs in the thread pool returned by getThreadPool().
 		static Pipeline2D *createOptimalPipeline2D ();
-		/// Creates an optimal 3D pipeline using as many threads as there are CPU cores avaible.
+		/// Creates an optimal 3D pipeline running its jobs in the thread pool returned by getThreadPool().
 		static Pipeline3D *createOptimalPipeline3D ();
-		/// Creates an optimal job queue using as many threads as there are CPU cores avaible.
+		/// Creates an optimal job queue running its jobs in the thread pool returned by getThreadPool().
 		static JobQueue *createOptimalJobQueue ();
+#if NOISEPP_ENABLE_THREADS
+		/// Sets up the process wide thread pool. Only has an effect before the pool is first used.
+		/// The default has as many threads as there are CPU cores avaible, named "noisepp".
+		/// @return False if the pool was already created.
+		static bool setThreadPoolConfig (const ThreadPoolConfig &config);
+		/// Returns the process wide thread pool, creating it on the first call. It lives until the process exits.
+		static ThreadPool &getThreadPool ();
+#endif
 	protected:
 	private:
 		static int mNumberOfCPUs;
 		static int calculateNumberOfCPUs();
+#if NOISEPP_ENABLE_THREADS
+		static ThreadPool *mThreadPool;
+		static ThreadPoolConfig mThreadPoolConfig;
+		static ThreadPoolConfig getDefaultThreadPoolConfig();
+#endif
 };
 
 };
@@ -43,5 +43,6 @@
 #include "NoiseJobQueue.h"
 #include "NoiseGradientRenderer.h"
 #include "NoiseBuilders.h"
+#include "NoiseProfiler.h"
 
 #endif // NOISEUTILS_H
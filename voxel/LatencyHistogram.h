@@ -0,0 +1,160 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+
+///Histogram of latencies with a fixed relative precision, in the spirit of HdrHistogram.
+///
+///Values below 32 get a bucket each, above that every power of two is split into 16 buckets,
+/// so a bucket is never wider than 1/16 of its values: about 6% error at any magnitude with
+/// under a thousand counters for the whole 64 bit range. The unit is up to the user.
+///Not thread safe.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value);
+
+    void reset();
+
+    uint64_t getCount() const;
+    uint64_t getMin() const;
+    uint64_t getMax() const;
+    double getMean() const;
+
+    ///Smallest value that at least percentile percent of the recorded values are at or below,
+    /// rounded up to the end of its bucket. 0 if nothing was recorded.
+    uint64_t getPercentile(double percentile) const;
+
+private:
+    static const std::size_t SUB_BUCKETS = 16;
+    static const std::size_t BUCKET_COUNT = 2 * SUB_BUCKETS + (64 - 5) * SUB_BUCKETS;
+
+    static std::size_t getBucket(uint64_t value);
+    static uint64_t getBucketEnd(std::size_t bucket);
+
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count;
+    uint64_t m_min;
+    uint64_t m_max;
+    double m_sum;
+};
+
+
+inline LatencyHistogram::LatencyHistogram()
+    : m_buckets(BUCKET_COUNT, 0)
+{
+    reset();
+}
+
+inline std::size_t LatencyHistogram::getBucket(uint64_t value)
+{
+    if(value < 2 * SUB_BUCKETS)
+    {
+        return static_cast<std::size_t>(value);
+    }
+
+    ///Shift value down until it is in [SUB_BUCKETS, 2 * SUB_BUCKETS).
+    std::size_t shift = 0;
+    while((value >> shift) >= 2 * SUB_BUCKETS)
+    {
+        shift++;
+    }
+
+    return 2 * SUB_BUCKETS + (shift - 1) * SUB_BUCKETS + static_cast<std::size_t>((value >> shift) - SUB_BUCKETS);
+}
+
+inline uint64_t LatencyHistogram::getBucketEnd(std::size_t bucket)
+{
+    if(bucket < 2 * SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    std::size_t shift = (bucket - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+    uint64_t start = SUB_BUCKETS + (bucket - 2 * SUB_BUCKETS) % SUB_BUCKETS;
+
+    return ((start + 1) << shift) - 1;
+}
+
+inline void LatencyHistogram::record(uint64_t value)
+{
+    m_buckets[getBucket(value)]++;
+
+    if(!m_count || value < m_min)
+    {
+        m_min = value;
+    }
+    if(value > m_max)
+    {
+        m_max = value;
+    }
+
+    m_count++;
+    m_sum += double(value);
+}
+
+inline void LatencyHistogram::reset()
+{
+    m_buckets.assign(BUCKET_COUNT, 0);
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+inline uint64_t LatencyHistogram::getCount() const
+{
+    return m_count;
+}
+
+inline uint64_t LatencyHistogram::getMin() const
+{
+    return m_min;
+}
+
+inline uint64_t LatencyHistogram::getMax() const
+{
+    return m_max;
+}
+
+inline double LatencyHistogram::getMean() const
+{
+    return m_count ? m_sum / double(m_count) : 0.0;
+}
+
+inline uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+    if(!m_count)
+    {
+        return 0;
+    }
+
+    ///Rank of the value asked for, 1 based.
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * double(m_count)));
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for(std::size_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        seen += m_buckets[bucket];
+
+        if(seen >= rank)
+        {
+            uint64_t end = getBucketEnd(bucket);
+            return end < m_max ? end : m_max;
+        }
+    }
+
+    return m_max;
+}
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+#include <boost/noncopyable.hpp>
+
+
+///Monotonic allocator for short lived temporaries, like the lists built while meshing a chunk.
+///
+///allocate() bumps a pointer through big blocks, deallocate() does nothing and reset() rewinds
+/// everything at once. If the last round needed more than one block, reset() replaces them
+/// with a single block of the total size, so a round of the same size runs without any heap
+/// allocation afterwards. Not thread safe, give every thread its own arena.
+class ScratchArena : boost::noncopyable
+{
+public:
+    struct Stats
+    {
+        ///Bytes handed out since the last reset, alignment padding included.
+        std::size_t m_bytes;
+        ///allocate() calls since the last reset.
+        std::size_t m_calls;
+        ///Bytes reserved in blocks.
+        std::size_t m_capacity;
+        ///Blocks allocated from the heap since the arena was created.
+        std::size_t m_heapAllocations;
+    };
+
+    ScratchArena(std::size_t blockSize = 64 * 1024);
+    ~ScratchArena();
+
+    void* allocate(std::size_t bytes, std::size_t alignment);
+
+    ///Invalidates everything allocated so far.
+    void reset();
+
+    const Stats& getStats() const;
+
+private:
+    struct Block
+    {
+        char* m_data;
+        std::size_t m_size;
+    };
+
+    void addBlock(std::size_t size);
+
+    std::vector<Block> m_blocks;
+    std::size_t m_currentBlock;
+    std::size_t m_offset;
+    std::size_t m_blockSize;
+
+    Stats m_stats;
+};
+
+
+inline ScratchArena::ScratchArena(std::size_t blockSize)
+    : m_currentBlock(0)
+    , m_offset(0)
+    , m_blockSize(blockSize)
+{
+    m_stats.m_bytes = 0;
+    m_stats.m_calls = 0;
+    m_stats.m_capacity = 0;
+    m_stats.m_heapAllocations = 0;
+
+    m_blocks.reserve(16);
+    addBlock(m_blockSize);
+}
+
+inline ScratchArena::~ScratchArena()
+{
+    for(auto& block : m_blocks)
+    {
+        delete[] block.m_data;
+    }
+}
+
+inline void ScratchArena::addBlock(std::size_t size)
+{
+    Block block;
+    block.m_data = new char[size];
+    block.m_size = size;
+
+    m_blocks.push_back(block);
+
+    m_stats.m_capacity += size;
+    m_stats.m_heapAllocations++;
+}
+
+inline void* ScratchArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    assert(alignment && !(alignment & (alignment - 1)));
+
+    m_stats.m_calls++;
+
+    for(;;)
+    {
+        Block& block = m_blocks[m_currentBlock];
+
+        std::size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+
+        if(start + bytes <= block.m_size)
+        {
+            m_stats.m_bytes += start + bytes - m_offset;
+            m_offset = start + bytes;
+            return block.m_data + start;
+        }
+
+        ///Blocks behind the current one are only there before the first reset.
+        m_currentBlock++;
+        m_offset = 0;
+
+        if(m_currentBlock == m_blocks.size())
+        {
+            addBlock(std::max(m_blockSize, bytes + alignment));
+        }
+    }
+}
+
+inline void ScratchArena::reset()
+{
+    if(m_blocks.size() > 1)
+    {
+        std::size_t size = m_stats.m_capacity;
+
+        for(auto& block : m_blocks)
+        {
+            delete[] block.m_data;
+        }
+        m_blocks.clear();
+        m_stats.m_capacity = 0;
+
+        addBlock(size);
+    }
+
+    m_currentBlock = 0;
+    m_offset = 0;
+
+    m_stats.m_bytes = 0;
+    m_stats.m_calls = 0;
+}
+
+inline const ScratchArena::Stats& ScratchArena::getStats() const
+{
+    return m_stats;
+}
+
+
+///STL allocator drawing from a ScratchArena, for std::vector, std::map and friends.
+///Containers using it must be gone before the arena is reset.
+template<class T>
+class ScratchAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind
+    {
+        typedef ScratchAllocator<U> other;
+    };
+
+    ScratchAllocator(ScratchArena& arena) : m_pArena(&arena) {}
+
+    template<class U>
+    ScratchAllocator(const ScratchAllocator<U>& other) : m_pArena(other.m_pArena) {}
+
+    pointer allocate(size_type count, const void* = 0)
+    {
+        return static_cast<pointer>(m_pArena->allocate(count * sizeof(T), __alignof(T)));
+    }
+
+    void deallocate(pointer, size_type)
+    {
+
+    }
+
+    size_type max_size() const
+    {
+        return size_type(-1) / sizeof(T);
+    }
+
+    ScratchArena* m_pArena;
+};
+
+template<class T, class U>
+bool operator==(const ScratchAllocator<T>& a, const ScratchAllocator<U>& b)
+{
+    return a.m_pArena == b.m_pArena;
+}
+
+template<class T, class U>
+bool operator!=(const ScratchAllocator<T>& a, const ScratchAllocator<U>& b)
+{
+    return a.m_pArena != b.m_pArena;
+}
+
+#endif
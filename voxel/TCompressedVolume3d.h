@@ -0,0 +1,454 @@
+#ifndef TCOMPRESSEDVOLUME3D_H
+#define TCOMPRESSEDVOLUME3D_H
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <boost/cstdint.hpp>
+
+#include "TVolume3d.h"
+
+///Read only, compressed copy of a TVolume3d density field, as far as marching cubes sees it.
+///
+///Marching cubes only interpolates along cell edges whose ends lie on different sides of the
+/// iso value (at or below it is solid). Surface cells, those with an axis neighbour on the other
+/// side, keep their distance to the iso value; every other cell only keeps its side and reads
+/// back as isoValue - range when solid and isoValue + range when empty.
+///
+///The volume is cut into bricks of BRICK_SIZE^3 cells (smaller at the far edges):
+///  - uniform: no surface cell, one value for the whole brick (solid rock, open air),
+///  - 8 bit:   a surface and a solid bit per cell and 8 bit distances of the surface cells,
+///  - 16 bit:  the same with 16 bit distances.
+///Distances are quantized over the largest one in the brick, clamped to range. A surface vertex
+/// moves along its edge by about the quantization error over the density difference across the
+/// edge, so a brick gets 8 bits only if that keeps every one of its vertices within maxShift cells.
+///Sides are never changed by quantization.
+///Random access decodes a single cell, decode() rebuilds a whole TVolume3d.
+template<class T>
+class TCompressedVolume3d
+{
+
+public:
+    static const std::size_t BRICK_SHIFT = 3;
+    static const std::size_t BRICK_SIZE = 1 << BRICK_SHIFT;
+
+    ///64 bit words of a per cell bit mask of a brick.
+    static const std::size_t MASK_WORDS = (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE) / 64;
+
+    enum BrickMode
+    {
+        BRICK_UNIFORM = 0,
+        BRICK_8BIT = 1,
+        BRICK_16BIT = 2
+    };
+
+    struct Brick
+    {
+        ///First distance code in m_data, in codes of the brick's mode.
+        boost::uint32_t offset;
+        ///Index into m_masks, unused for uniform bricks.
+        boost::uint32_t masks;
+        ///Value of a uniform brick, distance per code step otherwise.
+        T step;
+        boost::uint8_t mode;
+        boost::uint8_t xSize;
+        boost::uint8_t zSize;
+    };
+
+    ///Cell bits of a brick, in the cell order of the brick (y slowest, x fastest).
+    struct BrickMasks
+    {
+        boost::uint64_t surface[MASK_WORDS];
+        boost::uint64_t solid[MASK_WORDS];
+        ///Surface cells in the words before, to find the code of a cell.
+        boost::uint16_t rank[MASK_WORDS];
+    };
+
+    TCompressedVolume3d(const TVolume3d<T>& volume, T isoValue, T range, T maxShift);
+    ~TCompressedVolume3d();
+
+    T operator()(std::size_t x, std::size_t y, std::size_t z) const;
+
+    void decode(TVolume3d<T>& out) const;
+
+    ///Bytes held by this object, headers included.
+    std::size_t getMemoryUsage() const;
+
+    std::size_t m_xSize;
+    std::size_t m_ySize;
+    std::size_t m_zSize;
+
+    std::size_t m_xBricks;
+    std::size_t m_yBricks;
+    std::size_t m_zBricks;
+
+    T m_isoValue;
+    T m_range;
+    T m_maxShift;
+
+private:
+    static unsigned int popCount(boost::uint64_t bits);
+    static unsigned int lowestBit(boost::uint64_t lowest);
+
+    const Brick& getBrick(std::size_t x, std::size_t y, std::size_t z) const;
+    T readCell(const Brick& brick, std::size_t local) const;
+    T readSurface(const Brick& brick, bool solid, std::size_t rank) const;
+
+    std::vector<Brick> m_bricks;
+    std::vector<BrickMasks> m_masks;
+    std::vector<boost::uint8_t> m_data;
+};
+
+
+template<class T>
+TCompressedVolume3d<T>::TCompressedVolume3d(const TVolume3d<T>& volume, T isoValue, T range, T maxShift)
+    : m_xSize(volume.m_xSize)
+    , m_ySize(volume.m_ySize)
+    , m_zSize(volume.m_zSize)
+    , m_isoValue(isoValue)
+    , m_range(range)
+    , m_maxShift(maxShift)
+{
+    assert(range > 0 && maxShift > 0);
+
+    m_xBricks = (m_xSize + BRICK_SIZE - 1) >> BRICK_SHIFT;
+    m_yBricks = (m_ySize + BRICK_SIZE - 1) >> BRICK_SHIFT;
+    m_zBricks = (m_zSize + BRICK_SIZE - 1) >> BRICK_SHIFT;
+
+    m_bricks.resize(m_xBricks * m_yBricks * m_zBricks);
+
+    const T minStep = std::numeric_limits<T>::epsilon() * (std::fabs(isoValue) + range);
+
+    std::vector<T> distances;
+    distances.reserve(BRICK_SIZE * BRICK_SIZE * BRICK_SIZE);
+
+    ///Bricks are ordered like the cells in TVolume3d: y slowest, x fastest.
+    std::size_t brickIndex = 0;
+    for(std::size_t by = 0; by < m_yBricks; by++)
+    for(std::size_t bz = 0; bz < m_zBricks; bz++)
+    for(std::size_t bx = 0; bx < m_xBricks; bx++, brickIndex++)
+    {
+        std::size_t x0 = bx << BRICK_SHIFT;
+        std::size_t y0 = by << BRICK_SHIFT;
+        std::size_t z0 = bz << BRICK_SHIFT;
+
+        std::size_t xSize = std::min(BRICK_SIZE, m_xSize - x0);
+        std::size_t ySize = std::min(BRICK_SIZE, m_ySize - y0);
+        std::size_t zSize = std::min(BRICK_SIZE, m_zSize - z0);
+
+        BrickMasks masks = BrickMasks();
+        distances.clear();
+
+        T maxDistance = 0;
+        ///Smallest density difference across an edge the surface crosses.
+        T minGap = range;
+        bool anySolid = false;
+
+        std::size_t local = 0;
+        for(std::size_t y = y0; y < y0 + ySize; y++)
+        for(std::size_t z = z0; z < z0 + zSize; z++)
+        for(std::size_t x = x0; x < x0 + xSize; x++, local++)
+        {
+            T value = volume(x, y, z);
+            bool solid = value <= isoValue;
+
+            ///Neighbours in other bricks count too, marching cubes crosses brick borders.
+            const T* neighbours[6] =
+            {
+                x > 0 ? &volume(x - 1, y, z) : NULL,
+                x + 1 < m_xSize ? &volume(x + 1, y, z) : NULL,
+                y > 0 ? &volume(x, y - 1, z) : NULL,
+                y + 1 < m_ySize ? &volume(x, y + 1, z) : NULL,
+                z > 0 ? &volume(x, y, z - 1) : NULL,
+                z + 1 < m_zSize ? &volume(x, y, z + 1) : NULL
+            };
+
+            bool surface = false;
+            for(int i = 0; i < 6; i++)
+            {
+                if(neighbours[i] && (*neighbours[i] <= isoValue) != solid)
+                {
+                    surface = true;
+                    minGap = std::min(minGap, std::fabs(*neighbours[i] - value));
+                }
+            }
+
+            if(solid)
+            {
+                masks.solid[local >> 6] |= boost::uint64_t(1) << (local & 63);
+                anySolid = true;
+            }
+
+            if(surface)
+            {
+                masks.surface[local >> 6] |= boost::uint64_t(1) << (local & 63);
+
+                T distance = std::min(std::fabs(value - isoValue), range);
+                maxDistance = std::max(maxDistance, distance);
+                distances.push_back(distance);
+            }
+        }
+
+        Brick& brick = m_bricks[brickIndex];
+        brick.offset = 0;
+        brick.masks = 0;
+        brick.xSize = static_cast<boost::uint8_t>(xSize);
+        brick.zSize = static_cast<boost::uint8_t>(zSize);
+
+        ///Without surface cells all cells are on one side, neighbours in the brick would differ otherwise.
+        if(distances.empty())
+        {
+            brick.mode = BRICK_UNIFORM;
+            brick.step = anySolid ? isoValue - range : isoValue + range;
+            continue;
+        }
+
+        std::size_t rank = 0;
+        for(std::size_t word = 0; word < MASK_WORDS; word++)
+        {
+            masks.rank[word] = static_cast<boost::uint16_t>(rank);
+            rank += popCount(masks.surface[word]);
+        }
+
+        brick.masks = static_cast<boost::uint32_t>(m_masks.size());
+        m_masks.push_back(masks);
+
+        brick.mode = maxDistance / T(255) <= maxShift * minGap ? BRICK_8BIT : BRICK_16BIT;
+        T maxCode = brick.mode == BRICK_8BIT ? T(255) : T(65535);
+
+        ///Not so small that iso + step rounds back to the iso value.
+        brick.step = std::max(maxDistance / maxCode, minStep);
+
+        brick.offset = static_cast<boost::uint32_t>(brick.mode == BRICK_8BIT ? m_data.size() : m_data.size() / 2);
+        if(brick.mode == BRICK_16BIT && (m_data.size() & 1))
+        {
+            m_data.push_back(0);
+            brick.offset++;
+        }
+
+        std::size_t surfaceIndex = 0;
+        for(std::size_t cell = 0; cell < xSize * ySize * zSize; cell++)
+        {
+            if(!(masks.surface[cell >> 6] & (boost::uint64_t(1) << (cell & 63))))
+            {
+                continue;
+            }
+
+            bool solid = (masks.solid[cell >> 6] & (boost::uint64_t(1) << (cell & 63))) != 0;
+
+            ///Empty cells must stay above the iso value, so never code 0 for them.
+            T code = std::floor(distances[surfaceIndex++] / brick.step + T(0.5));
+            code = std::min(code, maxCode);
+            if(!solid && code < T(1))
+            {
+                code = T(1);
+            }
+
+            boost::uint16_t bits = static_cast<boost::uint16_t>(code);
+            m_data.push_back(static_cast<boost::uint8_t>(bits & 0xff));
+            if(brick.mode == BRICK_16BIT)
+            {
+                m_data.push_back(static_cast<boost::uint8_t>(bits >> 8));
+            }
+        }
+    }
+
+    ///Give back the slack from growing the vectors, this object is meant to live long.
+    std::vector<BrickMasks>(m_masks).swap(m_masks);
+    std::vector<boost::uint8_t>(m_data).swap(m_data);
+}
+
+
+template<class T>
+TCompressedVolume3d<T>::~TCompressedVolume3d()
+{
+
+}
+
+
+template<class T>
+__inline unsigned int TCompressedVolume3d<T>::popCount(boost::uint64_t bits)
+{
+    bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<unsigned int>((bits * 0x0101010101010101ULL) >> 56);
+}
+
+
+template<class T>
+__inline unsigned int TCompressedVolume3d<T>::lowestBit(boost::uint64_t lowest)
+{
+    ///Index of the only set bit: the de Bruijn multiply puts a unique pattern in the top 6 bits.
+    static const boost::uint8_t indices[64] =
+    {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+    };
+
+    assert(lowest && !(lowest & (lowest - 1)));
+    return indices[(lowest * 0x03f79d71b4cb0a89ULL) >> 58];
+}
+
+
+template<class T>
+__inline const typename TCompressedVolume3d<T>::Brick& TCompressedVolume3d<T>::getBrick(std::size_t x, std::size_t y, std::size_t z) const
+{
+    std::size_t index = ((y >> BRICK_SHIFT) * m_zBricks + (z >> BRICK_SHIFT)) * m_xBricks + (x >> BRICK_SHIFT);
+    assert(index < m_bricks.size());
+
+    return m_bricks[index];
+}
+
+
+template<class T>
+__inline T TCompressedVolume3d<T>::readSurface(const Brick& brick, bool solid, std::size_t rank) const
+{
+    T code;
+    if(brick.mode == BRICK_8BIT)
+    {
+        code = T(m_data[brick.offset + rank]);
+    }
+    else
+    {
+        const boost::uint8_t* data = &m_data[(brick.offset + rank) << 1];
+        code = T(data[0] | (data[1] << 8));
+    }
+
+    return solid ? m_isoValue - code * brick.step : m_isoValue + code * brick.step;
+}
+
+
+template<class T>
+__inline T TCompressedVolume3d<T>::readCell(const Brick& brick, std::size_t local) const
+{
+    if(brick.mode == BRICK_UNIFORM)
+    {
+        return brick.step;
+    }
+
+    const BrickMasks& masks = m_masks[brick.masks];
+
+    std::size_t word = local >> 6;
+    boost::uint64_t bit = boost::uint64_t(1) << (local & 63);
+    bool solid = (masks.solid[word] & bit) != 0;
+
+    if(!(masks.surface[word] & bit))
+    {
+        return solid ? m_isoValue - m_range : m_isoValue + m_range;
+    }
+
+    return readSurface(brick, solid, masks.rank[word] + popCount(masks.surface[word] & (bit - 1)));
+}
+
+
+template<class T>
+__inline T TCompressedVolume3d<T>::operator()(std::size_t x, std::size_t y, std::size_t z) const
+{
+    assert(x < m_xSize && y < m_ySize && z < m_zSize);
+
+    const Brick& brick = getBrick(x, y, z);
+
+    std::size_t lx = x & (BRICK_SIZE - 1);
+    std::size_t ly = y & (BRICK_SIZE - 1);
+    std::size_t lz = z & (BRICK_SIZE - 1);
+
+    return readCell(brick, (ly * brick.zSize + lz) * brick.xSize + lx);
+}
+
+
+template<class T>
+void TCompressedVolume3d<T>::decode(TVolume3d<T>& out) const
+{
+    assert(out.m_xSize == m_xSize && out.m_ySize == m_ySize && out.m_zSize == m_zSize);
+
+    ///Walk brick by brick so the mode switch happens once per brick, not per cell.
+    std::size_t brickIndex = 0;
+    for(std::size_t by = 0; by < m_yBricks; by++)
+    for(std::size_t bz = 0; bz < m_zBricks; bz++)
+    for(std::size_t bx = 0; bx < m_xBricks; bx++, brickIndex++)
+    {
+        const Brick& brick = m_bricks[brickIndex];
+
+        std::size_t x0 = bx << BRICK_SHIFT;
+        std::size_t y0 = by << BRICK_SHIFT;
+        std::size_t z0 = bz << BRICK_SHIFT;
+
+        std::size_t ySize = std::min(BRICK_SIZE, m_ySize - y0);
+
+        if(brick.mode == BRICK_UNIFORM)
+        {
+            for(std::size_t y = 0; y < ySize; y++)
+            for(std::size_t z = 0; z < brick.zSize; z++)
+            {
+                T* row = &out(x0, y0 + y, z0 + z);
+                std::fill(row, row + brick.xSize, brick.step);
+            }
+            continue;
+        }
+
+        const BrickMasks& masks = m_masks[brick.masks];
+
+        const boost::uint8_t* codes = &m_data[brick.mode == BRICK_8BIT ? brick.offset : brick.offset << 1];
+        bool wide = brick.mode == BRICK_16BIT;
+
+        ///Copies, the stores to out could alias the members as far as the compiler knows.
+        const T isoValue = m_isoValue;
+        const T range = m_range;
+        const T step = brick.step;
+
+        ///The bits follow the surface and mispredict as branches, so every cell first gets the value
+        /// of its side without branching on them, then the surface cells are visited bit by bit.
+        const T sides[2] = { isoValue + range, isoValue - range };
+        const T steps[2] = { step, -step };
+        T* rows[BRICK_SIZE * BRICK_SIZE];
+        std::size_t rowCount = 0;
+        std::size_t local = 0;
+        for(std::size_t y = 0; y < ySize; y++)
+        for(std::size_t z = 0; z < brick.zSize; z++)
+        {
+            T* row = &out(x0, y0 + y, z0 + z);
+            rows[rowCount++] = row;
+
+            for(std::size_t x = 0; x < brick.xSize; x++, local++)
+            {
+                row[x] = sides[(masks.solid[local >> 6] >> (local & 63)) & 1];
+            }
+        }
+
+        ///Surface cells come in code order.
+        std::size_t rank = 0;
+        for(std::size_t word = 0; word < MASK_WORDS; word++)
+        {
+            boost::uint64_t bits = masks.surface[word];
+            while(bits)
+            {
+                boost::uint64_t lowest = bits & (~bits + 1);
+                bits ^= lowest;
+
+                std::size_t cell = (word << 6) + lowestBit(lowest);
+                std::size_t solid = (masks.solid[word] & lowest) ? 1 : 0;
+
+                unsigned int code = wide ? (codes[rank << 1] | (codes[(rank << 1) + 1] << 8)) : codes[rank];
+                rank++;
+
+                ///Only bricks on the far x border are narrower, the rest get away without the division.
+                std::size_t row = brick.xSize == BRICK_SIZE ? cell >> BRICK_SHIFT : cell / brick.xSize;
+                rows[row][cell - row * brick.xSize] = isoValue + T(code) * steps[solid];
+            }
+        }
+    }
+}
+
+
+template<class T>
+std::size_t TCompressedVolume3d<T>::getMemoryUsage() const
+{
+    return sizeof(*this) + m_bricks.capacity() * sizeof(Brick) + m_masks.capacity() * sizeof(BrickMasks) + m_data.capacity();
+}
+
+#endif
@@ -22,6 +22,9 @@ public:
 
     void clear();
 
+    ///Bytes held by this object.
+    std::size_t getMemoryUsage() const;
+
     const std::size_t toIndex(std::size_t x, std::size_t y, std::size_t z) const;
     void fromIndex(std::size_t &x, std::size_t &y, std::size_t &z, std::size_t index) const;
 
@@ -138,6 +141,13 @@ void TVolume3d<T>::clear()
 }
 
 
+template<class T>
+std::size_t TVolume3d<T>::getMemoryUsage() const
+{
+    return sizeof(*this) + m_xyzSize * sizeof(T);
+}
+
+
 template<class T>
 __inline const std::size_t TVolume3d<T>::toIndex(std::size_t x, std::size_t y, std::size_t z) const 
 {
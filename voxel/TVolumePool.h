@@ -1,90 +1,233 @@
 #pragma once
-#include <memory>
-#include <thread>
+#include <map>
+#include <algorithm>
+#include <vector>
 #include <mutex>
-#include <queue>
-#include <boost/utility.hpp>
-
-
-
-template<class T>
-class TVolumePool
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+
+///Thread safe pool of reusable objects, meant for big buffers like TVolume3d.
+///
+///Objects are grouped by size class (Key). pop(key) hands out a free object of that class or
+/// creates a new one with the generator. The returned shared_ptr puts the object back into
+/// its class when the last reference goes away, from whatever thread that happens on. Objects
+/// released after the pool is destroyed are just deleted.
+///
+///Free objects are kept until trim() is called. trim() keeps, per class, only as many objects
+/// as were in use at the same time since the previous trim (the high watermark) and deletes
+/// the rest, so calling it periodically gives back memory after a burst.
+template<class T, class Key>
+class TVolumePool : boost::noncopyable
 {
 public:
-    typedef std::function< std::shared_ptr<T>() > generator_f;
+    typedef boost::function< T* (const Key&) > generator_f;
+
+    struct Stats
+    {
+        ///pop() calls served from a free list.
+        std::size_t m_hits;
+        ///pop() calls that had to create an object.
+        std::size_t m_misses;
+        ///Objects deleted by trim().
+        std::size_t m_trimmed;
+        ///Objects currently handed out.
+        std::size_t m_usedObjectCount;
+        ///Objects waiting in the free lists.
+        std::size_t m_freeObjectCount;
+    };
 
     TVolumePool(generator_f generatorFunc);
     ~TVolumePool();
 
-    std::shared_ptr<T> pop();
-
-    //we can pass this in by reference, instead of copying
-    void push(const std::shared_ptr<T>& object);
+    boost::shared_ptr<T> pop(const Key& sizeClass);
 
-    std::size_t size();
+    ///Deletes free objects above the high watermark of each class, returns how many.
+    std::size_t trim();
 
-    std::size_t m_objectCount;
-    std::size_t m_usedObjectCount;
-	
+    Stats getStats();
 
 protected:
-    std::queue< std::shared_ptr<T> >	m_queue;
-    std::mutex		m_mutex;
-    //generator_f& m_generatorFunc;
-    generator_f m_generatorFunc2;
+    struct SizeClass
+    {
+        SizeClass() : m_usedObjectCount(0), m_peakUsedObjectCount(0) {}
+
+        std::vector<T*> m_free;
+        std::size_t m_usedObjectCount;
+        std::size_t m_peakUsedObjectCount;
+    };
+
+    ///Shared with the deleters of the handed out objects, so they can outlive the pool.
+    struct State : boost::noncopyable
+    {
+        State(generator_f generatorFunc);
+        ~State();
+
+        void release(const Key& sizeClass, T* object);
+
+        std::map<Key, SizeClass> m_classes;
+        std::mutex m_mutex;
+        generator_f m_generatorFunc;
+        Stats m_stats;
+    };
+
+    struct Recycler
+    {
+        Recycler(const boost::shared_ptr<State>& state, const Key& sizeClass) : m_state(state), m_sizeClass(sizeClass) {}
+
+        void operator()(T* object);
+
+        boost::weak_ptr<State> m_state;
+        Key m_sizeClass;
+    };
+
+    boost::shared_ptr<State> m_state;
 };
 
-template <class T>
-TVolumePool<T>::TVolumePool(generator_f generatorFunc) 
-    : m_generatorFunc2(generatorFunc), 
-    m_usedObjectCount(0), 
-    m_objectCount(0)
-{
 
-    m_generatorFunc2();
+template <class T, class Key>
+TVolumePool<T, Key>::State::State(generator_f generatorFunc)
+    : m_generatorFunc(generatorFunc)
+{
+    m_stats.m_hits = 0;
+    m_stats.m_misses = 0;
+    m_stats.m_trimmed = 0;
+    m_stats.m_usedObjectCount = 0;
+    m_stats.m_freeObjectCount = 0;
 }
 
-template <class T>
-std::size_t TVolumePool<T>::size() 
+template <class T, class Key>
+TVolumePool<T, Key>::State::~State()
 {
-    std::lock_guard<std::mutex> lock( m_mutex);
-    return  m_queue.size();
+    for(auto& sizeClass : m_classes)
+    {
+        for(auto object : sizeClass.second.m_free)
+        {
+            delete object;
+        }
+    }
 }
 
-
-template <class T>
-TVolumePool<T>::~TVolumePool() 
+template <class T, class Key>
+void TVolumePool<T, Key>::State::release(const Key& sizeClass, T* object)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    SizeClass& objects = m_classes[sizeClass];
+    objects.m_usedObjectCount--;
+    objects.m_free.push_back(object);
 
+    m_stats.m_usedObjectCount--;
+    m_stats.m_freeObjectCount++;
+}
 
+template <class T, class Key>
+void TVolumePool<T, Key>::Recycler::operator()(T* object)
+{
+    boost::shared_ptr<State> state = m_state.lock();
+
+    if(state)
+    {
+        state->release(m_sizeClass, object);
+    }
+    else
+    {
+        delete object;
+    }
 }
 
 
-template <class T>
-std::shared_ptr<T> TVolumePool<T>::pop() 
+template <class T, class Key>
+TVolumePool<T, Key>::TVolumePool(generator_f generatorFunc)
+    : m_state(boost::make_shared<State>(generatorFunc))
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-    m_usedObjectCount++;
-	if( m_queue.empty())
-	{
-        m_objectCount++;
-        auto& object = m_generatorFunc2();
-		return object;
-	}
 
-	std::shared_ptr<T> result =  m_queue.front();
+}
+
+template <class T, class Key>
+TVolumePool<T, Key>::~TVolumePool()
+{
 
-	m_queue.pop();
+}
 
-	return result;
+template <class T, class Key>
+boost::shared_ptr<T> TVolumePool<T, Key>::pop(const Key& sizeClass)
+{
+    T* object = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
+
+        SizeClass& objects = m_state->m_classes[sizeClass];
+        objects.m_usedObjectCount++;
+        objects.m_peakUsedObjectCount = std::max(objects.m_peakUsedObjectCount, objects.m_usedObjectCount);
+
+        m_state->m_stats.m_usedObjectCount++;
+
+        if(!objects.m_free.empty())
+        {
+            object = objects.m_free.back();
+            objects.m_free.pop_back();
+
+            m_state->m_stats.m_freeObjectCount--;
+            m_state->m_stats.m_hits++;
+        }
+        else
+        {
+            m_state->m_stats.m_misses++;
+        }
+    }
+
+    //Creating a new object can be slow, don't hold the lock for it.
+    if(!object)
+    {
+        object = m_state->m_generatorFunc(sizeClass);
+    }
+
+    return boost::shared_ptr<T>(object, Recycler(m_state, sizeClass));
 }
 
-template <class T>
-void TVolumePool<T>::push(const std::shared_ptr<T>& object) 
+template <class T, class Key>
+std::size_t TVolumePool<T, Key>::trim()
 {
+    std::vector<T*> trimmed;
+
+    {
+        std::lock_guard<std::mutex> lock(m_state->m_mutex);
 
-	std::lock_guard<std::mutex> lock( m_mutex);
-    m_usedObjectCount--;
-	m_queue.push(object);
+        for(auto& sizeClass : m_state->m_classes)
+        {
+            SizeClass& objects = sizeClass.second;
+
+            std::size_t keep = objects.m_peakUsedObjectCount - objects.m_usedObjectCount;
+
+            while(objects.m_free.size() > keep)
+            {
+                trimmed.push_back(objects.m_free.back());
+                objects.m_free.pop_back();
+            }
+
+            objects.m_peakUsedObjectCount = objects.m_usedObjectCount;
+        }
+
+        m_state->m_stats.m_freeObjectCount -= trimmed.size();
+        m_state->m_stats.m_trimmed += trimmed.size();
+    }
+
+    for(auto object : trimmed)
+    {
+        delete object;
+    }
+
+    return trimmed.size();
 }
 
+template <class T, class Key>
+typename TVolumePool<T, Key>::Stats TVolumePool<T, Key>::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_state->m_mutex);
+    return m_state->m_stats;
+}
@@ -23,6 +23,14 @@ module_ptr_t handle_ridged_multi2d(noisepp::Pipeline2D& pipeline,
                               const tinyxml2::XMLElement& element,
                               const child_modules_t& child_modules);
 
+module_ptr_t handle_simplex2d(noisepp::Pipeline2D& pipeline,
+                              const tinyxml2::XMLElement& element,
+                              const child_modules_t& child_modules);
+
+module_ptr_t handle_ridged_simplex2d(noisepp::Pipeline2D& pipeline,
+                              const tinyxml2::XMLElement& element,
+                              const child_modules_t& child_modules);
+
 
 
 
@@ -2,10 +2,61 @@
 
 #include "xml_noise_decls.hpp"
 
+#include "../noisepp/utils/NoiseOutStream.h"
+#include "../noisepp/utils/NoiseInStream.h"
+#include "../noisepp/utils/NoiseReader.h"
+#include "../noisepp/utils/NoiseEndianUtils.h"
+#include "../noisepp/utils/NoiseUtils.h"
+
+#include <boost/lexical_cast.hpp>
+
+#include <fstream>
+#include <cstring>
+
+#ifdef _WIN32
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   include <windows.h>
+#else
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+
+//Bump this whenever the hashed layout changes, so old hashes never match new ones.
+static const unsigned char module_hash_version = 1;
+
+static void hash_module(noisepp::utils::HashOutStream& stream, const module_t* module)
+{
+    assert(module);
+
+    //Module::write() is what the Writer uses to serialize the parameters, so anything that
+    // changes the noise also changes the hash.
+    unsigned short type_id = module->getType();
+    stream.write(type_id);
+    module->write(stream);
+
+    unsigned int child_count = static_cast<unsigned int>(module->getSourceModuleCount());
+    stream.write(child_count);
+
+    //Children in order; swapping the inputs of a select or blend is a different graph.
+    for (std::size_t i = 0; i < child_count; ++i)
+    {
+        hash_module(stream, module->getSourceModule(i));
+    }
+}
+
 
 xml_noise3d_t::xml_noise3d_t(noisepp::Pipeline3D& pipeline)
     : pipeline(pipeline)
     , root(NULL)
+    , root_hash(0)
+    , source_hash(0)
+    , keep_paths(false)
+    , dispatch(NULL)
 {
 
 }
@@ -118,17 +169,7 @@ void xml_noise3d_t::load(const std::string& xml_file_name)
     tinyxml2::XMLDocument doc;
     doc.LoadFile(xml_file_name.c_str());
 
-    //We will traverse the tree using "post-order depth first search/traversal", with a nice clever stack-free DFS algorithm.
-    // Why post order DFS? Because post order DFS ensures that we only visit a node once we already visited all it's children.
-    // This means when we create the noisepp module for an xml element, we already have the child modules
-    // ready! (if there are any), because we already visited all its children.
-
-    //We will have two cursors, one for the "current" node, and one for the "previous" node.
-    // This will allow us to know if we are "headed" down, sideways, or up the tree.
-    // DFS will only visit a node when there is nothing below it, or all the nodes below
-    // it have already been visited. Using the previous pointer, we can differentiate between
-    // visiting a node for the first time on the way down, or on the way up, *after having visited
-    // all the children*.
+    source_hash = hash_source(xml_file_name);
 
     XMLElement* root_noise_element = doc.FirstChildElement("noise");
 
@@ -137,154 +178,38 @@ void xml_noise3d_t::load(const std::string& xml_file_name)
         throw xml_noise_error_t("no 'noise' element at the root");
 
     XMLElement* current = root_noise_element->FirstChildElement();
-    XMLElement* previous = NULL;
-    
     
-    if (!current)
+    if (!current || current->NextSiblingElement())
         //TODO: inherit from 
         throw xml_noise_error_t("'noise' element must have one and only one child");
-    
-    
-    while (true) {
-        //sanity check
-        assert(current);
-        
-        if (current == root_noise_element)
-            break;
-        
-        //If the previous ptr is null, then we are at the first step, a special case.
-        if (!previous)
-        {
-            //Get the first child element, move down to it.
-            XMLElement* child = current->FirstChildElement();
-
-            if (child)
-            {
-                //If there is a child,
-
-                //Move down to child, and set the vars appropriately.
-                previous = current;
-                current = child;
-
-                continue;
-            } else {
-                //There is no child, this tree only has the root, visit the root.
-                visit(*current);
-                break;
-            }
-        }
-        
-        //sanity check
-        assert(previous);
-
-        XMLElement* child = current->FirstChildElement();
-        XMLElement* next_sibling = current->NextSiblingElement();
-        XMLNode* parent_node = current->Parent();
-        XMLElement* parent = NULL;
-
-        if (parent_node)
-            parent = parent_node->ToElement();
-
-        bool heading_down = (current->Parent() == previous);
-        bool heading_up = (previous->Parent() == current);
-        bool heading_right = (previous->NextSiblingElement() == current);
-
-        //logical xor all 3 directions; we can only be headed in one direction.
-        // bool != bool is equivalent to logical xor.
-        // logical xor is also associative, so it can be "nested" like this. I think.
-        assert((heading_down != heading_up) != heading_right);
-
-        bool has_child = !!(child);
-        bool has_next_sibling = !!(next_sibling);
-        bool has_parent = !!(parent);
-
-        bool move_down = !heading_up && has_child;
-        bool move_right = (heading_up || !has_child) && has_next_sibling;
-        bool move_up = has_parent
-             && (      (heading_up && !has_next_sibling)
-                    || (heading_right && !has_child && !has_next_sibling)
-                    || (heading_down && !has_child && !has_next_sibling) );
-
-        /*
-        std::cerr << std::endl << std::endl
-            << "------" << std::endl;
-        std::cerr << "heading_up: " << heading_up << std::endl;
-        std::cerr << "heading_down: " << heading_down << std::endl;
-        std::cerr << "heading_right: " << heading_right << std::endl;
-        std::cerr << "has_child: " << has_child << std::endl;
-        std::cerr << "has_next_sibling: " << has_next_sibling << std::endl;
-        std::cerr << "has_parent: " << has_parent << std::endl;
-        
-        
-        
-        std::cerr << "move_down: " << move_down << std::endl;
-        std::cerr << "move_right: " << move_right << std::endl;
-        std::cerr << "move_up: " << move_up << std::endl;
-        
-        
-        std::cerr << "(heading_up && !has_next_sibling): " << (heading_up && !has_next_sibling) << std::endl;
-        std::cerr << "(!heading_up && !has_child && !has_next_sibling): "
-            << (!heading_up && !has_child && !has_next_sibling) << std::endl;
-        std::cerr
-            << "------"
-            << std::endl << std::endl
-            << std::endl;
-        */
-        
-        //Another way of writing this (so we double checking with assertion):
-        //assert( move_up == has_parent && !move_down && !move_right );
-        //Another way of writing this (so we double checking with assertion):
-        assert( move_up == (has_parent
-             && (      (heading_up && !has_next_sibling)
-                    || (!heading_up && !has_child && !has_next_sibling) ) ));
-
-        bool move_done = !has_parent
-             && (      (heading_up && !has_next_sibling)
-                    || (!has_child && !has_next_sibling) );
-
-        //logical xor all four moves; we can only move one direction.
-        // bool != bool is equivalent to logical xor.
-        // logical xor is also associative, so it can be "nested" like this. I think.
-        assert( ((move_down != move_right) != move_up) != move_done);
-
-        bool visit_current = (move_right || move_up || move_done);
-
-        if (visit_current)
-            visit(*current);
-
-        if (move_done) {
-            break;
-        } else if (move_down) {
-            assert(child);
-
-            previous = current;
-            current = child;
-
-            continue;
-        } else if (move_right) {
-            assert(next_sibling);
-
-            previous = current;
-            current = next_sibling;
 
-            continue;
-        } else if (move_up) {
-            assert(parent);
+    //One pass with a visitor, in "post-order depth first search/traversal": VisitExit() of an
+    // element comes after all its children, so their modules are already on argument_stack when
+    // we create the noisepp module for it. VisitEnter() remembers where those start.
+    tag_dispatch_t<handlers3d_t> tag_dispatch(handlers);
+    dispatch = &tag_dispatch;
 
-            previous = current;
-            current = parent;
+    argument_stack.clear();
+    argument_starts.clear();
+    path_stack.clear();
 
-            continue;
-        }
+    current->Accept(this);
 
-    }
+    dispatch = NULL;
 
     //After all this traversal, we should be left with 1 and only 1 argument/module on the
     // argument stack.
     assert(argument_stack.size() == 1);
-    root = argument_stack.top();
+    root = argument_stack.back();
+
+    argument_stack.clear();
 
-    argument_stack.pop();
+    //The pipeline seed gets added to every module seed in addToPipeline, so it is part of the hash too.
+    noisepp::utils::HashOutStream hash_stream;
+    hash_stream.write(module_hash_version);
+    hash_stream.writeInt(pipeline.getSeed());
+    hash_module(hash_stream, root);
+    root_hash = hash_stream.getHash();
 
     //WARNING: you must add root to pipeline yourself outside this class.
     // This is because I am unsure if I must add every element to the pipeline, or just root;
@@ -293,59 +218,83 @@ void xml_noise3d_t::load(const std::string& xml_file_name)
 }
 
 
-void xml_noise3d_t::visit(const tinyxml2::XMLElement& element)
+void xml_noise3d_t::optimize()
 {
-    using namespace tinyxml2;
-    using namespace noisepp;
+    assert(root);
 
-    std::string name = element.Name();
+    //root_hash stays the hash of the loaded graph; the optimized one computes the same noise.
+    root = optimize_noise_graph(root, module_ptrs, optimize_stats);
+}
 
-    
-    handlers3d_t::const_iterator w = handlers.find(name);
 
-    //if the handler name isn't found
-    if (w == handlers.end()) {
-        throw xml_noise_unknown_handler_error_t(name);
-    }
+bool xml_noise3d_t::VisitEnter(const tinyxml2::XMLElement& element, const tinyxml2::XMLAttribute* first_attribute)
+{
+    argument_starts.push_back(argument_stack.size());
 
+    if (keep_paths)
+    {
+        std::string path = path_stack.empty() ? "noise" : path_stack.back();
+        path += '/';
+        path += element.Name();
 
+        std::size_t index = 0;
+        const tinyxml2::XMLElement* sibling = element.PreviousSiblingElement(element.Name());
+        for (; sibling; sibling = sibling->PreviousSiblingElement(element.Name()))
+            ++index;
 
-    std::size_t child_count = 0;
+        if (index || element.NextSiblingElement(element.Name()))
+            path += "[" + boost::lexical_cast<std::string>(index) + "]";
 
-    //Count children
-    {
-        const XMLElement* child = element.FirstChildElement();
-        while(child){ child = child->NextSiblingElement(); ++child_count; }
+        path_stack.push_back(path);
     }
-    
-    //There should be this many finished modules on the stack
-    assert( child_count <= argument_stack.size());
 
-    //We setup the arguments for the handler.
-    child_modules_t arguments(child_count, NULL);
+    return true;
+}
+
+bool xml_noise3d_t::VisitExit(const tinyxml2::XMLElement& element)
+{
+    visit(element);
 
-    //Take the arguments off the stack.
-    for (std::size_t i = 0; i < child_count; ++i)
+    if (keep_paths)
     {
-        //this is backwards, for brevity, we will reverse it later.
-        arguments[i] = argument_stack.top();
-        argument_stack.pop();
+        module_paths[argument_stack.back()] = path_stack.back();
+        path_stack.pop_back();
     }
 
+    return true;
+}
 
-    //We store them off in reverse order: last first. We need to get them in the correct order.
-    std::reverse(arguments.begin(),arguments.end());
-    
-    const tag_handler3d_t& handler = w->second;
+void xml_noise3d_t::visit(const tinyxml2::XMLElement& element)
+{
+    using namespace tinyxml2;
+    using namespace noisepp;
+
+    const tag_handler3d_t* handler = dispatch->find(element.Name());
+
+    //if the handler name isn't found
+    if (!handler) {
+        throw xml_noise_unknown_handler_error_t(element.Name());
+    }
+
+    //Everything pushed since VisitEnter() of this element are the modules of its children,
+    // already in document order.
+    std::size_t first_argument = argument_starts.back();
+    argument_starts.pop_back();
+
+    assert(first_argument <= argument_stack.size());
+
+    //We setup the arguments for the handler, in a buffer that is reused for every element.
+    arguments.assign(argument_stack.begin() + first_argument, argument_stack.end());
+    argument_stack.resize(first_argument);
 
     //Call the handler, which will return a noise++ module as a result.
-    module_ptr_t module_ptr = handler(pipeline, element, arguments);
+    module_ptr_t module_ptr = (*handler)(pipeline, element, arguments);
 
     //Save this on the ptr_list, so it gets owned, and eventually deleted.
     module_ptrs.push_back(module_ptr);
 
     //Now push this result back on the argument stack, for use by its parent.
-    argument_stack.push(module_ptr);
+    argument_stack.push_back(module_ptr);
 
     
     const char* id = element.Attribute("id");
@@ -355,9 +304,385 @@ void xml_noise3d_t::visit(const tinyxml2::XMLElement& element)
     if (id)
     {
         if (special_nodes.count(id))
-            throw xml_noise_duplicate_id_error_t(name,id);
+            throw xml_noise_duplicate_id_error_t(element.Name(),id);
 
         //Let the user of this class be able to retrieve this element via its unique id.
         special_nodes[id] = module_ptr;
     }
 }
+
+
+//Compiled graph files, see save_compiled(). Everything is little endian and the tables start
+// 4 byte aligned, so they are read straight out of the mapped file:
+//
+//  header                                              56 bytes
+//  module records, every child before its parents      16 bytes each
+//  source module indices, in child order                4 bytes each
+//  id records                                          12 bytes each
+//  parameters, Module::write() of every module
+//  id names, not 0 terminated
+//
+//The header holds the magic, compiled_version, NOISE_FILE_VERSION, the pipeline seed, root_hash
+// and source_hash, followed by the module count, root index, source count, id count and the byte
+// sizes of the parameter and name blocks.
+static const char compiled_magic[4] = {'N', 'P', 'G', '3'};
+
+//Bump this whenever the layout above changes.
+static const unsigned int compiled_version = 2;
+
+static const std::size_t compiled_header_size = 56;
+static const std::size_t compiled_module_size = 16;
+static const std::size_t compiled_source_size = 4;
+static const std::size_t compiled_id_size = 12;
+
+template <class T>
+static void put_compiled(std::vector<char>& buffer, T t)
+{
+    noisepp::utils::EndianUtils::flipEndian(&t, sizeof(T));
+    const char* bytes = reinterpret_cast<const char*>(&t);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template <class T>
+static T get_compiled(const char* data, unsigned long long offset)
+{
+    T t;
+    std::memcpy(&t, data + offset, sizeof(T));
+    noisepp::utils::EndianUtils::flipEndian(&t, sizeof(T));
+    return t;
+}
+
+//Numbers the modules under module children first, shared ones once.
+static void collect_compiled(const module_t* module,
+                             std::map<const module_t*, unsigned int>& indices,
+                             std::vector<const module_t*>& modules)
+{
+    assert(module);
+
+    if (indices.count(module))
+        return;
+
+    for (std::size_t i = 0; i < module->getSourceModuleCount(); ++i)
+    {
+        collect_compiled(module->getSourceModule(i), indices, modules);
+    }
+
+    indices[module] = static_cast<unsigned int>(modules.size());
+    modules.push_back(module);
+}
+
+//Read only view of a whole file, mapped rather than read so the OS pages it in on demand.
+struct compiled_file_mapping_t
+    : boost::noncopyable
+{
+    explicit compiled_file_mapping_t(const std::string& file_name);
+    ~compiled_file_mapping_t();
+
+    const char* data;
+    std::size_t size;
+
+private:
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+};
+
+#ifdef _WIN32
+
+compiled_file_mapping_t::compiled_file_mapping_t(const std::string& file_name)
+    : data(NULL)
+    , size(0)
+    , file(INVALID_HANDLE_VALUE)
+    , mapping(NULL)
+{
+    file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw xml_noise_error_t("Can't open compiled noise file " + file_name);
+
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mapping)
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+    if (!data)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        throw xml_noise_error_t("Can't map compiled noise file " + file_name);
+    }
+
+    size = static_cast<std::size_t>(file_size.QuadPart);
+}
+
+compiled_file_mapping_t::~compiled_file_mapping_t()
+{
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+#else
+
+compiled_file_mapping_t::compiled_file_mapping_t(const std::string& file_name)
+    : data(NULL)
+    , size(0)
+    , file(-1)
+{
+    file = open(file_name.c_str(), O_RDONLY);
+    if (file < 0)
+        throw xml_noise_error_t("Can't open compiled noise file " + file_name);
+
+    struct stat file_stat;
+    void* view = MAP_FAILED;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+        view = mmap(NULL, static_cast<std::size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+    if (view == MAP_FAILED)
+    {
+        close(file);
+        throw xml_noise_error_t("Can't map compiled noise file " + file_name);
+    }
+
+    data = static_cast<const char*>(view);
+    size = static_cast<std::size_t>(file_stat.st_size);
+}
+
+compiled_file_mapping_t::~compiled_file_mapping_t()
+{
+    munmap(const_cast<char*>(data), size);
+    close(file);
+}
+
+#endif
+
+
+void xml_noise3d_t::save_compiled(const std::string& compiled_file_name) const
+{
+    assert(root);
+
+    std::map<const module_t*, unsigned int> indices;
+    std::vector<const module_t*> modules;
+    collect_compiled(root, indices, modules);
+
+    std::vector<char> records;
+    std::vector<char> sources;
+    noisepp::utils::MemoryOutStream params;
+
+    unsigned int source_count = 0;
+
+    for (std::size_t i = 0; i < modules.size(); ++i)
+    {
+        const module_t* module = modules[i];
+
+        unsigned int param_offset = static_cast<unsigned int>(params.tell());
+        module->write(params);
+        unsigned int param_size = static_cast<unsigned int>(params.tell()) - param_offset;
+
+        unsigned short child_count = static_cast<unsigned short>(module->getSourceModuleCount());
+
+        put_compiled(records, static_cast<unsigned short>(module->getType()));
+        put_compiled(records, child_count);
+        put_compiled(records, source_count);
+        put_compiled(records, param_offset);
+        put_compiled(records, param_size);
+
+        for (unsigned short j = 0; j < child_count; ++j)
+        {
+            put_compiled(sources, indices[module->getSourceModule(j)]);
+        }
+        source_count += child_count;
+    }
+
+    //Ids of modules the optimizer replaced have nothing to point at in the compiled graph.
+    std::vector<char> ids;
+    std::string names;
+    unsigned int id_count = 0;
+
+    for (std::map<std::string, module_ptr_t>::const_iterator w = special_nodes.begin(); w != special_nodes.end(); ++w)
+    {
+        std::map<const module_t*, unsigned int>::const_iterator index = indices.find(w->second);
+        if (index == indices.end())
+            continue;
+
+        put_compiled(ids, index->second);
+        put_compiled(ids, static_cast<unsigned int>(names.size()));
+        put_compiled(ids, static_cast<unsigned int>(w->first.size()));
+        names += w->first;
+        ++id_count;
+    }
+
+    std::vector<char> header(compiled_magic, compiled_magic + sizeof(compiled_magic));
+    put_compiled(header, compiled_version);
+    put_compiled(header, static_cast<unsigned int>(NOISE_FILE_VERSION));
+    put_compiled(header, pipeline.getSeed());
+    put_compiled(header, root_hash);
+    put_compiled(header, source_hash);
+    put_compiled(header, static_cast<unsigned int>(modules.size()));
+    put_compiled(header, indices[root]);
+    put_compiled(header, source_count);
+    put_compiled(header, id_count);
+    put_compiled(header, static_cast<unsigned int>(params.getBufferSize()));
+    put_compiled(header, static_cast<unsigned int>(names.size()));
+    assert(header.size() == compiled_header_size);
+
+    std::ofstream file(compiled_file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write(&header[0], header.size());
+    file.write(&records[0], records.size());
+    if (!sources.empty())
+        file.write(&sources[0], sources.size());
+    if (!ids.empty())
+        file.write(&ids[0], ids.size());
+    file.write(params.getBuffer(), params.getBufferSize());
+    file.write(names.data(), names.size());
+
+    if (!file)
+        throw xml_noise_error_t("Can't write compiled noise file " + compiled_file_name);
+}
+
+
+void xml_noise3d_t::load_compiled(const std::string& compiled_file_name)
+{
+    compiled_file_mapping_t file(compiled_file_name);
+    const char* data = file.data;
+
+    const std::string corrupt = compiled_file_name + " is a truncated or corrupt compiled noise file";
+
+    if (file.size < compiled_header_size || std::memcmp(data, compiled_magic, sizeof(compiled_magic)) != 0)
+        throw xml_noise_error_t(compiled_file_name + " is not a compiled noise file");
+
+    if (get_compiled<unsigned int>(data, 4) != compiled_version
+        || get_compiled<unsigned int>(data, 8) != NOISE_FILE_VERSION)
+        throw xml_noise_error_t(compiled_file_name + " was compiled by another version, recompile it");
+
+    int seed = get_compiled<int>(data, 12);
+    unsigned long long compiled_hash = get_compiled<unsigned long long>(data, 16);
+    unsigned long long compiled_source_hash = get_compiled<unsigned long long>(data, 24);
+    unsigned int module_count = get_compiled<unsigned int>(data, 32);
+    unsigned int root_index = get_compiled<unsigned int>(data, 36);
+    unsigned int source_count = get_compiled<unsigned int>(data, 40);
+    unsigned int id_count = get_compiled<unsigned int>(data, 44);
+    unsigned int param_bytes = get_compiled<unsigned int>(data, 48);
+    unsigned int name_bytes = get_compiled<unsigned int>(data, 52);
+
+    //64 bit offsets, so a corrupt count can't wrap around and pass the size check.
+    unsigned long long modules_offset = compiled_header_size;
+    unsigned long long sources_offset = modules_offset + module_count * static_cast<unsigned long long>(compiled_module_size);
+    unsigned long long ids_offset = sources_offset + source_count * static_cast<unsigned long long>(compiled_source_size);
+    unsigned long long params_offset = ids_offset + id_count * static_cast<unsigned long long>(compiled_id_size);
+    unsigned long long names_offset = params_offset + param_bytes;
+
+    if (names_offset + name_bytes != file.size || root_index >= module_count)
+        throw xml_noise_error_t(corrupt);
+
+    std::vector<module_ptr_t> modules(module_count);
+
+    for (unsigned int i = 0; i < module_count; ++i)
+    {
+        unsigned long long record = modules_offset + i * static_cast<unsigned long long>(compiled_module_size);
+        unsigned short type_id = get_compiled<unsigned short>(data, record);
+        unsigned short child_count = get_compiled<unsigned short>(data, record + 2);
+        unsigned int first_source = get_compiled<unsigned int>(data, record + 4);
+        unsigned int param_offset = get_compiled<unsigned int>(data, record + 8);
+        unsigned int param_size = get_compiled<unsigned int>(data, record + 12);
+
+        if (static_cast<unsigned long long>(first_source) + child_count > source_count
+            || static_cast<unsigned long long>(param_offset) + param_size > param_bytes)
+            throw xml_noise_error_t(corrupt);
+
+        module_ptr_t module_ptr = noisepp::utils::Reader::createModule(type_id);
+        if (!module_ptr)
+            throw xml_noise_error_t(corrupt);
+
+        //Owned from here on, like the modules load() creates.
+        module_ptrs.push_back(module_ptr);
+
+        if (module_ptr->getSourceModuleCount() != child_count)
+            throw xml_noise_error_t(corrupt);
+
+        //The stream only reads; MemoryInStream just wants a non const buffer.
+        noisepp::utils::MemoryInStream param_stream;
+        param_stream.open(const_cast<char*>(data + params_offset + param_offset), param_size);
+        //Module::read() throws a plain runtime_error when it runs past the parameters.
+        try
+        {
+            module_ptr->read(param_stream);
+        }
+        catch (const std::runtime_error&)
+        {
+            throw xml_noise_error_t(corrupt);
+        }
+        if (param_stream.tell() != param_size)
+            throw xml_noise_error_t(corrupt);
+
+        //Children come first, so every source is already there, and the graph can't have a cycle.
+        for (unsigned short j = 0; j < child_count; ++j)
+        {
+            unsigned int child = get_compiled<unsigned int>(data, sources_offset + (first_source + j) * static_cast<unsigned long long>(compiled_source_size));
+            if (child >= i)
+                throw xml_noise_error_t(corrupt);
+
+            module_ptr->setSourceModule(j, modules[child]);
+        }
+
+        modules[i] = module_ptr;
+    }
+
+    for (unsigned int i = 0; i < id_count; ++i)
+    {
+        unsigned long long record = ids_offset + i * static_cast<unsigned long long>(compiled_id_size);
+        unsigned int module_index = get_compiled<unsigned int>(data, record);
+        unsigned int name_offset = get_compiled<unsigned int>(data, record + 4);
+        unsigned int name_size = get_compiled<unsigned int>(data, record + 8);
+
+        if (module_index >= module_count || static_cast<unsigned long long>(name_offset) + name_size > name_bytes)
+            throw xml_noise_error_t(corrupt);
+
+        std::string id(data + names_offset + name_offset, name_size);
+        if (special_nodes.count(id))
+            throw xml_noise_error_t(corrupt);
+
+        special_nodes[id] = modules[module_index];
+    }
+
+    root = modules[root_index];
+    source_hash = compiled_source_hash;
+
+    //The file keeps the hash of the xml graph it was compiled from. With another pipeline seed
+    // that one no longer applies, so hash the compiled graph instead; it still changes with it.
+    if (seed == pipeline.getSeed())
+    {
+        root_hash = compiled_hash;
+    }
+    else
+    {
+        noisepp::utils::HashOutStream hash_stream;
+        hash_stream.write(module_hash_version);
+        hash_stream.writeInt(pipeline.getSeed());
+        hash_module(hash_stream, root);
+        root_hash = hash_stream.getHash();
+    }
+}
+
+
+unsigned long long xml_noise3d_t::hash_source(const std::string& xml_file_name)
+{
+    std::ifstream file(xml_file_name.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+        return 0;
+
+    noisepp::utils::HashOutStream hash_stream;
+
+    char buffer[4096];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount())
+    {
+        hash_stream.write(buffer, static_cast<std::size_t>(file.gcount()));
+    }
+
+    return hash_stream.getHash();
+}
@@ -5,21 +5,41 @@
 
 
 #include "xml_noise_decls.hpp"
+#include "xml_noise_optimize.hpp"
+#include "xml_noise_tag_dispatch.hpp"
 
 #include <boost/noncopyable.hpp>
 
 #include <boost/ptr_container/ptr_list.hpp>
-#include <stack>
+#include <vector>
 #include <map>
 
 struct xml_noise3d_t
     : boost::noncopyable
+    , private tinyxml2::XMLVisitor
 {
     xml_noise3d_t(noisepp::Pipeline3D& pipeline);
     ~xml_noise3d_t();
 
     void load(const std::string& xml_file_name);
     
+    //Replaces root by an optimized, equivalent graph (see optimize_noise_graph), call after load().
+    // The modules of the loaded graph stay alive, so special_nodes still work.
+    void optimize();
+
+    //Writes the graph under root to a flat binary file that load_compiled() maps back in without
+    // any xml parsing. Call after load() and optimize(), so the file holds the optimized graph.
+    // Only the special_nodes reachable from root are kept.
+    void save_compiled(const std::string& compiled_file_name) const;
+
+    //Instead of load() (and optimize()), for files written by save_compiled(). Throws
+    // xml_noise_error_t on a truncated or corrupt file, or one written by another version.
+    // Compare source_hash with hash_source() of the xml to find out if the file is out of date.
+    void load_compiled(const std::string& compiled_file_name);
+
+    //Hash of the bytes of the file xml_file_name, 0 if it can't be read.
+    static unsigned long long hash_source(const std::string& xml_file_name);
+
     //Simple recursive version, for testing. Broken ATM.
     void simple_load(const std::string& xml_file_name);
 
@@ -27,13 +47,46 @@ struct xml_noise3d_t
 
     noisepp::Pipeline3D& pipeline;
     module_ptr_t root;
+
+    //Structural hash of the graph under root: module types, parameters and child order, plus
+    // the pipeline seed. Comments, whitespace and attribute order don't change it, so it can be
+    // used to invalidate anything generated from this graph. Valid after load() or load_compiled().
+    unsigned long long root_hash;
+
+    //hash_source() of the xml file the graph was loaded or compiled from. Valid after load() or
+    // load_compiled().
+    unsigned long long source_hash;
     boost::ptr_list<module_t> module_ptrs;
 
+    //Node counts and rewrites of the last optimize() call.
+    noise_optimize_stats_t optimize_stats;
+
     std::map<std::string, module_ptr_t> special_nodes;
+
+    //Set before load() to get the xml path of every loaded module in module_paths, like
+    // "noise/select[0]/blend/perlin[2]". The [i] only appears where a parent has more than one
+    // child with that tag. Used to key profiling reports; modules made by optimize() have none.
+    bool keep_paths;
+    std::map<const module_t*, std::string> module_paths;
     
 private:
+    //load() walks the document with these.
+    virtual bool VisitEnter(const tinyxml2::XMLElement& element, const tinyxml2::XMLAttribute* first_attribute);
+    virtual bool VisitExit(const tinyxml2::XMLElement& element);
+
     void visit(const tinyxml2::XMLElement& element);
-    std::stack< module_ptr_t > argument_stack;
+
+    //Modules waiting for their parent, and where the arguments of every open element start.
+    // Kept between loads, like arguments, so their storage is reused.
+    std::vector< module_ptr_t > argument_stack;
+    std::vector< std::size_t > argument_starts;
+    child_modules_t arguments;
+
+    //Paths of the open elements, if keep_paths is set.
+    std::vector< std::string > path_stack;
+
+    //Handler lookup of the load() in progress.
+    const tag_dispatch_t<handlers3d_t>* dispatch;
     
     
     
@@ -164,6 +164,42 @@ module_ptr_t handle_ridged_multi3d(noisepp::Pipeline3D& pipeline,
     return module_ptr.release();
 }
 
+module_ptr_t handle_simplex3d(noisepp::Pipeline3D& pipeline,
+                             const tinyxml2::XMLElement& element,
+                             const child_modules_t& child_modules)
+{
+    //For exception safety.
+    std::auto_ptr<noisepp::SimplexModule> module_ptr( new noisepp::SimplexModule() );
+
+    //Same attributes as perlin, quality is accepted but has no effect.
+    handle_perlinbase("simplex", *module_ptr, pipeline, element, child_modules);
+
+    return module_ptr.release();
+}
+
+module_ptr_t handle_ridged_simplex3d(noisepp::Pipeline3D& pipeline,
+                             const tinyxml2::XMLElement& element,
+                             const child_modules_t& child_modules)
+{
+    check_name_and_size("ridged-simplex", element, child_modules, 0);
+
+    //For exception safety.
+    std::auto_ptr<noisepp::RidgedSimplexModule> module_ptr( new noisepp::RidgedSimplexModule() );
+
+    noisepp::RidgedSimplexModule& module = *module_ptr;
+
+    set_frequency_shortcut(module,element);
+    set_octaves_shortcut(module,element);
+    set_seed_shortcut(module,element);
+    set_lacunarity_shortcut(module,element);
+    set_scale_shortcut(module,element);
+    set_exponent_shortcut(module,element);
+    set_offset_shortcut(module,element);
+    set_gain_shortcut(module,element);
+
+    return module_ptr.release();
+}
+
 module_ptr_t handle_voronoi3d(noisepp::Pipeline3D& pipeline,
                               const tinyxml2::XMLElement& element,
                               const child_modules_t& child_modules)
@@ -272,6 +308,8 @@ void register_all_3dhandlers(handlers3d_t& handlers)
     handlers["billow"] = boost::bind(handle_billow3d, _1, _2, _3);
     handlers["voronoi"] = boost::bind(handle_voronoi3d, _1, _2, _3);
     handlers["ridged-multi"] = boost::bind(handle_ridged_multi3d, _1, _2, _3);
+    handlers["simplex"] = boost::bind(handle_simplex3d, _1, _2, _3);
+    handlers["ridged-simplex"] = boost::bind(handle_ridged_simplex3d, _1, _2, _3);
 
     handlers["clamp"] = boost::bind(handle_clamp3d, _1, _2, _3);
 
@@ -26,6 +26,14 @@ module_ptr_t handle_ridged_multi3d(noisepp::Pipeline3D& pipeline,
                               const tinyxml2::XMLElement& element,
                               const child_modules_t& child_modules);
 
+module_ptr_t handle_simplex3d(noisepp::Pipeline3D& pipeline,
+                              const tinyxml2::XMLElement& element,
+                              const child_modules_t& child_modules);
+
+module_ptr_t handle_ridged_simplex3d(noisepp::Pipeline3D& pipeline,
+                              const tinyxml2::XMLElement& element,
+                              const child_modules_t& child_modules);
+
 
 
 
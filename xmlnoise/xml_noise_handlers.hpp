@@ -82,6 +82,30 @@ void set_scale_shortcut(T& module, const tinyxml2::XMLElement& element)
         module.setScale(value);
 }
 
+template<typename T>
+void set_exponent_shortcut(T& module, const tinyxml2::XMLElement& element)
+{
+    double value = 0;
+    if (get_double_attribute(element,"exponent",true,value))
+        module.setExponent(value);
+}
+
+template<typename T>
+void set_offset_shortcut(T& module, const tinyxml2::XMLElement& element)
+{
+    double value = 0;
+    if (get_double_attribute(element,"offset",true,value))
+        module.setOffset(value);
+}
+
+template<typename T>
+void set_gain_shortcut(T& module, const tinyxml2::XMLElement& element)
+{
+    double value = 0;
+    if (get_double_attribute(element,"gain",true,value))
+        module.setGain(value);
+}
+
 template<typename T>
 void set_displacement_shortcut(T& module, const tinyxml2::XMLElement& element)
 {
@@ -0,0 +1,471 @@
+#include "xml_noise_optimize.hpp"
+
+#include "../noisepp/utils/NoiseInStream.h"
+#include "../noisepp/utils/NoiseOutStream.h"
+#include "../noisepp/utils/NoiseReader.h"
+
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+
+
+noise_optimize_stats_t::noise_optimize_stats_t()
+    : nodes_before(0)
+    , nodes_after(0)
+    , folded_constants(0)
+    , fused_scale_bias(0)
+    , removed_identities(0)
+    , hoisted_y_terms(0)
+{
+
+}
+
+
+static void collect_nodes(const module_t* module, std::set<const module_t*>& nodes)
+{
+    if (!nodes.insert(module).second)
+        return;
+
+    for (std::size_t i = 0; i < module->getSourceModuleCount(); ++i)
+        collect_nodes(module->getSourceModule(i), nodes);
+}
+
+std::size_t count_noise_graph_nodes(const module_t* root)
+{
+    std::set<const module_t*> nodes;
+    collect_nodes(root, nodes);
+    return nodes.size();
+}
+
+
+namespace
+{
+
+enum
+{
+    DEPENDS_X = 1,
+    DEPENDS_Y = 2,
+    DEPENDS_Z = 4,
+    DEPENDS_XYZ = DEPENDS_X | DEPENDS_Y | DEPENDS_Z
+};
+
+struct optimizer_t
+{
+    optimizer_t(boost::ptr_list<module_t>& module_ptrs, noise_optimize_stats_t& stats)
+        : module_ptrs(module_ptrs)
+        , stats(stats)
+    {
+    }
+
+    boost::ptr_list<module_t>& module_ptrs;
+    noise_optimize_stats_t& stats;
+
+    //Already optimized modules, so shared subgraphs stay shared.
+    std::map<module_ptr_t, module_ptr_t> optimized;
+    std::map<const module_t*, int> dependencies;
+
+    module_ptr_t optimize(module_ptr_t module);
+
+    module_ptr_t simplify(module_ptr_t module, const child_modules_t& children);
+    module_ptr_t simplify_affine(module_ptr_t module, const child_modules_t& children);
+    module_ptr_t hoist_y_terms(module_ptr_t module, const child_modules_t& children);
+
+    int get_dependencies(const module_t* module);
+
+    module_ptr_t own(module_t* module);
+    module_ptr_t rebuild(module_ptr_t module, const child_modules_t& children);
+    module_ptr_t make_const(noisepp::Real value);
+    module_ptr_t make_scale_bias(module_ptr_t source, noisepp::Real scale, noisepp::Real bias);
+    module_ptr_t make_dual(noisepp::ModuleTypeId type, module_ptr_t left, module_ptr_t right);
+};
+
+
+bool is_const(const module_t* module)
+{
+    return module->getType() == noisepp::MODULE_CONSTANT;
+}
+
+noisepp::Real const_value(const module_t* module)
+{
+    return static_cast<const noisepp::ConstantModule*>(module)->getValue();
+}
+
+//All inputs are constant, so any position gives the same value.
+noisepp::Real evaluate_constant(const module_t& module)
+{
+    noisepp::Pipeline3D pipeline;
+    noisepp::ElementID id = module.addToPipeline(&pipeline);
+    noisepp::Cache* cache = pipeline.createCache();
+    noisepp::Real value = pipeline.getElement(id)->getValue(0, 0, 0, cache);
+    pipeline.freeCache(cache);
+    return value;
+}
+
+//Flattens a chain of one associative operation into its operands.
+void flatten(noisepp::ModuleTypeId type, module_ptr_t module, child_modules_t& operands)
+{
+    if (module->getType() != type)
+    {
+        operands.push_back(module);
+        return;
+    }
+
+    for (std::size_t i = 0; i < module->getSourceModuleCount(); ++i)
+        flatten(type, const_cast<module_ptr_t>(module->getSourceModule(i)), operands);
+}
+
+}
+
+
+module_ptr_t optimizer_t::own(module_t* module)
+{
+    module_ptrs.push_back(module);
+    return module;
+}
+
+//Copy of module with other sources; parameters are copied the way the Writer/Reader do it.
+module_ptr_t optimizer_t::rebuild(module_ptr_t module, const child_modules_t& children)
+{
+    bool changed = false;
+    for (std::size_t i = 0; i < children.size(); ++i)
+        changed |= (children[i] != module->getSourceModule(i));
+
+    if (!changed)
+        return module;
+
+    std::auto_ptr<module_t> copy( noisepp::utils::Reader::createModule(module->getType()) );
+
+    //Not a module the reader knows, leave it as it is.
+    if (!copy.get())
+        return module;
+
+    noisepp::utils::MemoryOutStream out_stream;
+    module->write(out_stream);
+
+    noisepp::utils::MemoryInStream in_stream;
+    in_stream.open(out_stream.getBuffer(), out_stream.getBufferSize());
+    copy->read(in_stream);
+
+    for (std::size_t i = 0; i < children.size(); ++i)
+        copy->setSourceModule(i, children[i]);
+
+    return own(copy.release());
+}
+
+module_ptr_t optimizer_t::make_const(noisepp::Real value)
+{
+    std::auto_ptr<noisepp::ConstantModule> module_ptr( new noisepp::ConstantModule() );
+    module_ptr->setValue(value);
+    return own(module_ptr.release());
+}
+
+module_ptr_t optimizer_t::make_scale_bias(module_ptr_t source, noisepp::Real scale, noisepp::Real bias)
+{
+    std::auto_ptr<noisepp::ScaleBiasModule> module_ptr( new noisepp::ScaleBiasModule() );
+    module_ptr->setSourceModule(0, source);
+    module_ptr->setScale(scale);
+    module_ptr->setBias(bias);
+    return own(module_ptr.release());
+}
+
+module_ptr_t optimizer_t::make_dual(noisepp::ModuleTypeId type, module_ptr_t left, module_ptr_t right)
+{
+    std::auto_ptr<module_t> module_ptr( noisepp::utils::Reader::createModule(type) );
+    module_ptr->setSourceModule(0, left);
+    module_ptr->setSourceModule(1, right);
+    return own(module_ptr.release());
+}
+
+
+int optimizer_t::get_dependencies(const module_t* module)
+{
+    std::map<const module_t*, int>::const_iterator w = dependencies.find(module);
+    if (w != dependencies.end())
+        return w->second;
+
+    int result = 0;
+
+    switch (module->getType())
+    {
+    case noisepp::MODULE_CONSTANT:
+        result = 0;
+        break;
+    case noisepp::MODULE_Y:
+        result = DEPENDS_Y;
+        break;
+    //Generators, and turbulence which displaces its source along all axes.
+    case noisepp::MODULE_PERLIN:
+    case noisepp::MODULE_BILLOW:
+    case noisepp::MODULE_RIDGEDMULTI:
+    case noisepp::MODULE_SIMPLEX:
+    case noisepp::MODULE_RIDGEDSIMPLEX:
+    case noisepp::MODULE_VORONOI:
+    case noisepp::MODULE_CHECKERBOARD:
+    case noisepp::MODULE_TURBULENCE:
+        result = DEPENDS_XYZ;
+        break;
+    //Everything else, scale-point and translate-point included, only depends on what the sources depend on.
+    default:
+        //Unless it is a module this pass doesn't know about.
+        if (module->getType() > noisepp::MODULE_RIDGEDSIMPLEX)
+        {
+            result = DEPENDS_XYZ;
+            break;
+        }
+        for (std::size_t i = 0; i < module->getSourceModuleCount(); ++i)
+            result |= get_dependencies(module->getSourceModule(i));
+        break;
+    }
+
+    dependencies[module] = result;
+    return result;
+}
+
+
+module_ptr_t optimizer_t::optimize(module_ptr_t module)
+{
+    std::map<module_ptr_t, module_ptr_t>::const_iterator w = optimized.find(module);
+    if (w != optimized.end())
+        return w->second;
+
+    //Post order, like the loader: children are final before their parent is looked at.
+    child_modules_t children;
+    for (std::size_t i = 0; i < module->getSourceModuleCount(); ++i)
+        children.push_back(optimize(const_cast<module_ptr_t>(module->getSourceModule(i))));
+
+    module_ptr_t result = simplify(module, children);
+
+    optimized[module] = result;
+    return result;
+}
+
+module_ptr_t optimizer_t::simplify(module_ptr_t module, const child_modules_t& children)
+{
+    using namespace noisepp;
+
+    if (children.empty())
+        return module;
+
+    //Constant folding.
+    {
+        bool all_const = true;
+        for (std::size_t i = 0; i < children.size(); ++i)
+            all_const &= is_const(children[i]);
+
+        if (all_const)
+        {
+            ++stats.folded_constants;
+            return make_const(evaluate_constant(*rebuild(module, children)));
+        }
+    }
+
+    ModuleTypeId type = module->getType();
+
+    //Identities.
+    if ((type == MODULE_MINIMUM || type == MODULE_MAXIMUM) && children[0] == children[1])
+    {
+        ++stats.removed_identities;
+        return children[0];
+    }
+    if (type == MODULE_POWER && is_const(children[1]) && const_value(children[1]) == Real(1))
+    {
+        ++stats.removed_identities;
+        return children[0];
+    }
+
+    if (type == MODULE_ADDITION || type == MODULE_MULTIPLY)
+    {
+        module_ptr_t hoisted = hoist_y_terms(module, children);
+        if (hoisted)
+            return hoisted;
+    }
+
+    module_ptr_t affine = simplify_affine(module, children);
+    if (affine)
+        return affine;
+
+    return rebuild(module, children);
+}
+
+//Turns x * c, x + c, -x and scale-bias into one scale-bias over x, merged with the one below.
+module_ptr_t optimizer_t::simplify_affine(module_ptr_t module, const child_modules_t& children)
+{
+    using namespace noisepp;
+
+    module_ptr_t source = NULL;
+    Real scale = 1;
+    Real bias = 0;
+
+    switch (module->getType())
+    {
+    case MODULE_SCALEBIAS:
+        source = children[0];
+        scale = static_cast<const ScaleBiasModule*>(module)->getScale();
+        bias = static_cast<const ScaleBiasModule*>(module)->getBias();
+        break;
+    case MODULE_INVERT:
+        source = children[0];
+        scale = -1;
+        break;
+    case MODULE_ADDITION:
+    case MODULE_MULTIPLY:
+        {
+            //Both constant was folded already.
+            int const_index = is_const(children[0]) ? 0 : (is_const(children[1]) ? 1 : -1);
+            if (const_index < 0)
+                return NULL;
+
+            source = children[1 - const_index];
+            if (module->getType() == MODULE_ADDITION)
+                bias = const_value(children[const_index]);
+            else
+                scale = const_value(children[const_index]);
+        }
+        break;
+    default:
+        return NULL;
+    }
+
+    bool fused = false;
+
+    if (source->getType() == MODULE_SCALEBIAS)
+    {
+        const ScaleBiasModule* inner = static_cast<const ScaleBiasModule*>(source);
+
+        bias = scale * inner->getBias() + bias;
+        scale = scale * inner->getScale();
+        source = const_cast<module_ptr_t>(inner->getSourceModule(0));
+        fused = true;
+    }
+
+    if (scale == Real(1) && bias == Real(0))
+    {
+        ++stats.removed_identities;
+        return source;
+    }
+
+    if (scale == Real(0))
+    {
+        ++stats.folded_constants;
+        return make_const(bias);
+    }
+
+    if (!fused && module->getType() == MODULE_SCALEBIAS)
+        return rebuild(module, children);
+
+    ++stats.fused_scale_bias;
+    return make_scale_bias(source, scale, bias);
+}
+
+//Regroups a chain of additions (or multiplications) as (xyz terms) op (y-only terms), folding
+// all constants into one. The y-only group is a subgraph of its own then, which only has to be
+// evaluated once per y.
+module_ptr_t optimizer_t::hoist_y_terms(module_ptr_t module, const child_modules_t& children)
+{
+    using namespace noisepp;
+
+    ModuleTypeId type = module->getType();
+
+    //Already (xyz terms) op (y-only terms)?
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        if (get_dependencies(children[1 - i]) != DEPENDS_Y)
+            continue;
+
+        child_modules_t others;
+        flatten(type, children[i], others);
+
+        bool grouped = true;
+        for (std::size_t j = 0; j < others.size(); ++j)
+            grouped &= !is_const(others[j]) && get_dependencies(others[j]) != DEPENDS_Y;
+
+        if (grouped)
+            return NULL;
+    }
+
+    child_modules_t operands;
+    flatten(type, children[0], operands);
+    flatten(type, children[1], operands);
+
+    child_modules_t y_terms;
+    child_modules_t other_terms;
+    child_modules_t const_terms;
+
+    for (std::size_t i = 0; i < operands.size(); ++i)
+    {
+        if (is_const(operands[i]))
+            const_terms.push_back(operands[i]);
+        else if (get_dependencies(operands[i]) == DEPENDS_Y)
+            y_terms.push_back(operands[i]);
+        else
+            other_terms.push_back(operands[i]);
+    }
+
+    //Already grouped as well as it gets.
+    bool mixed = !y_terms.empty() && !other_terms.empty();
+    if (operands.size() <= 2 || (!mixed && const_terms.size() <= 1))
+        return NULL;
+
+    //Builds a left leaning chain over terms, simplifying every link.
+    struct chain_t
+    {
+        static module_ptr_t build(optimizer_t& optimizer, ModuleTypeId type, const child_modules_t& terms)
+        {
+            if (terms.empty())
+                return NULL;
+
+            module_ptr_t result = terms[0];
+            for (std::size_t i = 1; i < terms.size(); ++i)
+            {
+                child_modules_t pair;
+                pair.push_back(result);
+                pair.push_back(terms[i]);
+
+                result = optimizer.simplify(optimizer.make_dual(type, result, terms[i]), pair);
+            }
+            return result;
+        }
+    };
+
+    //Constants go with the y group, or with the others if there is none, so they fold into a scale-bias.
+    module_ptr_t const_term = chain_t::build(*this, type, const_terms);
+
+    if (const_term)
+    {
+        if (!y_terms.empty())
+            y_terms.push_back(const_term);
+        else
+            other_terms.push_back(const_term);
+    }
+
+    module_ptr_t y_group = chain_t::build(*this, type, y_terms);
+    module_ptr_t other_group = chain_t::build(*this, type, other_terms);
+
+    if (!y_group)
+        return other_group;
+    if (!other_group)
+        return y_group;
+
+    ++stats.hoisted_y_terms;
+
+    //Not simplify(): that would flatten both groups again.
+    return make_dual(type, other_group, y_group);
+}
+
+
+module_ptr_t optimize_noise_graph(module_ptr_t root,
+                                  boost::ptr_list<module_t>& module_ptrs,
+                                  noise_optimize_stats_t& stats)
+{
+    assert(root);
+
+    stats = noise_optimize_stats_t();
+    stats.nodes_before = count_noise_graph_nodes(root);
+
+    optimizer_t optimizer(module_ptrs, stats);
+    module_ptr_t result = optimizer.optimize(root);
+
+    stats.nodes_after = count_noise_graph_nodes(result);
+    return result;
+}
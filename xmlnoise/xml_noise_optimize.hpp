@@ -0,0 +1,37 @@
+#ifndef XML_NOISE_OPTIMIZE_HPP
+#define XML_NOISE_OPTIMIZE_HPP
+
+#include "xml_noise_decls.hpp"
+
+#include <boost/ptr_container/ptr_list.hpp>
+
+
+struct noise_optimize_stats_t
+{
+    noise_optimize_stats_t();
+
+    //Distinct modules reachable from the root.
+    std::size_t nodes_before;
+    std::size_t nodes_after;
+
+    //Modules with only constant inputs replaced by a constant.
+    std::size_t folded_constants;
+    //Chains of scale-bias, invert and multiply/addition by a constant merged into one scale-bias.
+    std::size_t fused_scale_bias;
+    //x * 1, x + 0, pow(x, 1), min(x, x), ... replaced by x.
+    std::size_t removed_identities;
+    //Addition/multiply chains regrouped so their y-only terms form one subgraph.
+    std::size_t hoisted_y_terms;
+};
+
+//Returns the root of a graph computing the same noise as the one under root, with fewer modules.
+//Nothing reachable from root is modified; new modules are appended to module_ptrs, which owns them.
+//Regrouping sums and products changes results by rounding only.
+module_ptr_t optimize_noise_graph(module_ptr_t root,
+                                  boost::ptr_list<module_t>& module_ptrs,
+                                  noise_optimize_stats_t& stats);
+
+//Distinct modules reachable from root, shared ones counted once.
+std::size_t count_noise_graph_nodes(const module_t* root);
+
+#endif
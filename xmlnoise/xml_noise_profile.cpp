@@ -0,0 +1,89 @@
+#include "xml_noise_profile.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+
+namespace
+{
+    struct module_profile_t
+    {
+        const std::string* path;
+        const noisepp::utils::ElementProfile* profile;
+
+        bool operator<(const module_profile_t& other) const
+        {
+            return profile->exclusiveCycles > other.profile->exclusiveCycles;
+        }
+    };
+}
+
+static std::vector<module_profile_t> get_module_profiles(const xml_noise3d_t& xml_noise3d,
+                                                         const noisepp::utils::ProfiledPipeline3D& pipeline)
+{
+    std::vector<module_profile_t> profiles;
+
+    std::map<const module_t*, std::string>::const_iterator w = xml_noise3d.module_paths.begin();
+    for (; w != xml_noise3d.module_paths.end(); ++w)
+    {
+        //Modules that never made it into the pipeline, like the ones optimize() replaced.
+        const noisepp::utils::ElementProfile* profile = pipeline.getProfile(w->first);
+        if (!profile)
+            continue;
+
+        module_profile_t module_profile = { &w->second, profile };
+        profiles.push_back(module_profile);
+    }
+
+    std::sort(profiles.begin(), profiles.end());
+    return profiles;
+}
+
+void write_noise_flame_graph(std::ostream& out,
+                             const xml_noise3d_t& xml_noise3d,
+                             const noisepp::utils::ProfiledPipeline3D& pipeline)
+{
+    std::vector<module_profile_t> profiles = get_module_profiles(xml_noise3d, pipeline);
+
+    for (std::size_t i = 0; i < profiles.size(); ++i)
+    {
+        std::string stack = *profiles[i].path;
+        std::replace(stack.begin(), stack.end(), '/', ';');
+
+        out << stack << ' ' << profiles[i].profile->exclusiveCycles << '\n';
+    }
+}
+
+void write_noise_profile(std::ostream& out,
+                         const xml_noise3d_t& xml_noise3d,
+                         const noisepp::utils::ProfiledPipeline3D& pipeline)
+{
+    std::vector<module_profile_t> profiles = get_module_profiles(xml_noise3d, pipeline);
+
+    unsigned long long total_cycles = 0;
+    for (std::size_t i = 0; i < profiles.size(); ++i)
+        total_cycles += profiles[i].profile->exclusiveCycles;
+
+    out << std::setw(12) << "calls"
+        << std::setw(8) << "hits"
+        << std::setw(16) << "inclusive"
+        << std::setw(16) << "exclusive"
+        << std::setw(8) << "self"
+        << "  path\n";
+
+    for (std::size_t i = 0; i < profiles.size(); ++i)
+    {
+        const noisepp::utils::ElementProfile& profile = *profiles[i].profile;
+
+        double hit_rate = profile.calls ? 100.0 * profile.cacheHits / profile.calls : 0.0;
+        double share = total_cycles ? 100.0 * profile.exclusiveCycles / total_cycles : 0.0;
+
+        out << std::setw(12) << profile.calls
+            << std::setw(7) << std::fixed << std::setprecision(1) << hit_rate << '%'
+            << std::setw(16) << profile.inclusiveCycles
+            << std::setw(16) << profile.exclusiveCycles
+            << std::setw(7) << share << '%'
+            << "  " << *profiles[i].path << '\n';
+    }
+}
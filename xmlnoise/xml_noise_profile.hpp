@@ -0,0 +1,27 @@
+#ifndef XML_NOISE_PROFILE_HPP
+#define XML_NOISE_PROFILE_HPP
+
+#include "xml_noise3d.hpp"
+
+#include "../noisepp/utils/NoiseProfiler.h"
+
+#include <ostream>
+
+
+//Reports on a graph loaded with keep_paths set, added to a ProfiledPipeline3D and evaluated.
+// Only modules with a path are reported, so profile the graph as loaded, not optimized.
+
+//Folded stacks, the input of flamegraph.pl and speedscope: one line per module, its xml path
+// with ';' between the elements followed by its exclusive cycles, like
+// "noise;select[0];blend;perlin[2] 123456".
+void write_noise_flame_graph(std::ostream& out,
+                             const xml_noise3d_t& xml_noise3d,
+                             const noisepp::utils::ProfiledPipeline3D& pipeline);
+
+//One line per module: calls, cache hit rate, inclusive and exclusive cycles and the xml path,
+// the module with the most exclusive cycles first.
+void write_noise_profile(std::ostream& out,
+                         const xml_noise3d_t& xml_noise3d,
+                         const noisepp::utils::ProfiledPipeline3D& pipeline);
+
+#endif
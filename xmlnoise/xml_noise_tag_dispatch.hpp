@@ -0,0 +1,81 @@
+#ifndef XML_NOISE_TAG_DISPATCH_HPP
+#define XML_NOISE_TAG_DISPATCH_HPP
+
+#include <vector>
+#include <cstring>
+
+
+//Perfect hash from tag names to the handlers of a handlers3d_t/handlers2d_t map, built once per
+// load. Every name has a slot of its own, so a lookup is one hash of the tag and one strcmp,
+// without building a std::string. The map must outlive the table and not change under it.
+template<typename handlers_t>
+class tag_dispatch_t
+{
+public:
+    typedef typename handlers_t::mapped_type handler_t;
+
+    explicit tag_dispatch_t(const handlers_t& handlers)
+        : seed(0)
+        , mask(0)
+    {
+        std::size_t size = 4;
+        while (size < handlers.size() * 2)
+            size *= 2;
+
+        //A handful of seeds is usually enough; if not, a bigger table is.
+        for (;;)
+        {
+            for (seed = 0; seed < 64; ++seed)
+            {
+                if (fill(handlers, size))
+                    return;
+            }
+            size *= 2;
+        }
+    }
+
+    //The handler for tag, or NULL if there is none.
+    const handler_t* find(const char* tag) const
+    {
+        const typename handlers_t::value_type* entry = slots[hash(tag, seed) & mask];
+
+        if (entry && std::strcmp(entry->first.c_str(), tag) == 0)
+            return &entry->second;
+        return NULL;
+    }
+
+private:
+    //FNV-1a, seeded.
+    static unsigned int hash(const char* tag, unsigned int seed)
+    {
+        unsigned int h = 2166136261u ^ (seed * 0x9e3779b9u);
+        for (; *tag; ++tag)
+        {
+            h ^= static_cast<unsigned char>(*tag);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    bool fill(const handlers_t& handlers, std::size_t size)
+    {
+        slots.assign(size, NULL);
+        mask = static_cast<unsigned int>(size - 1);
+
+        for (typename handlers_t::const_iterator w = handlers.begin(); w != handlers.end(); ++w)
+        {
+            const typename handlers_t::value_type*& slot = slots[hash(w->first.c_str(), seed) & mask];
+            if (slot)
+                return false;
+            slot = &*w;
+        }
+        return true;
+    }
+
+    std::vector<const typename handlers_t::value_type*> slots;
+    unsigned int seed;
+    unsigned int mask;
+};
+
+
+#endif